@@ -0,0 +1,209 @@
+#include <bitset>
+#include "BitMask.h"
+#include "Parallel.h"
+#include "Simd.h"
+
+/**
+ * @brief Default constructor for the BitMask class.
+ * Initializes an empty mask.
+ */
+BitMask::BitMask() : width{0}, height{0}, stride{0} {}
+
+/**
+ * @brief Constructs a mask with every pixel cleared.
+ *
+ * @param width The width of the mask.
+ * @param height The height of the mask.
+ */
+BitMask::BitMask(unsigned int width, unsigned int height) : width{0}, height{0}, stride{0}
+{
+    resize(width, height);
+}
+
+/**
+ * @brief Constructs the mask of the non-zero pixels of an image.
+ *
+ * @param img The image.
+ */
+BitMask::BitMask(const Image &img) : width{0}, height{0}, stride{0}
+{
+    resize(img.getWidth(), img.getHeight());
+    Parallel::forRows(0, this->height, [&](unsigned int first, unsigned int last)
+                      {
+                          for (unsigned int i = first; i < last; ++i)
+                              packRow(img.getData()[i], this->width, row(i));
+                      },
+                      64);
+}
+
+/**
+ * @brief Get the width of the mask.
+ *
+ * @return The width.
+ */
+unsigned int BitMask::getWidth() const
+{
+    return this->width;
+}
+
+/**
+ * @brief Get the height of the mask.
+ *
+ * @return The height.
+ */
+unsigned int BitMask::getHeight() const
+{
+    return this->height;
+}
+
+/**
+ * @brief Get the size of the mask.
+ *
+ * @return The size.
+ */
+Size BitMask::size() const
+{
+    return Size(this->width, this->height);
+}
+
+/**
+ * @brief Get the number of bytes of every packed row.
+ *
+ * @return The stride.
+ */
+unsigned int BitMask::getStride() const
+{
+    return this->stride;
+}
+
+/**
+ * @brief Resizes the mask, clearing every pixel.
+ *
+ * @param newWidth The new width.
+ * @param newHeight The new height.
+ */
+void BitMask::resize(unsigned int newWidth, unsigned int newHeight)
+{
+    this->width = newWidth;
+    this->height = newHeight;
+    this->stride = (newWidth + 7) / 8;
+    this->bits.assign(static_cast<size_t>(this->stride) * newHeight, 0);
+}
+
+/**
+ * @brief Returns whether a pixel is set.
+ *
+ * @param x The row of the pixel.
+ * @param y The column of the pixel.
+ * @return True if the pixel is set.
+ */
+bool BitMask::get(unsigned int x, unsigned int y) const
+{
+    return (this->bits[static_cast<size_t>(x) * this->stride + y / 8] >> (y % 8)) & 1;
+}
+
+/**
+ * @brief Sets or clears a pixel.
+ *
+ * @param x The row of the pixel.
+ * @param y The column of the pixel.
+ * @param value True to set the pixel, false to clear it.
+ */
+void BitMask::set(unsigned int x, unsigned int y, bool value)
+{
+    unsigned char &byte = this->bits[static_cast<size_t>(x) * this->stride + y / 8];
+    if (value)
+        byte |= static_cast<unsigned char>(1 << (y % 8));
+    else
+        byte &= static_cast<unsigned char>(~(1 << (y % 8)));
+}
+
+/**
+ * @brief Returns the packed bytes of a row.
+ *
+ * @param y The row.
+ * @return A pointer to the stride bytes of the row.
+ */
+unsigned char *BitMask::row(unsigned int y)
+{
+    return &this->bits[static_cast<size_t>(y) * this->stride];
+}
+
+/**
+ * @brief Returns the packed bytes of a row.
+ *
+ * @param y The row.
+ * @return A pointer to the stride bytes of the row.
+ */
+const unsigned char *BitMask::row(unsigned int y) const
+{
+    return &this->bits[static_cast<size_t>(y) * this->stride];
+}
+
+/**
+ * @brief Counts the pixels that are set.
+ *
+ * The padding bits of every row are always clear, so whole bytes can be counted.
+ *
+ * @return The number of set pixels.
+ */
+unsigned long long BitMask::count() const
+{
+    unsigned long long total = 0;
+    for (unsigned char byte : this->bits)
+        total += std::bitset<8>(byte).count();
+    return total;
+}
+
+/**
+ * @brief Expands the mask to an image, with 255 for the set pixels and 0 for the others.
+ *
+ * @param dst The image.
+ */
+void BitMask::toImage(Image &dst) const
+{
+    Image output(this->width, this->height);
+    Parallel::forRows(0, this->height, [&](unsigned int first, unsigned int last)
+                      {
+                          for (unsigned int i = first; i < last; ++i)
+                          {
+                              const unsigned char *in = row(i);
+                              unsigned char *out = output.row(i);
+                              for (unsigned int j = 0; j < this->width; ++j)
+                                  out[j] = (in[j / 8] >> (j % 8)) & 1 ? 255 : 0;
+                          }
+                      },
+                      64);
+    dst = output;
+}
+
+/**
+ * Packs one row of bytes, every non-zero byte giving a set bit.
+ *
+ * With SSE2, 16 bytes are compared to zero at once and their byte mask gives 2 packed bytes.
+ *
+ * @param in The width bytes of the row.
+ * @param width The width of the row.
+ * @param out The (width + 7) / 8 packed bytes.
+ */
+void BitMask::packRow(const unsigned char *in, unsigned int width, unsigned char *out)
+{
+    unsigned int j = 0;
+#ifdef IMAGE_PROCESSING_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; j + 16 <= width; j += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + j));
+        unsigned int bits = ~_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) & 0xFFFF;
+        out[j / 8] = static_cast<unsigned char>(bits);
+        out[j / 8 + 1] = static_cast<unsigned char>(bits >> 8);
+    }
+#endif
+    for (; j < width; j += 8)
+    {
+        unsigned char byte = 0;
+        for (unsigned int k = 0; k < 8 && j + k < width; ++k)
+            byte |= static_cast<unsigned char>((in[j + k] != 0) << k);
+        out[j / 8] = byte;
+    }
+}
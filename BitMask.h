@@ -0,0 +1,136 @@
+#pragma once
+#include <vector>
+#include "Image.h"
+
+/**
+ * @class BitMask
+ * @brief Represents a binary mask stored with one bit per pixel.
+ *
+ * Every row is packed into bytes, the pixel at column j being bit (j % 8) of byte (j / 8), and
+ * padded to a whole number of bytes. A mask therefore takes 8 times less memory than the same
+ * mask stored in an Image.
+ */
+class BitMask
+{
+private:
+    unsigned int width;              ///< The width of the mask.
+    unsigned int height;             ///< The height of the mask.
+    unsigned int stride;             ///< The number of bytes of every row.
+    std::vector<unsigned char> bits; ///< The packed rows, one after another.
+
+public:
+    /**
+     * @brief Default constructor.
+     *
+     * Initializes an empty mask.
+     */
+    BitMask();
+
+    /**
+     * @brief Constructs a mask with every pixel cleared.
+     *
+     * @param width The width of the mask.
+     * @param height The height of the mask.
+     */
+    BitMask(unsigned int width, unsigned int height);
+
+    /**
+     * @brief Constructs the mask of the non-zero pixels of an image.
+     *
+     * @param img The image.
+     */
+    BitMask(const Image &img);
+
+    /**
+     * @brief Get the width of the mask.
+     *
+     * @return The width.
+     */
+    unsigned int getWidth() const;
+
+    /**
+     * @brief Get the height of the mask.
+     *
+     * @return The height.
+     */
+    unsigned int getHeight() const;
+
+    /**
+     * @brief Get the size of the mask.
+     *
+     * @return The size.
+     */
+    Size size() const;
+
+    /**
+     * @brief Get the number of bytes of every packed row.
+     *
+     * @return The stride.
+     */
+    unsigned int getStride() const;
+
+    /**
+     * @brief Resizes the mask, clearing every pixel.
+     *
+     * @param newWidth The new width.
+     * @param newHeight The new height.
+     */
+    void resize(unsigned int newWidth, unsigned int newHeight);
+
+    /**
+     * @brief Returns whether a pixel is set.
+     *
+     * @param x The row of the pixel.
+     * @param y The column of the pixel.
+     * @return True if the pixel is set.
+     */
+    bool get(unsigned int x, unsigned int y) const;
+
+    /**
+     * @brief Sets or clears a pixel.
+     *
+     * @param x The row of the pixel.
+     * @param y The column of the pixel.
+     * @param value True to set the pixel, false to clear it.
+     */
+    void set(unsigned int x, unsigned int y, bool value);
+
+    /**
+     * @brief Returns the packed bytes of a row.
+     *
+     * @param y The row.
+     * @return A pointer to the stride bytes of the row.
+     */
+    unsigned char *row(unsigned int y);
+
+    /**
+     * @brief Returns the packed bytes of a row.
+     *
+     * @param y The row.
+     * @return A pointer to the stride bytes of the row.
+     */
+    const unsigned char *row(unsigned int y) const;
+
+    /**
+     * @brief Counts the pixels that are set.
+     *
+     * @return The number of set pixels.
+     */
+    unsigned long long count() const;
+
+    /**
+     * @brief Expands the mask to an image, with 255 for the set pixels and 0 for the others.
+     *
+     * @param dst The image.
+     */
+    void toImage(Image &dst) const;
+
+    /**
+     * @brief Packs one row of bytes, every non-zero byte giving a set bit.
+     *
+     * @param in The width bytes of the row.
+     * @param width The width of the row.
+     * @param out The (width + 7) / 8 packed bytes.
+     */
+    static void packRow(const unsigned char *in, unsigned int width, unsigned char *out);
+};
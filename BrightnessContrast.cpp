@@ -1,5 +1,9 @@
 #include "BrightnessContrast.h"
 #include "Image.h"
+#include "Parallel.h"
+#include "ImageMetrics.h"
+#include "Trace.h"
+#include <algorithm>
 #include <iostream>
 
 /**
@@ -11,7 +15,10 @@
  * @param None
  * @return None
  */
-BrightnessContrast::BrightnessContrast() : gain{1}, bias{0} {}
+BrightnessContrast::BrightnessContrast() : gain{1}, bias{0}
+{
+    updateTable();
+}
 
 /**
  * @brief Constructs a new BrightnessContrast object with the specified gain and bias.
@@ -23,6 +30,7 @@ BrightnessContrast::BrightnessContrast(double gain, double bias)
 {
     this->gain = gain;
     this->bias = bias;
+    updateTable();
 }
 
 /**
@@ -36,7 +44,10 @@ BrightnessContrast::BrightnessContrast(double gain, double bias)
 void BrightnessContrast::setGain(double gain)
 {
     if (gain > 0)
+    {
         this->gain = gain;
+        updateTable();
+    }
     else
         std::cerr << "Gain should be positive!";
 }
@@ -63,6 +74,7 @@ double BrightnessContrast::getGain() const
 void BrightnessContrast::setBias(double bias)
 {
     this->bias = bias;
+    updateTable();
 }
 
 /**
@@ -75,21 +87,79 @@ double BrightnessContrast::getBias() const
     return this->bias;
 }
 
+/**
+ * Recomputes the adjusted value of every pixel value: the value is scaled by the gain, truncated
+ * and clamped to 0-255, then shifted by the bias, truncated and clamped again.
+ */
+void BrightnessContrast::updateTable()
+{
+    for (int v = 0; v < 256; ++v)
+    {
+        int scaled = static_cast<int>(std::min(std::max(v * this->gain, 0.0), 255.0));
+        this->table[v] = static_cast<unsigned char>(std::min(std::max(scaled + this->bias, 0.0), 255.0));
+    }
+}
+
 /**
  * Applies brightness and contrast adjustments to the source image and stores the result in the destination image.
  *
+ * Every pixel is looked up in the precomputed table, in parallel row bands, and dst keeps its
+ * buffers when it already has the size of src.
+ *
  * @param src The source image to be processed.
  * @param dst The destination image where the processed image will be stored.
  */
 void BrightnessContrast::process(const Image &src, Image &dst)
 {
-    dst = src;
-    dst = dst * gain;
-    for (int i = 0; i < dst.getHeight(); ++i)
+    TRACE_SCOPE("BrightnessContrast::process", "process");
+    ImageMetrics::Site site("BrightnessContrast::process");
+    dst.create(src.getWidth(), src.getHeight());
+    unsigned char **in = src.getData();
+    unsigned char **out = dst.getData();
+    Parallel::forRows(0, dst.getHeight(), [&](unsigned int first, unsigned int last)
+                      { processRows(in, src.size(), out, dst.size(), first, last); },
+                      64);
+}
+
+/**
+ * @brief The adjustment maps every pixel on its own, so it can run in place.
+ *
+ * @return True.
+ */
+bool BrightnessContrast::supportsInPlace() const
+{
+    return true;
+}
+
+/**
+ * @brief The adjustment maps every pixel on its own, so it can be computed a range of rows at a time.
+ *
+ * @return True.
+ */
+bool BrightnessContrast::supportsRows() const
+{
+    return true;
+}
+
+/**
+ * Computes the rows [first, last) of the output, looking every pixel up in the precomputed table.
+ *
+ * @param in The rows of the source.
+ * @param inputSize The size of the source.
+ * @param out The rows of the output.
+ * @param outputSize The size of the output.
+ * @param first The first row to compute.
+ * @param last One past the last row to compute.
+ */
+void BrightnessContrast::processRows(unsigned char **in, const Size & /* inputSize */, unsigned char **out, const Size &outputSize,
+                                     unsigned int first, unsigned int last)
+{
+    unsigned int width = outputSize.getWidth();
+    for (unsigned int i = first; i < last; ++i)
     {
-        for (int j = 0; j < dst.getWidth(); ++j)
-        {
-            dst.setPixel(i, j, dst.at(i, j) + bias);
-        }
+        const unsigned char *row = in[i];
+        unsigned char *output = out[i];
+        for (unsigned int j = 0; j < width; ++j)
+            output[j] = this->table[row[j]];
     }
 }
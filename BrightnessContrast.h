@@ -10,6 +10,12 @@ class BrightnessContrast : public ImageProcessing
 private:
     double gain; /**< The gain value for adjusting the image's brightness. */
     double bias; /**< The bias value for adjusting the image's contrast. */
+    unsigned char table[256]; /**< The adjusted value of every pixel value, recomputed when the gain or bias changes. */
+
+    /**
+     * @brief Recomputes the adjusted value of every pixel value.
+     */
+    void updateTable();
 
 public:
     /**
@@ -54,4 +60,29 @@ public:
      * @param dst The destination image.
      */
     void process(const Image &src, Image &dst) override;
+
+    /**
+     * @brief The adjustment maps every pixel on its own, so it can run in place.
+     * @return True.
+     */
+    bool supportsInPlace() const override;
+
+    /**
+     * @brief The adjustment maps every pixel on its own, so it can be computed a range of rows at a time.
+     * @return True.
+     */
+    bool supportsRows() const override;
+
+    /**
+     * @brief Computes the rows [first, last) of the output.
+     *
+     * @param in The rows of the source.
+     * @param inputSize The size of the source.
+     * @param out The rows of the output.
+     * @param outputSize The size of the output.
+     * @param first The first row to compute.
+     * @param last One past the last row to compute.
+     */
+    void processRows(unsigned char **in, const Size &inputSize, unsigned char **out, const Size &outputSize,
+                     unsigned int first, unsigned int last) override;
 };
\ No newline at end of file
@@ -0,0 +1,298 @@
+#include <cmath>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+#include "Canny.h"
+#include "Parallel.h"
+#include "ImageMetrics.h"
+#include "Trace.h"
+
+static const unsigned char NO_EDGE = 0;     ///< The pixel is not an edge.
+static const unsigned char WEAK_EDGE = 1;   ///< The pixel is an edge only if it is connected to a strong edge.
+static const unsigned char STRONG_EDGE = 2; ///< The pixel is an edge.
+
+static const long TAN_22_5 = 13573; ///< tan(22.5 degrees) in Q15 fixed point.
+static const long TAN_67_5 = 79109; ///< tan(67.5 degrees) in Q15 fixed point.
+
+/**
+ * Promotes every weak edge 8-connected to a pixel on the stack to a strong edge.
+ *
+ * Only the rows in [rowBegin, rowEnd) are visited, which keeps the parallel bands independent.
+ *
+ * @param edges The edge classification of every pixel of the image.
+ * @param stack The strong edge pixels (as linear indices) to grow from. Emptied on return.
+ * @param width The width of the image.
+ * @param rowBegin The first row that may be visited.
+ * @param rowEnd One past the last row that may be visited.
+ */
+static void growEdges(std::vector<unsigned char> &edges, std::vector<unsigned int> &stack,
+                      unsigned int width, unsigned int rowBegin, unsigned int rowEnd)
+{
+    while (!stack.empty())
+    {
+        unsigned int index = stack.back();
+        stack.pop_back();
+        int row = index / width;
+        int col = index % width;
+        for (int i = row - 1; i <= row + 1; ++i)
+        {
+            if (i < static_cast<int>(rowBegin) || i >= static_cast<int>(rowEnd))
+                continue;
+            for (int j = col - 1; j <= col + 1; ++j)
+            {
+                if (j < 0 || j >= static_cast<int>(width))
+                    continue;
+                unsigned int neighbour = i * width + j;
+                if (edges[neighbour] == WEAK_EDGE)
+                {
+                    edges[neighbour] = STRONG_EDGE;
+                    stack.push_back(neighbour);
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Runs blur, gradients, non-maximum suppression and band-local hysteresis on the rows [first, last).
+ *
+ * The blurred image and the gradient magnitudes are only computed for the band and its halo
+ * (two rows for the blur, one row for the gradients), so they stay in small per-band buffers.
+ *
+ * @param src The source image.
+ * @param edges The edge classification of every pixel of the image.
+ * @param first The first row of the band.
+ * @param last One past the last row of the band.
+ * @param lowSquared The squared lower threshold.
+ * @param highSquared The squared upper threshold.
+ */
+static void detectBand(const Image &src, std::vector<unsigned char> &edges, unsigned int first, unsigned int last,
+                       long long lowSquared, long long highSquared)
+{
+    unsigned int width = src.getWidth();
+    unsigned int height = src.getHeight();
+    unsigned char **data = src.getData();
+
+    // 3x3 Gaussian blur (1 2 1) of the band and its halo, with replicated borders.
+    unsigned int blurFirst = first >= 2 ? first - 2 : 0;
+    unsigned int blurLast = last + 2 < height ? last + 2 : height;
+    std::vector<unsigned char> blurred((blurLast - blurFirst) * width);
+    std::vector<int> column(width);
+    for (unsigned int i = blurFirst; i < blurLast; ++i)
+    {
+        const unsigned char *up = data[i > 0 ? i - 1 : 0];
+        const unsigned char *mid = data[i];
+        const unsigned char *down = data[i + 1 < height ? i + 1 : height - 1];
+        for (unsigned int j = 0; j < width; ++j)
+            column[j] = up[j] + 2 * mid[j] + down[j];
+
+        unsigned char *out = &blurred[(i - blurFirst) * width];
+        out[0] = static_cast<unsigned char>((3 * column[0] + column[1] + 8) >> 4);
+        for (unsigned int j = 1; j + 1 < width; ++j)
+            out[j] = static_cast<unsigned char>((column[j - 1] + 2 * column[j] + column[j + 1] + 8) >> 4);
+        out[width - 1] = static_cast<unsigned char>((column[width - 2] + 3 * column[width - 1] + 8) >> 4);
+    }
+
+    // Sobel gradients: squared magnitude and quantized direction. Image borders keep a zero magnitude.
+    unsigned int magFirst = first > 0 ? first - 1 : 0;
+    unsigned int magLast = last + 1 < height ? last + 1 : height;
+    std::vector<int> magnitude((magLast - magFirst) * width, 0);
+    std::vector<unsigned char> direction((magLast - magFirst) * width, 0);
+    unsigned int gradFirst = magFirst > 0 ? magFirst : 1;
+    unsigned int gradLast = magLast < height - 1 ? magLast : height - 1;
+    for (unsigned int i = gradFirst; i < gradLast; ++i)
+    {
+        const unsigned char *b0 = &blurred[(i - 1 - blurFirst) * width];
+        const unsigned char *b1 = &blurred[(i - blurFirst) * width];
+        const unsigned char *b2 = &blurred[(i + 1 - blurFirst) * width];
+        int *mag = &magnitude[(i - magFirst) * width];
+        unsigned char *dir = &direction[(i - magFirst) * width];
+        for (unsigned int j = 1; j + 1 < width; ++j)
+        {
+            int gx = (b0[j + 1] - b0[j - 1]) + 2 * (b1[j + 1] - b1[j - 1]) + (b2[j + 1] - b2[j - 1]);
+            int gy = (b2[j - 1] + 2 * b2[j] + b2[j + 1]) - (b0[j - 1] + 2 * b0[j] + b0[j + 1]);
+            mag[j] = gx * gx + gy * gy;
+
+            long ax = std::abs(gx);
+            long ay = static_cast<long>(std::abs(gy)) << 15;
+            if (ay < ax * TAN_22_5)
+                dir[j] = 0; // gradient along the row: compare left and right
+            else if (ay > ax * TAN_67_5)
+                dir[j] = 1; // gradient along the column: compare up and down
+            else
+                dir[j] = (gx ^ gy) >= 0 ? 2 : 3; // main or anti-diagonal
+        }
+    }
+
+    // Non-maximum suppression and classification; strong edges seed the band-local hysteresis.
+    std::vector<unsigned int> stack;
+    unsigned int nmsFirst = first > 1 ? first : 1;
+    unsigned int nmsLast = last < height - 1 ? last : height - 1;
+    for (unsigned int i = nmsFirst; i < nmsLast; ++i)
+    {
+        const int *up = &magnitude[(i - 1 - magFirst) * width];
+        const int *mid = &magnitude[(i - magFirst) * width];
+        const int *down = &magnitude[(i + 1 - magFirst) * width];
+        const unsigned char *dir = &direction[(i - magFirst) * width];
+        for (unsigned int j = 1; j + 1 < width; ++j)
+        {
+            int m = mid[j];
+            if (m <= lowSquared)
+                continue;
+
+            int a, b;
+            switch (dir[j])
+            {
+            case 0:
+                a = mid[j - 1];
+                b = mid[j + 1];
+                break;
+            case 1:
+                a = up[j];
+                b = down[j];
+                break;
+            case 2:
+                a = up[j - 1];
+                b = down[j + 1];
+                break;
+            default:
+                a = up[j + 1];
+                b = down[j - 1];
+                break;
+            }
+            if (m > a && m >= b)
+            {
+                unsigned int index = i * width + j;
+                if (m > highSquared)
+                {
+                    edges[index] = STRONG_EDGE;
+                    stack.push_back(index);
+                }
+                else
+                    edges[index] = WEAK_EDGE;
+            }
+        }
+    }
+    growEdges(edges, stack, width, first, last);
+}
+
+/**
+ * @brief Default constructor for the Canny class.
+ * Initializes the hysteresis thresholds to 50 and 100.
+ */
+Canny::Canny() : lowThreshold{50}, highThreshold{100} {}
+
+/**
+ * @brief Constructs a Canny object with the specified hysteresis thresholds.
+ *
+ * @param lowThreshold The lower hysteresis threshold.
+ * @param highThreshold The upper hysteresis threshold.
+ */
+Canny::Canny(double lowThreshold, double highThreshold)
+{
+    this->lowThreshold = lowThreshold;
+    this->highThreshold = highThreshold;
+}
+
+/**
+ * @brief Get the lower hysteresis threshold.
+ *
+ * @return The lower threshold.
+ */
+double Canny::getLowThreshold() const
+{
+    return this->lowThreshold;
+}
+
+/**
+ * @brief Get the upper hysteresis threshold.
+ *
+ * @return The upper threshold.
+ */
+double Canny::getHighThreshold() const
+{
+    return this->highThreshold;
+}
+
+/**
+ * @brief Sets the lower hysteresis threshold.
+ *
+ * @param newThreshold The new lower threshold.
+ */
+void Canny::setLowThreshold(double newThreshold)
+{
+    this->lowThreshold = newThreshold;
+}
+
+/**
+ * @brief Sets the upper hysteresis threshold.
+ *
+ * @param newThreshold The new upper threshold.
+ */
+void Canny::setHighThreshold(double newThreshold)
+{
+    this->highThreshold = newThreshold;
+}
+
+/**
+ * Detects the edges of the source image and stores the edge map in the destination image.
+ *
+ * Each row band is detected independently. Hysteresis inside a band cannot follow an edge
+ * across the band boundary, so afterwards every strong edge on either side of a seam is grown
+ * again over the whole image, which connects the weak edges the bands could not reach.
+ *
+ * @param src The source image.
+ * @param dst The destination image (255 for edge pixels, 0 otherwise).
+ */
+void Canny::process(const Image &src, Image &dst)
+{
+    TRACE_SCOPE("Canny::process", "process");
+    ImageMetrics::Site site("Canny::process");
+    unsigned int width = src.getWidth();
+    unsigned int height = src.getHeight();
+    Image output(width, height);
+    if (width < 3 || height < 3)
+    {
+        dst = output;
+        return;
+    }
+
+    long long lowSquared = static_cast<long long>(std::floor(this->lowThreshold * this->lowThreshold));
+    long long highSquared = static_cast<long long>(std::floor(this->highThreshold * this->highThreshold));
+
+    std::vector<unsigned char> edges(static_cast<size_t>(width) * height, NO_EDGE);
+    std::vector<unsigned int> seams;
+    std::mutex seamsMutex;
+    Parallel::forRows(0, height, [&](unsigned int first, unsigned int last)
+                      {
+                          detectBand(src, edges, first, last, lowSquared, highSquared);
+                          if (first > 0)
+                          {
+                              std::lock_guard<std::mutex> lock(seamsMutex);
+                              seams.push_back(first);
+                          }
+                      });
+
+    // Stitch the bands: continue the hysteresis across every seam.
+    std::vector<unsigned int> stack;
+    for (unsigned int seam : seams)
+    {
+        for (unsigned int i = seam - 1; i <= seam; ++i)
+            for (unsigned int j = 0; j < width; ++j)
+                if (edges[i * width + j] == STRONG_EDGE)
+                    stack.push_back(i * width + j);
+    }
+    growEdges(edges, stack, width, 0, height);
+
+    Parallel::forRows(0, height, [&](unsigned int first, unsigned int last)
+                      {
+                          for (unsigned int i = first; i < last; ++i)
+                          {
+                              unsigned char *out = output.row(i);
+                              const unsigned char *edge = &edges[i * width];
+                              for (unsigned int j = 0; j < width; ++j)
+                                  out[j] = edge[j] == STRONG_EDGE ? 255 : 0;
+                          }
+                      });
+    dst = output;
+}
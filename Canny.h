@@ -0,0 +1,71 @@
+#pragma once
+#include "ImageProcessing.h"
+
+/**
+ * @class Canny
+ * @brief A class that represents the Canny edge detector.
+ *
+ * The Canny class fuses the whole edge detection chain into one operator: a 3x3 Gaussian blur,
+ * the horizontal and vertical Sobel gradients, non-maximum suppression along the gradient
+ * direction and hysteresis thresholding. The image is processed in parallel row bands; each band
+ * carries its own halo rows so the blur and the gradients never leave the cache, and the
+ * hysteresis results of neighbouring bands are stitched together along the band seams.
+ *
+ * The output image has the same size as the input. Edge pixels are set to 255, all others to 0.
+ */
+class Canny : public ImageProcessing
+{
+private:
+    double lowThreshold;  /**< Gradient magnitudes below this value are never edges. */
+    double highThreshold; /**< Gradient magnitudes above this value are always edges. */
+
+public:
+    /**
+     * @brief Constructs a Canny object with the default thresholds (50 and 100).
+     */
+    Canny();
+
+    /**
+     * @brief Constructs a Canny object with the specified hysteresis thresholds.
+     *
+     * @param lowThreshold The lower hysteresis threshold.
+     * @param highThreshold The upper hysteresis threshold.
+     */
+    Canny(double lowThreshold, double highThreshold);
+
+    /**
+     * @brief Get the lower hysteresis threshold.
+     *
+     * @return The lower threshold.
+     */
+    double getLowThreshold() const;
+
+    /**
+     * @brief Get the upper hysteresis threshold.
+     *
+     * @return The upper threshold.
+     */
+    double getHighThreshold() const;
+
+    /**
+     * @brief Set the lower hysteresis threshold.
+     *
+     * @param newThreshold The new lower threshold.
+     */
+    void setLowThreshold(double newThreshold);
+
+    /**
+     * @brief Set the upper hysteresis threshold.
+     *
+     * @param newThreshold The new upper threshold.
+     */
+    void setHighThreshold(double newThreshold);
+
+    /**
+     * @brief Detects the edges of the source image and stores the edge map in the destination image.
+     *
+     * @param src The source image.
+     * @param dst The destination image (255 for edge pixels, 0 otherwise).
+     */
+    void process(const Image &src, Image &dst) override;
+};
@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <vector>
+#include "Clahe.h"
+#include "Histogram.h"
+#include "Parallel.h"
+#include "ImageMetrics.h"
+#include "Trace.h"
+
+/**
+ * Computes, for every position along one axis, the two tiles whose centers surround it and the
+ * weight of the second one (in 1/256 units).
+ *
+ * @param length The length of the axis.
+ * @param bounds The tile boundaries along the axis (tiles + 1 values).
+ * @param first The index of the first tile of every position.
+ * @param second The index of the second tile of every position.
+ * @param weight The weight of the second tile of every position.
+ */
+static void interpolationWeights(unsigned int length, const std::vector<unsigned int> &bounds,
+                                 std::vector<unsigned int> &first, std::vector<unsigned int> &second, std::vector<int> &weight)
+{
+    unsigned int tiles = static_cast<unsigned int>(bounds.size()) - 1;
+    std::vector<double> centers(tiles);
+    for (unsigned int k = 0; k < tiles; ++k)
+        centers[k] = (bounds[k] + bounds[k + 1] - 1) / 2.0;
+
+    first.resize(length);
+    second.resize(length);
+    weight.resize(length);
+    unsigned int k = 0;
+    for (unsigned int x = 0; x < length; ++x)
+    {
+        if (x <= centers[0] || x >= centers[tiles - 1])
+        {
+            first[x] = second[x] = x <= centers[0] ? 0 : tiles - 1;
+            weight[x] = 0;
+            continue;
+        }
+        while (centers[k + 1] <= x)
+            ++k;
+        first[x] = k;
+        second[x] = k + 1;
+        weight[x] = static_cast<int>((x - centers[k]) / (centers[k + 1] - centers[k]) * 256 + 0.5);
+    }
+}
+
+/**
+ * @brief Default constructor for the Clahe class.
+ * Initializes a clip limit of 2 and an 8x8 tile grid.
+ */
+Clahe::Clahe() : clipLimit{2}, tilesX{8}, tilesY{8} {}
+
+/**
+ * @brief Constructs a Clahe object with the specified clip limit and tile grid.
+ *
+ * @param clipLimit The clip limit, as a multiple of the average bin count of a tile.
+ * @param tilesX The number of tile columns.
+ * @param tilesY The number of tile rows.
+ */
+Clahe::Clahe(double clipLimit, unsigned int tilesX, unsigned int tilesY)
+{
+    this->clipLimit = clipLimit;
+    this->tilesX = tilesX > 0 ? tilesX : 1;
+    this->tilesY = tilesY > 0 ? tilesY : 1;
+}
+
+/**
+ * @brief Get the clip limit.
+ *
+ * @return The clip limit.
+ */
+double Clahe::getClipLimit() const
+{
+    return this->clipLimit;
+}
+
+/**
+ * @brief Sets the clip limit.
+ *
+ * @param newClipLimit The new clip limit. Values below 1 disable clipping.
+ */
+void Clahe::setClipLimit(double newClipLimit)
+{
+    this->clipLimit = newClipLimit;
+}
+
+/**
+ * @brief Get the size of the tile grid.
+ *
+ * @return The number of tile columns and rows.
+ */
+Size Clahe::getTileGrid() const
+{
+    return Size(this->tilesX, this->tilesY);
+}
+
+/**
+ * @brief Sets the size of the tile grid.
+ *
+ * @param grid The number of tile columns and rows.
+ */
+void Clahe::setTileGrid(Size grid)
+{
+    this->tilesX = grid.getWidth() > 0 ? grid.getWidth() : 1;
+    this->tilesY = grid.getHeight() > 0 ? grid.getHeight() : 1;
+}
+
+/**
+ * Applies CLAHE to the source image and stores the result in the destination image.
+ *
+ * The histogram of every tile is counted with the multi-bank histogram kernel, in parallel over
+ * the tile rows. The tiles do not overlap, so each pixel is counted exactly once and the tables
+ * are built from scratch rather than updated incrementally: sliding a histogram (adding the
+ * column that enters a window and removing the one that leaves) only saves work when windows
+ * overlap, as in per-pixel windowed CLAHE, which the interpolation between tiles replaces. Each
+ * histogram is then clipped, the clipped counts are redistributed evenly over all bins, and the
+ * result is turned into a lookup table. Finally every pixel interpolates between the tables of
+ * its four nearest tiles, written straight into dst.
+ *
+ * @param src The source image.
+ * @param dst The equalized image.
+ */
+void Clahe::process(const Image &src, Image &dst)
+{
+    TRACE_SCOPE("Clahe::process", "process");
+    ImageMetrics::Site site("Clahe::process");
+    if (&src == &dst)
+    {
+        Image copy(src);
+        process(copy, dst);
+        return;
+    }
+    unsigned int width = src.getWidth();
+    unsigned int height = src.getHeight();
+    dst.create(width, height);
+    if (width == 0 || height == 0)
+        return;
+
+    unsigned int tx = std::min(this->tilesX, width);
+    unsigned int ty = std::min(this->tilesY, height);
+    std::vector<unsigned int> boundsX(tx + 1), boundsY(ty + 1);
+    for (unsigned int k = 0; k <= tx; ++k)
+        boundsX[k] = static_cast<unsigned int>(static_cast<unsigned long long>(k) * width / tx);
+    for (unsigned int k = 0; k <= ty; ++k)
+        boundsY[k] = static_cast<unsigned int>(static_cast<unsigned long long>(k) * height / ty);
+
+    std::vector<unsigned char> luts(static_cast<size_t>(tx) * ty * 256);
+    Parallel::forRows(0, ty, [&](unsigned int firstTile, unsigned int lastTile)
+                      {
+                          std::vector<unsigned int> bins(256);
+                          for (unsigned int r = firstTile; r < lastTile; ++r)
+                          {
+                              for (unsigned int c = 0; c < tx; ++c)
+                              {
+                                  std::fill(bins.begin(), bins.end(), 0);
+                                  Histogram::accumulate(src.getData(), boundsY[r], boundsY[r + 1], boundsX[c], boundsX[c + 1], bins.data());
+                                  unsigned long long area = static_cast<unsigned long long>(boundsX[c + 1] - boundsX[c]) *
+                                                            (boundsY[r + 1] - boundsY[r]);
+
+                                  if (this->clipLimit >= 1)
+                                  {
+                                      unsigned int limit = std::max(1u, static_cast<unsigned int>(this->clipLimit * area / 256));
+                                      unsigned long long excess = 0;
+                                      for (unsigned int &bin : bins)
+                                          if (bin > limit)
+                                          {
+                                              excess += bin - limit;
+                                              bin = limit;
+                                          }
+                                      unsigned int share = static_cast<unsigned int>(excess / 256);
+                                      unsigned int residual = static_cast<unsigned int>(excess % 256);
+                                      for (unsigned int &bin : bins)
+                                          bin += share;
+                                      if (residual > 0)
+                                      {
+                                          unsigned int step = std::max(256u / residual, 1u);
+                                          for (unsigned int v = 0; v < 256 && residual > 0; v += step, --residual)
+                                              ++bins[v];
+                                      }
+                                  }
+
+                                  unsigned char *lut = &luts[(static_cast<size_t>(r) * tx + c) * 256];
+                                  unsigned long long cdf = 0;
+                                  for (unsigned int v = 0; v < 256; ++v)
+                                  {
+                                      cdf += bins[v];
+                                      lut[v] = static_cast<unsigned char>(std::min<unsigned long long>((cdf * 255 + area / 2) / area, 255));
+                                  }
+                              }
+                          }
+                      },
+                      1);
+
+    std::vector<unsigned int> left, right, top, bottom;
+    std::vector<int> weightX, weightY;
+    interpolationWeights(width, boundsX, left, right, weightX);
+    interpolationWeights(height, boundsY, top, bottom, weightY);
+
+    unsigned char **output = dst.getData();
+    Parallel::forRows(0, height, [&](unsigned int first, unsigned int last)
+                      {
+                          for (unsigned int i = first; i < last; ++i)
+                          {
+                              const unsigned char *in = src.getData()[i];
+                              unsigned char *out = output[i];
+                              const unsigned char *upper = &luts[static_cast<size_t>(top[i]) * tx * 256];
+                              const unsigned char *lower = &luts[static_cast<size_t>(bottom[i]) * tx * 256];
+                              int wy = weightY[i];
+                              for (unsigned int j = 0; j < width; ++j)
+                              {
+                                  unsigned int v = in[j];
+                                  int wx = weightX[j];
+                                  size_t l = static_cast<size_t>(left[j]) * 256 + v;
+                                  size_t r = static_cast<size_t>(right[j]) * 256 + v;
+                                  int upperValue = upper[l] * (256 - wx) + upper[r] * wx;
+                                  int lowerValue = lower[l] * (256 - wx) + lower[r] * wx;
+                                  out[j] = static_cast<unsigned char>((upperValue * (256 - wy) + lowerValue * wy + (1 << 15)) >> 16);
+                              }
+                          }
+                      });
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "ImageProcessing.h"
+
+/**
+ * @class Clahe
+ * @brief A class that represents contrast limited adaptive histogram equalization (CLAHE).
+ *
+ * The image is divided into a grid of tiles and every tile is equalized with its own histogram.
+ * Each histogram is clipped at a limit before equalizing, which bounds the contrast amplification
+ * in flat regions. Output pixels blend the lookup tables of the four nearest tiles bilinearly, so
+ * no seams appear along the tile borders.
+ */
+class Clahe : public ImageProcessing
+{
+private:
+    double clipLimit;    /**< The clip limit, as a multiple of the average bin count of a tile. */
+    unsigned int tilesX; /**< The number of tile columns. */
+    unsigned int tilesY; /**< The number of tile rows. */
+
+public:
+    /**
+     * @brief Default constructor.
+     *
+     * Initializes a clip limit of 2 and an 8x8 tile grid.
+     */
+    Clahe();
+
+    /**
+     * @brief Constructs a Clahe object with the specified clip limit and tile grid.
+     *
+     * @param clipLimit The clip limit, as a multiple of the average bin count of a tile.
+     * @param tilesX The number of tile columns.
+     * @param tilesY The number of tile rows.
+     */
+    Clahe(double clipLimit, unsigned int tilesX = 8, unsigned int tilesY = 8);
+
+    /**
+     * @brief Get the clip limit.
+     *
+     * @return The clip limit.
+     */
+    double getClipLimit() const;
+
+    /**
+     * @brief Set the clip limit.
+     *
+     * @param newClipLimit The new clip limit. Values below 1 disable clipping.
+     */
+    void setClipLimit(double newClipLimit);
+
+    /**
+     * @brief Get the size of the tile grid.
+     *
+     * @return The number of tile columns and rows.
+     */
+    Size getTileGrid() const;
+
+    /**
+     * @brief Set the size of the tile grid.
+     *
+     * @param grid The number of tile columns and rows.
+     */
+    void setTileGrid(Size grid);
+
+    /**
+     * @brief Applies CLAHE to the source image and stores the result in the destination image.
+     *
+     * @param src The source image.
+     * @param dst The equalized image.
+     */
+    void process(const Image &src, Image &dst) override;
+};
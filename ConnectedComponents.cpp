@@ -0,0 +1,307 @@
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include "ConnectedComponents.h"
+#include "Parallel.h"
+
+/**
+ * The statistics accumulated for one provisional label during the first pass.
+ */
+struct LabelStatistics
+{
+    unsigned long long area;
+    unsigned long long sumX;
+    unsigned long long sumY;
+    unsigned int minX, minY, maxX, maxY;
+};
+
+/**
+ * The provisional labels handed out by one strip, [base + 1, base + statistics.size()].
+ */
+struct StripLabels
+{
+    unsigned int base;
+    std::vector<LabelStatistics> statistics;
+};
+
+/**
+ * @brief Default constructor for the ConnectedComponents class.
+ * Initializes a labeler with 8-connectivity.
+ */
+ConnectedComponents::ConnectedComponents() : connectivity{EIGHT}, width{0}, height{0} {}
+
+/**
+ * @brief Constructs a labeler with the specified connectivity.
+ *
+ * @param connectivity The connectivity of the components.
+ */
+ConnectedComponents::ConnectedComponents(Connectivity connectivity) : connectivity{connectivity}, width{0}, height{0} {}
+
+/**
+ * @brief Get the connectivity of the components.
+ *
+ * @return The connectivity.
+ */
+ConnectedComponents::Connectivity ConnectedComponents::getConnectivity() const
+{
+    return this->connectivity;
+}
+
+/**
+ * @brief Sets the connectivity of the components.
+ *
+ * @param newConnectivity The new connectivity.
+ */
+void ConnectedComponents::setConnectivity(Connectivity newConnectivity)
+{
+    this->connectivity = newConnectivity;
+}
+
+/**
+ * @brief Finds the root of a provisional label, halving the path to it.
+ *
+ * @param label The provisional label.
+ * @return The root, which is the smallest label of its set.
+ */
+unsigned int ConnectedComponents::find(unsigned int label)
+{
+    while (this->parents[label] != label)
+    {
+        this->parents[label] = this->parents[this->parents[label]];
+        label = this->parents[label];
+    }
+    return label;
+}
+
+/**
+ * @brief Merges the sets of two provisional labels, the smaller root becoming the root of both.
+ *
+ * @param a The first label.
+ * @param b The second label.
+ * @return The root of the merged set.
+ */
+unsigned int ConnectedComponents::merge(unsigned int a, unsigned int b)
+{
+    a = find(a);
+    b = find(b);
+    if (a < b)
+        this->parents[b] = a;
+    else
+        this->parents[a] = b;
+    return std::min(a, b);
+}
+
+/**
+ * Labels the components of the non-zero pixels of an image.
+ *
+ * Every strip starting at row r hands out provisional labels from r * width + 1 on, so the
+ * strips never share a label and may update the union-find table concurrently. Each pixel only
+ * looks at its already labeled neighbors within the strip; when the pixel above is set it is
+ * reused directly, otherwise the left and upper-right neighbors are merged if both are set. The
+ * first row of every strip is joined to the last row of the previous one afterwards, serially.
+ *
+ * Because a merge always makes the smaller root the parent, the table can then be flattened in
+ * a single increasing sweep into consecutive final labels.
+ *
+ * @param img The image, typically a binary mask.
+ * @return The number of components.
+ */
+unsigned int ConnectedComponents::compute(const Image &img)
+{
+    this->width = img.getWidth();
+    this->height = img.getHeight();
+    this->components.clear();
+    unsigned long long area = static_cast<unsigned long long>(this->width) * this->height;
+    if (area >= 0xFFFFFFFFull)
+        throw std::invalid_argument("Image too large to be labeled with 32-bit labels.");
+    this->labels.resize(area);
+    this->parents.resize(area + 1);
+    if (area == 0)
+        return 0;
+
+    unsigned int width = this->width;
+    bool eight = this->connectivity == EIGHT;
+    std::vector<StripLabels> strips;
+    std::mutex stripsMutex;
+    Parallel::forRows(0, this->height, [&](unsigned int first, unsigned int last)
+                      {
+                          StripLabels strip;
+                          strip.base = first * width;
+                          unsigned int next = strip.base + 1;
+                          for (unsigned int i = first; i < last; ++i)
+                          {
+                              const unsigned char *in = img.getData()[i];
+                              unsigned int *out = &this->labels[static_cast<size_t>(i) * width];
+                              const unsigned int *up = i > first ? out - width : nullptr;
+                              for (unsigned int j = 0; j < width; ++j)
+                              {
+                                  if (in[j] == 0)
+                                  {
+                                      out[j] = 0;
+                                      continue;
+                                  }
+
+                                  unsigned int above = up ? up[j] : 0;
+                                  unsigned int left = j > 0 ? out[j - 1] : 0;
+                                  unsigned int l;
+                                  if (eight)
+                                  {
+                                      // The pixel above touches all the other neighbors, which are then already merged with it.
+                                      if (above)
+                                          l = above;
+                                      else
+                                      {
+                                          if (!left && up && j > 0)
+                                              left = up[j - 1];
+                                          unsigned int right = up && j + 1 < width ? up[j + 1] : 0;
+                                          if (right)
+                                              l = left && left != right ? merge(left, right) : right;
+                                          else
+                                              l = left;
+                                      }
+                                  }
+                                  else if (above && left)
+                                      l = above != left ? merge(above, left) : above;
+                                  else
+                                      l = above ? above : left;
+
+                                  if (!l)
+                                  {
+                                      l = next++;
+                                      this->parents[l] = l;
+                                      strip.statistics.push_back({0, 0, 0, j, i, j, i});
+                                  }
+                                  out[j] = l;
+
+                                  LabelStatistics &s = strip.statistics[l - strip.base - 1];
+                                  ++s.area;
+                                  s.sumX += j;
+                                  s.sumY += i;
+                                  s.minX = std::min(s.minX, j);
+                                  s.maxX = std::max(s.maxX, j);
+                                  s.maxY = i;
+                              }
+                          }
+
+                          std::lock_guard<std::mutex> lock(stripsMutex);
+                          strips.push_back(std::move(strip));
+                      },
+                      32);
+
+    std::sort(strips.begin(), strips.end(), [](const StripLabels &a, const StripLabels &b)
+              { return a.base < b.base; });
+
+    // Join every strip to the one above it.
+    for (size_t k = 1; k < strips.size(); ++k)
+    {
+        const unsigned int *row = &this->labels[strips[k].base];
+        const unsigned int *up = row - width;
+        for (unsigned int j = 0; j < width; ++j)
+        {
+            if (!row[j])
+                continue;
+            if (up[j])
+                merge(row[j], up[j]);
+            if (eight && j > 0 && up[j - 1])
+                merge(row[j], up[j - 1]);
+            if (eight && j + 1 < width && up[j + 1])
+                merge(row[j], up[j + 1]);
+        }
+    }
+
+    // Flatten the table: roots get the next final label, the others the label of their parent.
+    unsigned int count = 0;
+    for (const StripLabels &strip : strips)
+        for (unsigned int l = strip.base + 1; l <= strip.base + strip.statistics.size(); ++l)
+            this->parents[l] = this->parents[l] == l ? ++count : this->parents[this->parents[l]];
+
+    std::vector<LabelStatistics> merged(count, LabelStatistics{0, 0, 0, width, this->height, 0, 0});
+    for (const StripLabels &strip : strips)
+        for (size_t k = 0; k < strip.statistics.size(); ++k)
+        {
+            const LabelStatistics &s = strip.statistics[k];
+            LabelStatistics &m = merged[this->parents[strip.base + 1 + k] - 1];
+            m.area += s.area;
+            m.sumX += s.sumX;
+            m.sumY += s.sumY;
+            m.minX = std::min(m.minX, s.minX);
+            m.minY = std::min(m.minY, s.minY);
+            m.maxX = std::max(m.maxX, s.maxX);
+            m.maxY = std::max(m.maxY, s.maxY);
+        }
+
+    this->components.resize(count);
+    for (unsigned int k = 0; k < count; ++k)
+    {
+        const LabelStatistics &m = merged[k];
+        Component &c = this->components[k];
+        c.area = m.area;
+        c.boundingBox = Rectangle(m.minX, m.minY, m.maxX - m.minX + 1, m.maxY - m.minY + 1);
+        c.centroidX = static_cast<double>(m.sumX) / m.area;
+        c.centroidY = static_cast<double>(m.sumY) / m.area;
+    }
+
+    Parallel::forRows(0, this->height, [&](unsigned int first, unsigned int last)
+                      {
+                          unsigned int *out = &this->labels[static_cast<size_t>(first) * width];
+                          unsigned int *end = &this->labels[0] + static_cast<size_t>(last) * width;
+                          for (; out != end; ++out)
+                              if (*out)
+                                  *out = this->parents[*out];
+                      },
+                      64);
+    return count;
+}
+
+/**
+ * @brief Returns the size of the labeled image.
+ *
+ * @return The size of the labeled image.
+ */
+Size ConnectedComponents::size() const
+{
+    return Size(this->width, this->height);
+}
+
+/**
+ * @brief Returns the number of components.
+ *
+ * @return The number of components.
+ */
+unsigned int ConnectedComponents::getCount() const
+{
+    return static_cast<unsigned int>(this->components.size());
+}
+
+/**
+ * @brief Returns the statistics of every component.
+ *
+ * @return The components, the one at index k having the label k + 1.
+ */
+const std::vector<ConnectedComponents::Component> &ConnectedComponents::getComponents() const
+{
+    return this->components;
+}
+
+/**
+ * @brief Returns the label of a pixel.
+ *
+ * @param x The row of the pixel.
+ * @param y The column of the pixel.
+ * @return The label, 0 for the background.
+ */
+unsigned int ConnectedComponents::label(unsigned int x, unsigned int y) const
+{
+    return this->labels[static_cast<size_t>(x) * this->width + y];
+}
+
+/**
+ * @brief Returns the labels of one row.
+ *
+ * @param row The row.
+ * @return A pointer to the width labels of the row.
+ */
+const unsigned int *ConnectedComponents::labelRow(unsigned int row) const
+{
+    return &this->labels[static_cast<size_t>(row) * this->width];
+}
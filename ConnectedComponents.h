@@ -0,0 +1,143 @@
+#pragma once
+#include <vector>
+#include "Image.h"
+
+/**
+ * @class ConnectedComponents
+ * @brief Labels the connected components of the non-zero pixels of an image.
+ *
+ * Labeling is a two-pass scan with a union-find equivalence table. The first pass runs in
+ * parallel over row strips: every strip hands out provisional labels from its own range, records
+ * the equivalences it finds and accumulates the area, bounding box and centroid sums of every
+ * provisional label as it goes. The strips are then joined by merging the labels that touch
+ * across each seam, the table is flattened into consecutive final labels, and a second parallel
+ * pass rewrites the label image. No extra pass over the pixels is needed for the statistics.
+ *
+ * Labels are stored as 32-bit values, 0 for the background and 1 to getCount() for the
+ * components, numbered in raster order of their first pixel. The label and equivalence buffers
+ * are kept between calls and only grow when a larger frame is labeled.
+ */
+class ConnectedComponents
+{
+public:
+    /**
+     * @brief The pixel neighborhoods that connect two pixels.
+     */
+    enum Connectivity
+    {
+        FOUR = 4, ///< Pixels are connected through their edges.
+        EIGHT = 8 ///< Pixels are connected through their edges and their corners.
+    };
+
+    /**
+     * @brief The statistics of one component.
+     */
+    struct Component
+    {
+        unsigned long long area; ///< The number of pixels of the component.
+        Rectangle boundingBox;   ///< The bounding box, with (x, y) its top-left pixel.
+        double centroidX;        ///< The mean column of the pixels.
+        double centroidY;        ///< The mean row of the pixels.
+    };
+
+private:
+    Connectivity connectivity;         ///< The connectivity of the components.
+    unsigned int width;                ///< The width of the labeled image.
+    unsigned int height;               ///< The height of the labeled image.
+    std::vector<unsigned int> labels;  ///< The label of every pixel, row after row.
+    std::vector<unsigned int> parents; ///< The union-find table, indexed by provisional label.
+    std::vector<Component> components; ///< The statistics of every component, indexed by label - 1.
+
+public:
+    /**
+     * @brief Default constructor.
+     *
+     * Initializes a labeler with 8-connectivity.
+     */
+    ConnectedComponents();
+
+    /**
+     * @brief Constructs a labeler with the specified connectivity.
+     *
+     * @param connectivity The connectivity of the components.
+     */
+    ConnectedComponents(Connectivity connectivity);
+
+    /**
+     * @brief Get the connectivity of the components.
+     *
+     * @return The connectivity.
+     */
+    Connectivity getConnectivity() const;
+
+    /**
+     * @brief Sets the connectivity of the components.
+     *
+     * @param newConnectivity The new connectivity.
+     */
+    void setConnectivity(Connectivity newConnectivity);
+
+    /**
+     * @brief Labels the components of the non-zero pixels of an image, replacing the current labels.
+     *
+     * @param img The image, typically a binary mask.
+     * @return The number of components.
+     */
+    unsigned int compute(const Image &img);
+
+    /**
+     * @brief Returns the size of the labeled image.
+     *
+     * @return The size of the labeled image.
+     */
+    Size size() const;
+
+    /**
+     * @brief Returns the number of components.
+     *
+     * @return The number of components.
+     */
+    unsigned int getCount() const;
+
+    /**
+     * @brief Returns the statistics of every component.
+     *
+     * @return The components, the one at index k having the label k + 1.
+     */
+    const std::vector<Component> &getComponents() const;
+
+    /**
+     * @brief Returns the label of a pixel.
+     *
+     * @param x The row of the pixel.
+     * @param y The column of the pixel.
+     * @return The label, 0 for the background.
+     */
+    unsigned int label(unsigned int x, unsigned int y) const;
+
+    /**
+     * @brief Returns the labels of one row.
+     *
+     * @param row The row.
+     * @return A pointer to the width labels of the row.
+     */
+    const unsigned int *labelRow(unsigned int row) const;
+
+private:
+    /**
+     * @brief Finds the root of a provisional label, compressing the path to it.
+     *
+     * @param label The provisional label.
+     * @return The root, which is the smallest label of its set.
+     */
+    unsigned int find(unsigned int label);
+
+    /**
+     * @brief Merges the sets of two provisional labels.
+     *
+     * @param a The first label.
+     * @param b The second label.
+     * @return The root of the merged set.
+     */
+    unsigned int merge(unsigned int a, unsigned int b);
+};
@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "DistanceTransform.h"
+#include "Parallel.h"
+#include "ImageMetrics.h"
+#include "Trace.h"
+
+/**
+ * Returns the abscissa where the parabola rooted at q becomes lower than the one rooted at v < q.
+ */
+static inline double intersection(const double *f, unsigned int q, unsigned int v)
+{
+    return ((f[q] + static_cast<double>(q) * q) - (f[v] + static_cast<double>(v) * v)) / (2.0 * q - 2.0 * v);
+}
+
+/**
+ * Computes the squared distance transform of one row (Felzenszwalb and Huttenlocher).
+ *
+ * The parabolas (x - q)^2 + f[q] are scanned from left to right, keeping the ones that form the
+ * lower envelope in roots and the abscissas where each of them starts to be the lowest in starts.
+ * The envelope is then read back at every integer position.
+ *
+ * @param f The squared vertical distance of every column.
+ * @param n The number of columns.
+ * @param roots Scratch space for n parabola indices.
+ * @param starts Scratch space for n + 1 boundaries.
+ * @param out The squared distance of every column.
+ */
+static void lowerEnvelope(const double *f, unsigned int n, unsigned int *roots, double *starts, double *out)
+{
+    const double infinity = std::numeric_limits<double>::infinity();
+    unsigned int k = 0;
+    roots[0] = 0;
+    starts[0] = -infinity;
+    starts[1] = infinity;
+    for (unsigned int q = 1; q < n; ++q)
+    {
+        // The first boundary is -infinity, so the loop always stops at k = 0 at the latest.
+        double s = intersection(f, q, roots[k]);
+        while (s <= starts[k])
+            s = intersection(f, q, roots[--k]);
+        ++k;
+        roots[k] = q;
+        starts[k] = s;
+        starts[k + 1] = infinity;
+    }
+
+    k = 0;
+    for (unsigned int q = 0; q < n; ++q)
+    {
+        while (starts[k + 1] < q)
+            ++k;
+        double d = static_cast<double>(q) - roots[k];
+        out[q] = d * d + f[roots[k]];
+    }
+}
+
+/**
+ * Computes the distances of an image as floats.
+ *
+ * The vertical pass stores, for every pixel, the distance to the nearest object pixel of its
+ * column, or width + height when the column has none: that sentinel is larger than any real
+ * distance, so such columns never win the horizontal pass and need no special case there.
+ *
+ * @param src The source mask.
+ * @param distances The distance of every pixel, row after row.
+ */
+void DistanceTransform::compute(const Image &src, std::vector<float> &distances)
+{
+    unsigned int width = src.getWidth();
+    unsigned int height = src.getHeight();
+    distances.resize(static_cast<size_t>(width) * height);
+    if (width == 0 || height == 0)
+        return;
+    const float none = static_cast<float>(width) + height;
+
+    // Vertical pass, sweeping whole rows of a band of columns down and then up.
+    Parallel::forRows(0, width, [&](unsigned int first, unsigned int last)
+                      {
+                          for (unsigned int i = 0; i < height; ++i)
+                          {
+                              const unsigned char *in = src.getData()[i];
+                              float *out = &distances[static_cast<size_t>(i) * width];
+                              const float *above = i > 0 ? out - width : nullptr;
+                              for (unsigned int j = first; j < last; ++j)
+                                  out[j] = in[j] ? 0.0f : above ? std::min(above[j] + 1.0f, none) : none;
+                          }
+                          for (unsigned int i = height - 1; i-- > 0;)
+                          {
+                              float *out = &distances[static_cast<size_t>(i) * width];
+                              const float *below = out + width;
+                              for (unsigned int j = first; j < last; ++j)
+                                  out[j] = std::min(out[j], below[j] + 1.0f);
+                          }
+                      },
+                      64);
+
+    // Horizontal pass, one lower envelope per row.
+    Parallel::forRows(0, height, [&](unsigned int first, unsigned int last)
+                      {
+                          std::vector<double> f(width), squared(width), starts(width + 1);
+                          std::vector<unsigned int> roots(width);
+                          for (unsigned int i = first; i < last; ++i)
+                          {
+                              float *row = &distances[static_cast<size_t>(i) * width];
+                              for (unsigned int j = 0; j < width; ++j)
+                                  f[j] = static_cast<double>(row[j]) * row[j];
+                              lowerEnvelope(f.data(), width, roots.data(), starts.data(), squared.data());
+                              double limit = static_cast<double>(none) * none;
+                              for (unsigned int j = 0; j < width; ++j)
+                                  row[j] = squared[j] >= limit ? std::numeric_limits<float>::infinity()
+                                                               : static_cast<float>(std::sqrt(squared[j]));
+                          }
+                      });
+}
+
+/**
+ * Rounds and saturates the distances of the rows [first, last) to 8 bits.
+ */
+static void roundRows(const std::vector<float> &distances, Image &output, unsigned int first, unsigned int last)
+{
+    unsigned int width = output.getWidth();
+    for (unsigned int i = first; i < last; ++i)
+    {
+        const float *in = &distances[static_cast<size_t>(i) * width];
+        unsigned char *out = output.row(i);
+        for (unsigned int j = 0; j < width; ++j)
+            out[j] = in[j] >= 254.5f ? 255 : static_cast<unsigned char>(in[j] + 0.5f);
+    }
+}
+
+/**
+ * Computes the distances of an image, rounded and saturated to 8 bits.
+ *
+ * @param src The source mask.
+ * @param dst The distance image, of the same size as the source.
+ */
+void DistanceTransform::process(const Image &src, Image &dst)
+{
+    TRACE_SCOPE("DistanceTransform::process", "process");
+    ImageMetrics::Site site("DistanceTransform::process");
+    unsigned int width = src.getWidth();
+    unsigned int height = src.getHeight();
+    compute(src, this->distances);
+    dst.create(width, height);
+    Parallel::forRows(0, height, [&](unsigned int first, unsigned int last)
+                      { roundRows(this->distances, dst, first, last); });
+}
+
+/**
+ * Computes the distances of a batch of images, spread across the threads of the pool.
+ *
+ * Every thread keeps its own distance buffer for its run of images, instead of sharing the one of
+ * the object, so it is allocated once per run rather than once per image. The distances are
+ * computed before the output is written, so they are rounded straight into dst, even when it is
+ * the source itself.
+ *
+ * @param src The source masks.
+ * @param dst The distance images.
+ */
+void DistanceTransform::processBatch(const std::vector<Image> &src, std::vector<Image> &dst)
+{
+    TRACE_SCOPE("DistanceTransform::processBatch", "process");
+    ImageMetrics::Site site("DistanceTransform::processBatch");
+    dst.resize(src.size());
+    Parallel::forRows(0, static_cast<unsigned int>(src.size()), [&](unsigned int first, unsigned int last)
+                      {
+                          std::vector<float> distances;
+                          for (unsigned int i = first; i < last; ++i)
+                          {
+                              compute(src[i], distances);
+                              dst[i].create(src[i].getWidth(), src[i].getHeight());
+                              roundRows(distances, dst[i], 0, dst[i].getHeight());
+                          }
+                      },
+                      1);
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <vector>
+#include "ImageProcessing.h"
+
+/**
+ * @class DistanceTransform
+ * @brief A class that computes the exact Euclidean distance transform of a mask.
+ *
+ * Every pixel receives its Euclidean distance to the nearest non-zero pixel of the source image,
+ * so the object pixels themselves get 0. Thresholding the result at r dilates the mask by a disc
+ * of radius r, in a time that does not depend on r.
+ *
+ * The transform is separable and linear in the number of pixels (Felzenszwalb and Huttenlocher):
+ * a first pass finds the vertical distance to the nearest object pixel of every column, sweeping
+ * the rows of parallel column bands; a second pass then takes, in parallel over the rows, the
+ * lower envelope of the parabolas rooted at those vertical distances.
+ *
+ * process() writes the distances rounded and saturated to 255. compute() returns them as floats,
+ * with infinity for every pixel when the source has no object pixel.
+ */
+class DistanceTransform : public ImageProcessing
+{
+private:
+    std::vector<float> distances; ///< The float distances of the last processed image.
+
+public:
+    /**
+     * @brief Computes the distances of an image, rounded and saturated to 8 bits.
+     *
+     * @param src The source mask.
+     * @param dst The distance image, of the same size as the source.
+     */
+    void process(const Image &src, Image &dst) override;
+
+    /**
+     * @brief Computes the distances of a batch of images.
+     *
+     * @param src The source masks.
+     * @param dst The distance images.
+     */
+    void processBatch(const std::vector<Image> &src, std::vector<Image> &dst) override;
+
+    /**
+     * @brief Computes the distances of an image as floats.
+     *
+     * @param src The source mask.
+     * @param distances The distance of every pixel, row after row.
+     */
+    static void compute(const Image &src, std::vector<float> &distances);
+};
@@ -1,10 +1,69 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include "Draw.h"
+
+namespace
+{
+const long long MAX_EXACT_RADIUS = 46340;                 ///< The largest radius whose square fits in 31 bits.
+const long long MAX_EXACT_ANTIALIASED_RADIUS = 1LL << 23; ///< The largest radius whose square in 16.16 fixed point fits in 62 bits.
+} // namespace
+
 // Bresenham's algorithms
 
+/**
+ * Blends a color into a pixel, by a coverage in 1/256 units.
+ *
+ * @param pixel The pixel.
+ * @param color The color.
+ * @param alpha The coverage, between 0 (pixel unchanged) and 256 (pixel set to the color).
+ */
+static inline void blend(unsigned char &pixel, unsigned char color, unsigned int alpha)
+{
+    pixel = static_cast<unsigned char>((pixel * (256 - alpha) + color * alpha + 128) >> 8);
+}
+
+/**
+ * Returns the largest integer whose square is not greater than a non-negative value.
+ */
+static inline long long squareRoot(long long value)
+{
+    long long root = static_cast<long long>(std::sqrt(static_cast<double>(value)));
+    while (root > 0 && root * root > value)
+        --root;
+    while ((root + 1) * (root + 1) <= value)
+        ++root;
+    return root;
+}
+
+/**
+ * Returns the range of |d| over the offsets lo <= d <= hi.
+ *
+ * @param lo The smallest offset.
+ * @param hi The largest offset, not below lo.
+ * @param range Set to the smallest and the largest distance.
+ */
+static inline void distanceRange(long long lo, long long hi, long long range[2])
+{
+    range[0] = lo > 0 ? lo : (hi < 0 ? -hi : 0);
+    range[1] = std::max(-lo, hi);
+}
+
+/**
+ * Returns the largest integer not greater than a / b, for b > 0.
+ */
+static inline long long floorDivide(long long a, long long b)
+{
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
 /**
  * Draws a line on the given image using Bresenham's line algorithm.
  *
+ * The line is clipped to the image first, so only its visible part is rasterized.
+ *
  * @param img The image on which to draw the line.
  * @param p1 The starting point of the line.
  * @param p2 The ending point of the line.
@@ -12,6 +71,10 @@
  */
 void Draw::drawLine(Image &img, Point p1, Point p2, unsigned char color)
 {
+    if (!clipLine(Rectangle(0, 0, img.getWidth(), img.getHeight()), p1, p2))
+        return;
+    unsigned char **rows = img.getData();
+
     int dx = abs(p2.getX() - p1.getX());
     int dy = abs(p2.getY() - p1.getY());
     int sx = (p1.getX() < p2.getX()) ? 1 : -1;
@@ -20,7 +83,7 @@ void Draw::drawLine(Image &img, Point p1, Point p2, unsigned char color)
 
     while (true)
     {
-        img.setPixel(p1.getY(), p1.getX(), color);
+        rows[p1.getY()][p1.getX()] = color;
 
         if (p1.getX() == p2.getX() && p1.getY() == p2.getY())
             break;
@@ -39,9 +102,172 @@ void Draw::drawLine(Image &img, Point p1, Point p2, unsigned char color)
     }
 }
 
+/**
+ * Draws a thick line on the given image, one horizontal span per row.
+ *
+ * The line covers the pixels whose centers lie within thickness / 2 of the segment, measured
+ * across it, and within half a pixel of its end points, measured along it. Both bounds are
+ * linear in the column, so every row is covered by a single span, found in closed form. A
+ * thickness of 1 or less draws the plain line.
+ *
+ * @param img The image on which to draw the line.
+ * @param p1 The starting point of the line.
+ * @param p2 The ending point of the line.
+ * @param color The color of the line.
+ * @param thickness The thickness of the line, in pixels.
+ */
+void Draw::drawLine(Image &img, Point p1, Point p2, unsigned char color, int thickness)
+{
+    if (thickness <= 1)
+    {
+        drawLine(img, p1, p2, color);
+        return;
+    }
+    double x0 = p1.getX();
+    double y0 = p1.getY();
+    double dx = p2.getX() - x0;
+    double dy = p2.getY() - y0;
+    double length = std::sqrt(dx * dx + dy * dy);
+    double ux = length > 0 ? dx / length : 1.0;
+    double uy = length > 0 ? dy / length : 0.0;
+    double half = thickness / 2.0;
+
+    // The bounds along the line and across it, with the corners of the covered quad.
+    const double along[2] = {-0.5, length + 0.5};
+    const double across[2] = {-half, half};
+    double top = INFINITY, bottom = -INFINITY;
+    for (double s : along)
+        for (double d : across)
+        {
+            top = std::min(top, y0 + s * uy + d * ux);
+            bottom = std::max(bottom, y0 + s * uy + d * ux);
+        }
+    long long width = img.getWidth();
+    long long first = std::max(static_cast<long long>(std::floor(top)), 0LL);
+    long long last = std::min(static_cast<long long>(std::ceil(bottom)), static_cast<long long>(img.getHeight()) - 1);
+
+    unsigned char **rows = img.getData();
+    for (long long y = first; y <= last; ++y)
+    {
+        double ry = y - y0;
+        double x0Span = -INFINITY, x1Span = INFINITY;
+        // Keeps the columns x with lo <= a (x - x0) + b < hi.
+        auto keep = [&](double a, double b, double lo, double hi)
+        {
+            if (a == 0)
+            {
+                if (b < lo || b >= hi)
+                    x1Span = -INFINITY;
+            }
+            else if (a > 0)
+            {
+                x0Span = std::max(x0Span, std::ceil((lo - b) / a));
+                x1Span = std::min(x1Span, std::ceil((hi - b) / a) - 1);
+            }
+            else
+            {
+                x0Span = std::max(x0Span, std::floor((hi - b) / a) + 1);
+                x1Span = std::min(x1Span, std::floor((lo - b) / a));
+            }
+        };
+        keep(ux, ry * uy, along[0], along[1]);
+        keep(-uy, ry * ux, across[0], across[1]);
+        double left = std::max(x0Span + x0, 0.0);
+        double right = std::min(x1Span + x0, static_cast<double>(width - 1));
+        if (x0Span > x1Span || left > right)
+            continue;
+        long long a = static_cast<long long>(left);
+        long long b = static_cast<long long>(right);
+        std::memset(rows[y] + a, color, static_cast<size_t>(b - a) + 1);
+    }
+}
+
+/**
+ * Draws an anti-aliased line on the given image with Xiaolin Wu's algorithm.
+ *
+ * The line is walked along its major axis, one pixel per step, with its position on the minor
+ * axis in 16.16 fixed point. Every step blends the color into the two pixels straddling that
+ * position, each by its share of the coverage, given by the top 8 bits of the fraction. Only the
+ * steps landing in the image are walked.
+ *
+ * @param img The image on which to draw the line.
+ * @param p1 The starting point of the line.
+ * @param p2 The ending point of the line.
+ * @param color The color of the line.
+ */
+void Draw::drawAntialiasedLine(Image &img, Point p1, Point p2, unsigned char color)
+{
+    long long x0 = p1.getX(), y0 = p1.getY();
+    long long x1 = p2.getX(), y1 = p2.getY();
+    bool steep = std::llabs(y1 - y0) > std::llabs(x1 - x0);
+    if (steep)
+    {
+        std::swap(x0, y0);
+        std::swap(x1, y1);
+    }
+    if (x0 > x1)
+    {
+        std::swap(x0, x1);
+        std::swap(y0, y1);
+    }
+    long long major = steep ? img.getHeight() : img.getWidth();
+    long long minor = steep ? img.getWidth() : img.getHeight();
+    long long dx = x1 - x0;
+    long long dy = y1 - y0;
+    long long gradient = dx == 0 ? 0 : dy * 65536 / dx;
+
+    // Skips the steps before the line enters the image, and after it leaves it.
+    long long first = std::max(x0, 0LL);
+    long long last = std::min(x1, major - 1);
+    if (gradient > 0)
+    {
+        first = std::max(first, x0 + floorDivide((-1 - y0) * 65536, gradient) - 1);
+        last = std::min(last, x0 + floorDivide(minor * 65536 - y0 * 65536, gradient) + 1);
+    }
+    else if (gradient < 0)
+    {
+        first = std::max(first, x0 + floorDivide(y0 * 65536 - minor * 65536, -gradient) - 1);
+        last = std::min(last, x0 + floorDivide((y0 + 1) * 65536, -gradient) + 1);
+    }
+    if (first > last)
+        return;
+
+    long long intery = y0 * 65536;
+    if (first > x0)
+    {
+        long long offset = dy * (first - x0);
+        long long quotient = floorDivide(offset, dx);
+        intery = (y0 + quotient) * 65536 + (offset - quotient * dx) * 65536 / dx;
+    }
+
+    unsigned char **rows = img.getData();
+    for (long long x = first; x <= last; ++x, intery += gradient)
+    {
+        long long y = intery >> 16;
+        unsigned int fraction = static_cast<unsigned int>(intery >> 8) & 255;
+        if (steep)
+        {
+            if (y >= 0 && y < minor)
+                blend(rows[x][y], color, 256 - fraction);
+            if (fraction != 0 && y + 1 >= 0 && y + 1 < minor)
+                blend(rows[x][y + 1], color, fraction);
+        }
+        else
+        {
+            if (y >= 0 && y < minor)
+                blend(rows[y][x], color, 256 - fraction);
+            if (fraction != 0 && y + 1 >= 0 && y + 1 < minor)
+                blend(rows[y + 1][x], color, fraction);
+        }
+    }
+}
+
 /**
  * Draws a circle on the given image.
  *
+ * Circles outside of the image are skipped, and the pixels of circles crossing its border are
+ * only checked when the circle is not completely inside.
+ *
  * @param img The image on which the circle will be drawn.
  * @param center The center point of the circle.
  * @param radius The radius of the circle.
@@ -49,20 +275,34 @@ void Draw::drawLine(Image &img, Point p1, Point p2, unsigned char color)
  */
 void Draw::drawCircle(Image &img, Point center, int radius, unsigned char color)
 {
+    int width = static_cast<int>(img.getWidth());
+    int height = static_cast<int>(img.getHeight());
+    int cx = center.getX();
+    int cy = center.getY();
+    if (radius < 0 || cx + radius < 0 || cy + radius < 0 || cx - radius >= width || cy - radius >= height)
+        return;
+    bool inside = cx - radius >= 0 && cy - radius >= 0 && cx + radius < width && cy + radius < height;
+    unsigned char **rows = img.getData();
+    auto plot = [&](int row, int col)
+    {
+        if (inside || (row >= 0 && col >= 0 && row < height && col < width))
+            rows[row][col] = color;
+    };
+
     int x = radius;
     int y = 0;
     int radiusError = 1 - x;
 
     while (x >= y)
     {
-        img.setPixel(center.getY() + y, center.getX() + x, color);
-        img.setPixel(center.getY() + x, center.getX() + y, color);
-        img.setPixel(center.getY() - x, center.getX() + y, color);
-        img.setPixel(center.getY() - y, center.getX() + x, color);
-        img.setPixel(center.getY() - y, center.getX() - x, color);
-        img.setPixel(center.getY() - x, center.getX() - y, color);
-        img.setPixel(center.getY() + x, center.getX() - y, color);
-        img.setPixel(center.getY() + y, center.getX() - x, color);
+        plot(cy + y, cx + x);
+        plot(cy + x, cx + y);
+        plot(cy - x, cx + y);
+        plot(cy - y, cx + x);
+        plot(cy - y, cx - x);
+        plot(cy - x, cx - y);
+        plot(cy + x, cx - y);
+        plot(cy + y, cx - x);
 
         y++;
         if (radiusError < 0)
@@ -77,6 +317,144 @@ void Draw::drawCircle(Image &img, Point center, int radius, unsigned char color)
     }
 }
 
+/**
+ * Draws a thick circle on the given image, as a ring of horizontal spans.
+ *
+ * The ring covers the pixels of the filled circle of radius radius - thickness / 2 + thickness - 1
+ * that are not in the filled circle of radius radius - thickness / 2 - 1, both rounded like
+ * fillCircle, so every row is covered by one or two spans. A thickness of 1 or less draws the
+ * plain circle.
+ *
+ * @param img The image on which the circle will be drawn.
+ * @param center The center point of the circle.
+ * @param radius The radius of the middle of the outline.
+ * @param color The color of the circle.
+ * @param thickness The thickness of the outline, in pixels.
+ */
+void Draw::drawCircle(Image &img, Point center, int radius, unsigned char color, int thickness)
+{
+    if (thickness <= 1)
+    {
+        drawCircle(img, center, radius, color);
+        return;
+    }
+    long long cx = center.getX();
+    long long cy = center.getY();
+    long long inner = static_cast<long long>(radius) - thickness / 2 - 1;
+    long long outer = inner + thickness;
+    long long width = img.getWidth();
+    long long height = img.getHeight();
+    if (outer < 0 || cx + outer < 0 || cy + outer < 0 || cx - outer >= width || cy - outer >= height)
+        return;
+
+    unsigned char **rows = img.getData();
+    auto span = [&](long long y, long long x0, long long x1)
+    {
+        x0 = std::max(x0, 0LL);
+        x1 = std::min(x1, width - 1);
+        if (x0 <= x1)
+            std::memset(rows[y] + x0, color, static_cast<size_t>(x1 - x0) + 1);
+    };
+    for (long long y = std::max(cy - outer, 0LL); y <= std::min(cy + outer, height - 1); ++y)
+    {
+        long long dy = y - cy;
+        long long outerWidth = squareRoot(outer * outer + outer - dy * dy);
+        long long innerRemaining = inner * inner + inner - dy * dy;
+        if (inner < 0 || innerRemaining < 0)
+            span(y, cx - outerWidth, cx + outerWidth);
+        else
+        {
+            long long innerWidth = squareRoot(innerRemaining);
+            span(y, cx - outerWidth, cx - innerWidth - 1);
+            span(y, cx + innerWidth + 1, cx + outerWidth);
+        }
+    }
+}
+
+/**
+ * Draws an anti-aliased circle on the given image with Xiaolin Wu's algorithm.
+ *
+ * One octant is walked one column at a time, with the height of the circle computed in 8.8 fixed
+ * point from an integer square root. The color is blended into the two pixels straddling that
+ * height, each by its share of the coverage, and mirrored into the other seven octants; pixels
+ * shared by two octants are blended only once. Only the columns of the octant whose pixels land
+ * in the image are walked. Radii up to MAX_EXACT_ANTIALIASED_RADIUS use the exact integer root;
+ * larger ones compute the height in double.
+ *
+ * @param img The image on which the circle will be drawn.
+ * @param center The center point of the circle.
+ * @param radius The radius of the circle.
+ * @param color The color of the circle.
+ */
+void Draw::drawAntialiasedCircle(Image &img, Point center, int radius, unsigned char color)
+{
+    long long width = img.getWidth();
+    long long height = img.getHeight();
+    long long cx = center.getX();
+    long long cy = center.getY();
+    long long r = radius;
+    if (r < 0 || cx + r + 1 < 0 || cy + r + 1 < 0 || cx - r - 1 >= width || cy - r - 1 >= height)
+        return;
+    bool inside = cx - r - 1 >= 0 && cy - r - 1 >= 0 && cx + r + 1 < width && cy + r + 1 < height;
+    unsigned char **rows = img.getData();
+    auto plot = [&](long long row, long long col, unsigned int alpha)
+    {
+        if (inside || (row >= 0 && col >= 0 && row < height && col < width))
+            blend(rows[row][col], color, alpha);
+    };
+    // Plots the pixels at (+-dx, +-dy) from the center, once each.
+    auto plot4 = [&](long long dx, long long dy, unsigned int alpha)
+    {
+        if (alpha == 0)
+            return;
+        plot(cy + dy, cx + dx, alpha);
+        if (dx != 0)
+            plot(cy + dy, cx - dx, alpha);
+        if (dy != 0)
+        {
+            plot(cy - dy, cx + dx, alpha);
+            if (dx != 0)
+                plot(cy - dy, cx - dx, alpha);
+        }
+    };
+
+    // Step x plots the columns cx +- x and the rows cy +- x, so only the steps where either of
+    // them lands in the image are walked: up to two ranges, merged when they overlap.
+    long long ranges[2][2];
+    distanceRange(-cx, width - 1 - cx, ranges[0]);
+    distanceRange(-cy, height - 1 - cy, ranges[1]);
+    if (ranges[1][0] < ranges[0][0])
+        std::swap(ranges[0], ranges[1]);
+    int count = 2;
+    if (ranges[1][0] <= ranges[0][1] + 1)
+    {
+        ranges[0][1] = std::max(ranges[0][1], ranges[1][1]);
+        count = 1;
+    }
+
+    bool exact = r <= MAX_EXACT_ANTIALIASED_RADIUS;
+    for (int k = 0; k < count; ++k)
+        for (long long x = ranges[k][0]; x <= std::min(ranges[k][1], r); ++x)
+        {
+            long long height88;
+            if (exact)
+                height88 = squareRoot((r * r - x * x) * 65536);
+            else
+                height88 = static_cast<long long>(
+                    std::floor(std::sqrt(std::max((static_cast<double>(r) - x) * (static_cast<double>(r) + x), 0.0)) * 256));
+            long long y = height88 >> 8;
+            if (x > y)
+                break;
+            unsigned int fraction = static_cast<unsigned int>(height88 & 255);
+            plot4(x, y, 256 - fraction);
+            plot4(x, y + 1, fraction);
+            if (y != x)
+                plot4(y, x, 256 - fraction);
+            if (y + 1 != x)
+                plot4(y + 1, x, fraction);
+        }
+}
+
 /**
  * Draws a rectangle on the given image.
  *
@@ -118,4 +496,241 @@ void Draw::drawRectangle(Image &img, Point tl, Point br, unsigned char color)
     drawLine(img, Point(xTl, yTl), Point(xTl, yTl + dy), color);
     drawLine(img, Point(xTl, yTl + dy), Point(xBr, yBr), color);
     drawLine(img, Point(xBr, yTl), Point(xBr, yBr), color);
-}
\ No newline at end of file
+}
+
+/**
+ * Fills a horizontal span of a row, clipped to the image.
+ *
+ * @param img The image on which to draw the span.
+ * @param y The row of the span.
+ * @param x0 The first column of the span.
+ * @param x1 The last column of the span.
+ * @param color The color of the span.
+ */
+void Draw::fillSpan(Image &img, int y, int x0, int x1, unsigned char color)
+{
+    if (y < 0 || y >= static_cast<int>(img.getHeight()))
+        return;
+    x0 = std::max(x0, 0);
+    x1 = std::min(x1, static_cast<int>(img.getWidth()) - 1);
+    if (x0 <= x1)
+        std::memset(img.row(y) + x0, color, static_cast<size_t>(x1 - x0) + 1);
+}
+
+/**
+ * Fills a rectangle on the given image, one memset per row of its visible part.
+ *
+ * @param img The image on which the rectangle will be drawn.
+ * @param r The rectangle, covering the columns [x, x + width) and the rows [y, y + height).
+ * @param color The color of the rectangle.
+ */
+void Draw::fillRectangle(Image &img, Rectangle r, unsigned char color)
+{
+    long long x0 = std::max(r.getX(), 0);
+    long long y0 = std::max(r.getY(), 0);
+    long long x1 = std::min<long long>(static_cast<long long>(r.getX()) + r.getWidth(), img.getWidth());
+    long long y1 = std::min<long long>(static_cast<long long>(r.getY()) + r.getHeight(), img.getHeight());
+    if (x1 <= x0 || y1 <= y0)
+        return;
+    unsigned char **rows = img.getData();
+    for (long long y = y0; y < y1; ++y)
+        std::memset(rows[y] + x0, color, static_cast<size_t>(x1 - x0));
+}
+
+/**
+ * Fills a circle on the given image.
+ *
+ * @param img The image on which the circle will be drawn.
+ * @param center The center point of the circle.
+ * @param radius The radius of the circle.
+ * @param color The color of the circle.
+ */
+void Draw::fillCircle(Image &img, Point center, int radius, unsigned char color)
+{
+    fillEllipse(img, center, radius, radius, color);
+}
+
+/**
+ * Fills an axis-aligned ellipse on the given image.
+ *
+ * Only the visible rows are visited. The half-width of the span of row dy is the largest dx
+ * with dx^2 ry^2 + dy^2 rx^2 <= rx^2 ry^2 + rx ry (rx + ry) / 2; the slack term rounds the
+ * boundary like the midpoint outline, a circle filling every pixel with dx^2 + dy^2 <= r^2 + r.
+ * The test is exact in integers up to radii of MAX_EXACT_RADIUS, whose products still fit in a
+ * long long; larger radii are tested in double, off by less than a pixel.
+ *
+ * @param img The image on which the ellipse will be drawn.
+ * @param center The center point of the ellipse.
+ * @param radiusX The horizontal radius of the ellipse.
+ * @param radiusY The vertical radius of the ellipse.
+ * @param color The color of the ellipse.
+ */
+void Draw::fillEllipse(Image &img, Point center, int radiusX, int radiusY, unsigned char color)
+{
+    long long cx = center.getX();
+    long long cy = center.getY();
+    long long rx = radiusX;
+    long long ry = radiusY;
+    long long width = img.getWidth();
+    long long height = img.getHeight();
+    if (rx < 0 || ry < 0 || cx + rx < 0 || cy + ry < 0 || cx - rx >= width || cy - ry >= height)
+        return;
+
+    long long rx2 = rx * rx;
+    long long ry2 = ry * ry;
+    bool exact = rx <= MAX_EXACT_RADIUS && ry <= MAX_EXACT_RADIUS;
+    long long limit = exact ? rx2 * ry2 + rx * ry * (rx + ry) / 2 : 0;
+    unsigned char **rows = img.getData();
+    for (long long y = std::max(cy - ry, 0LL); y <= std::min(cy + ry, height - 1); ++y)
+    {
+        long long dy = y - cy;
+        long long dx;
+        if (ry == 0)
+            dx = rx;
+        else if (!exact)
+        {
+            double x = static_cast<double>(rx);
+            double yr = static_cast<double>(ry);
+            double d = static_cast<double>(dy);
+            double remaining = x * x * yr * yr + x * yr * (x + yr) / 2 - d * d * x * x;
+            dx = static_cast<long long>(std::floor(std::sqrt(std::max(remaining, 0.0)) / yr));
+        }
+        else
+        {
+            long long remaining = limit - dy * dy * rx2;
+            dx = static_cast<long long>(std::sqrt(static_cast<double>(remaining) / ry2));
+            while (dx > 0 && dx * dx * ry2 > remaining)
+                --dx;
+            while ((dx + 1) * (dx + 1) * ry2 <= remaining)
+                ++dx;
+        }
+        long long x0 = std::max(cx - dx, 0LL);
+        long long x1 = std::min(cx + dx, width - 1);
+        if (x0 <= x1)
+            std::memset(rows[y] + x0, color, static_cast<size_t>(x1 - x0) + 1);
+    }
+}
+
+/**
+ * Fills a polygon on the given image, with the even-odd rule.
+ *
+ * The polygon is scanned row by row over its visible rows only, keeping the edges that cross the
+ * current row in an active list. A row y crosses the edges with ymin <= y < ymax, and the pixels
+ * from the ceiling of one crossing up to (but excluding) the ceiling of the next are filled, so
+ * polygons that share an edge never fill the same pixel twice.
+ *
+ * @param img The image on which the polygon will be drawn.
+ * @param vertices The vertices of the polygon, the last one being joined to the first one.
+ * @param color The color of the polygon.
+ */
+void Draw::fillPolygon(Image &img, const std::vector<Point> &vertices, unsigned char color)
+{
+    struct Edge
+    {
+        int top, bottom;
+        double x, slope;
+    };
+    std::vector<Edge> edges;
+    for (size_t k = 0; k < vertices.size(); ++k)
+    {
+        Point a = vertices[k];
+        Point b = vertices[(k + 1) % vertices.size()];
+        if (a.getY() == b.getY())
+            continue;
+        if (a.getY() > b.getY())
+            std::swap(a, b);
+        edges.push_back({a.getY(), b.getY(), static_cast<double>(a.getX()),
+                         static_cast<double>(b.getX() - a.getX()) / (b.getY() - a.getY())});
+    }
+    if (edges.empty())
+        return;
+    std::sort(edges.begin(), edges.end(), [](const Edge &a, const Edge &b)
+              { return a.top < b.top; });
+
+    int top = edges.front().top;
+    int bottom = top;
+    for (const Edge &edge : edges)
+        bottom = std::max(bottom, edge.bottom);
+    int first = std::max(top, 0);
+    int last = std::min(bottom, static_cast<int>(img.getHeight()));
+
+    long long width = img.getWidth();
+    unsigned char **rows = img.getData();
+    std::vector<const Edge *> active;
+    std::vector<double> crossings;
+    size_t next = 0;
+    for (int y = first; y < last; ++y)
+    {
+        while (next < edges.size() && edges[next].top <= y)
+            active.push_back(&edges[next++]);
+        active.erase(std::remove_if(active.begin(), active.end(), [y](const Edge *edge)
+                                    { return edge->bottom <= y; }),
+                     active.end());
+
+        crossings.clear();
+        for (const Edge *edge : active)
+            crossings.push_back(edge->x + (y - edge->top) * edge->slope);
+        std::sort(crossings.begin(), crossings.end());
+        for (size_t k = 0; k + 1 < crossings.size(); k += 2)
+        {
+            long long x0 = std::max(static_cast<long long>(std::ceil(crossings[k])), 0LL);
+            long long x1 = std::min(static_cast<long long>(std::ceil(crossings[k + 1])), width);
+            if (x0 < x1)
+                std::memset(rows[y] + x0, color, static_cast<size_t>(x1 - x0));
+        }
+    }
+}
+
+/**
+ * Clips a line segment against a rectangle with the Liang-Barsky algorithm.
+ *
+ * The segment is written p1 + t (p2 - p1) for t in [0, 1], and every side of the rectangle
+ * narrows that range; the clipped end points are rounded to the nearest pixel. A segment
+ * completely inside the rectangle is left untouched.
+ *
+ * @param bounds The rectangle, covering the columns [x, x + width) and the rows [y, y + height).
+ * @param p1 The starting point of the segment, moved inside the rectangle.
+ * @param p2 The ending point of the segment, moved inside the rectangle.
+ * @return False if the segment is completely outside of the rectangle.
+ */
+bool Draw::clipLine(const Rectangle &bounds, Point &p1, Point &p2)
+{
+    if (bounds.getWidth() == 0 || bounds.getHeight() == 0)
+        return false;
+    double left = bounds.getX();
+    double top = bounds.getY();
+    double right = left + bounds.getWidth() - 1;
+    double bottom = top + bounds.getHeight() - 1;
+    double x = p1.getX();
+    double y = p1.getY();
+    double dx = static_cast<double>(p2.getX()) - x;
+    double dy = static_cast<double>(p2.getY()) - y;
+
+    const double p[4] = {-dx, dx, -dy, dy};
+    const double q[4] = {x - left, right - x, y - top, bottom - y};
+    double t0 = 0.0, t1 = 1.0;
+    for (int k = 0; k < 4; ++k)
+    {
+        if (p[k] == 0)
+        {
+            if (q[k] < 0)
+                return false;
+            continue;
+        }
+        double t = q[k] / p[k];
+        if (p[k] < 0)
+            t0 = std::max(t0, t);
+        else
+            t1 = std::min(t1, t);
+        if (t0 > t1)
+            return false;
+    }
+
+    if (t1 < 1.0)
+        p2 = Point(static_cast<int>(std::lround(std::min(std::max(x + t1 * dx, left), right))),
+                   static_cast<int>(std::lround(std::min(std::max(y + t1 * dy, top), bottom))));
+    if (t0 > 0.0)
+        p1 = Point(static_cast<int>(std::lround(std::min(std::max(x + t0 * dx, left), right))),
+                   static_cast<int>(std::lround(std::min(std::max(y + t0 * dy, top), bottom))));
+    return true;
+}
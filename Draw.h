@@ -1,10 +1,16 @@
 #pragma once
+#include <vector>
 #include "Image.h"
 #include "Point.h"
 #include "Rectangle.h"
 
 /**
  * @brief The Draw class provides static methods for drawing shapes on an Image.
+ *
+ * Points are given as (x, y) = (column, row). Every shape is clipped against the image before it
+ * is rasterized, so shapes that are partly or completely outside of the image are safe to draw
+ * and cost nothing for their hidden parts. Filled shapes are rasterized as horizontal spans,
+ * each written with a single memset.
  */
 class Draw
 {
@@ -19,6 +25,27 @@ public:
      */
     static void drawCircle(Image &img, Point center, int radius, unsigned char color);
 
+    /**
+     * @brief Draws a thick circle on the given Image.
+     *
+     * @param img The Image on which to draw the circle.
+     * @param center The center point of the circle.
+     * @param radius The radius of the middle of the outline.
+     * @param color The color of the circle.
+     * @param thickness The thickness of the outline, in pixels.
+     */
+    static void drawCircle(Image &img, Point center, int radius, unsigned char color, int thickness);
+
+    /**
+     * @brief Draws an anti-aliased circle on the given Image.
+     *
+     * @param img The Image on which to draw the circle.
+     * @param center The center point of the circle.
+     * @param radius The radius of the circle.
+     * @param color The color of the circle, blended with the image by the pixel coverage.
+     */
+    static void drawAntialiasedCircle(Image &img, Point center, int radius, unsigned char color);
+
     /**
      * @brief Draws a line on the given Image.
      *
@@ -29,6 +56,27 @@ public:
      */
     static void drawLine(Image &img, Point p1, Point p2, unsigned char color);
 
+    /**
+     * @brief Draws a thick line on the given Image.
+     *
+     * @param img The Image on which to draw the line.
+     * @param p1 The starting point of the line.
+     * @param p2 The ending point of the line.
+     * @param color The color of the line.
+     * @param thickness The thickness of the line, in pixels.
+     */
+    static void drawLine(Image &img, Point p1, Point p2, unsigned char color, int thickness);
+
+    /**
+     * @brief Draws an anti-aliased line on the given Image.
+     *
+     * @param img The Image on which to draw the line.
+     * @param p1 The starting point of the line.
+     * @param p2 The ending point of the line.
+     * @param color The color of the line, blended with the image by the pixel coverage.
+     */
+    static void drawAntialiasedLine(Image &img, Point p1, Point p2, unsigned char color);
+
     /**
      * @brief Draws a rectangle on the given Image.
      *
@@ -47,4 +95,64 @@ public:
      * @param color The color of the rectangle.
      */
     static void drawRectangle(Image &img, Point tl, Point br, unsigned char color);
+
+    /**
+     * @brief Fills a rectangle on the given Image.
+     *
+     * @param img The Image on which to draw the rectangle.
+     * @param r The rectangle, covering the columns [x, x + width) and the rows [y, y + height).
+     * @param color The color of the rectangle.
+     */
+    static void fillRectangle(Image &img, Rectangle r, unsigned char color);
+
+    /**
+     * @brief Fills a circle on the given Image.
+     *
+     * @param img The Image on which to draw the circle.
+     * @param center The center point of the circle.
+     * @param radius The radius of the circle.
+     * @param color The color of the circle.
+     */
+    static void fillCircle(Image &img, Point center, int radius, unsigned char color);
+
+    /**
+     * @brief Fills an axis-aligned ellipse on the given Image.
+     *
+     * @param img The Image on which to draw the ellipse.
+     * @param center The center point of the ellipse.
+     * @param radiusX The horizontal radius of the ellipse.
+     * @param radiusY The vertical radius of the ellipse.
+     * @param color The color of the ellipse.
+     */
+    static void fillEllipse(Image &img, Point center, int radiusX, int radiusY, unsigned char color);
+
+    /**
+     * @brief Fills a polygon on the given Image, with the even-odd rule.
+     *
+     * @param img The Image on which to draw the polygon.
+     * @param vertices The vertices of the polygon, the last one being joined to the first one.
+     * @param color The color of the polygon.
+     */
+    static void fillPolygon(Image &img, const std::vector<Point> &vertices, unsigned char color);
+
+    /**
+     * @brief Fills a horizontal span of a row, clipped to the Image.
+     *
+     * @param img The Image on which to draw the span.
+     * @param y The row of the span.
+     * @param x0 The first column of the span.
+     * @param x1 The last column of the span.
+     * @param color The color of the span.
+     */
+    static void fillSpan(Image &img, int y, int x0, int x1, unsigned char color);
+
+    /**
+     * @brief Clips a line segment against a rectangle (Liang-Barsky).
+     *
+     * @param bounds The rectangle, covering the columns [x, x + width) and the rows [y, y + height).
+     * @param p1 The starting point of the segment, moved inside the rectangle.
+     * @param p2 The ending point of the segment, moved inside the rectangle.
+     * @return False if the segment is completely outside of the rectangle.
+     */
+    static bool clipLine(const Rectangle &bounds, Point &p1, Point &p2);
 };
\ No newline at end of file
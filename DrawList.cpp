@@ -0,0 +1,359 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include "DrawList.h"
+#include "Parallel.h"
+
+/**
+ * Fills the columns [x0, x1] of a row, clipped to its width.
+ */
+static inline void fillSpan(unsigned char *row, int width, long long x0, long long x1, unsigned char color)
+{
+    x0 = std::max(x0, 0LL);
+    x1 = std::min(x1, static_cast<long long>(width) - 1);
+    if (x0 <= x1)
+        std::memset(row + x0, color, static_cast<size_t>(x1 - x0) + 1);
+}
+
+/**
+ * Returns the largest integer whose square is not greater than a non-negative value.
+ */
+static inline long long squareRoot(long long value)
+{
+    long long root = static_cast<long long>(std::sqrt(static_cast<double>(value)));
+    while (root > 0 && root * root > value)
+        --root;
+    while ((root + 1) * (root + 1) <= value)
+        ++root;
+    return root;
+}
+
+/**
+ * Returns the half-width of the row dy of a filled circle: the largest dx with dx^2 + dy^2 <= r^2 + r.
+ */
+static inline long long circleHalfWidth(long long radius, long long dy)
+{
+    return squareRoot(radius * radius + radius - dy * dy);
+}
+
+/**
+ * Returns the column offsets plotted on the row dy of the outline of Draw::drawCircle.
+ *
+ * The midpoint loop of Draw::drawCircle keeps x on the next row while (x - 1)^2 + y^2 <= r^2 - r,
+ * so on row y of the octant it sits at x(y) = m(y) + 1, with m(y) the largest m such that
+ * m^2 + y^2 <= r^2 - r, as long as x(y) >= y. A row t gets the column x(t) from that octant, and
+ * from the mirrored one the columns y <= t with x(y) = t, i.e. r^2 - r - t^2 < y^2 <= r^2 - r - (t - 1)^2.
+ *
+ * @param radius The radius of the circle.
+ * @param dy The row offset, between 0 and the radius.
+ * @param first Set to the smallest column offset.
+ * @param last Set to the largest column offset.
+ * @return False if the loop plots nothing on the row.
+ */
+static bool circleOutlineRun(long long radius, long long dy, long long &first, long long &last)
+{
+    if (radius == 0)
+    {
+        first = last = 0;
+        return true;
+    }
+    long long limit = radius * radius - radius;
+    first = LLONG_MAX;
+    last = -1;
+    if (limit - dy * dy >= 0)
+    {
+        long long x = squareRoot(limit - dy * dy) + 1;
+        if (x >= dy)
+            first = last = x;
+    }
+    long long above = limit - (dy - 1) * (dy - 1);
+    if (dy >= 1 && above >= 0)
+    {
+        long long below = limit - dy * dy;
+        long long low = below < 0 ? 0 : squareRoot(below) + 1;
+        long long high = std::min(squareRoot(above), dy);
+        if (low <= high)
+        {
+            first = std::min(first, low);
+            last = std::max(last, high);
+        }
+    }
+    return last >= 0;
+}
+
+/**
+ * @brief Default constructor for the DrawList class.
+ * Initializes an empty list rendered in parallel row bands.
+ */
+DrawList::DrawList() : parallel{true} {}
+
+/**
+ * Adds a line. The end points are stored top first, so that the line can be walked down the rows.
+ *
+ * @param p1 The starting point of the line.
+ * @param p2 The ending point of the line.
+ * @param color The color of the line.
+ */
+void DrawList::addLine(Point p1, Point p2, unsigned char color)
+{
+    if (p2.getY() < p1.getY())
+        std::swap(p1, p2);
+    this->primitives.push_back({LINE, p1.getX(), p1.getY(), p2.getX(), p2.getY(), p1.getY(), p2.getY(), color});
+}
+
+/**
+ * @brief Adds the outline of a rectangle, with the same pixels as Draw::drawRectangle.
+ *
+ * @param r The rectangle, whose outline covers the columns x to x + width and the rows y to y + height.
+ * @param color The color of the rectangle.
+ */
+void DrawList::addRectangle(Rectangle r, unsigned char color)
+{
+    int right = r.getX() + static_cast<int>(r.getWidth());
+    int bottom = r.getY() + static_cast<int>(r.getHeight());
+    this->primitives.push_back({RECTANGLE, r.getX(), r.getY(), right, bottom, r.getY(), bottom, color});
+}
+
+/**
+ * @brief Adds a filled rectangle, with the same pixels as Draw::fillRectangle.
+ *
+ * @param r The rectangle, covering the columns [x, x + width) and the rows [y, y + height).
+ * @param color The color of the rectangle.
+ */
+void DrawList::addFilledRectangle(Rectangle r, unsigned char color)
+{
+    if (r.getWidth() == 0 || r.getHeight() == 0)
+        return;
+    int right = r.getX() + static_cast<int>(r.getWidth()) - 1;
+    int bottom = r.getY() + static_cast<int>(r.getHeight()) - 1;
+    this->primitives.push_back({FILLED_RECTANGLE, r.getX(), r.getY(), right, bottom, r.getY(), bottom, color});
+}
+
+/**
+ * @brief Adds the outline of a circle, with the same pixels as Draw::drawCircle.
+ *
+ * @param center The center point of the circle.
+ * @param radius The radius of the circle.
+ * @param color The color of the circle.
+ */
+void DrawList::addCircle(Point center, int radius, unsigned char color)
+{
+    if (radius < 0)
+        return;
+    this->primitives.push_back({CIRCLE, center.getX(), center.getY(), radius, 0,
+                                center.getY() - radius, center.getY() + radius, color});
+}
+
+/**
+ * @brief Adds a filled circle, with the same pixels as Draw::fillCircle.
+ *
+ * @param center The center point of the circle.
+ * @param radius The radius of the circle.
+ * @param color The color of the circle.
+ */
+void DrawList::addFilledCircle(Point center, int radius, unsigned char color)
+{
+    if (radius < 0)
+        return;
+    this->primitives.push_back({FILLED_CIRCLE, center.getX(), center.getY(), radius, 0,
+                                center.getY() - radius, center.getY() + radius, color});
+}
+
+/**
+ * @brief Adds a cross-shaped marker.
+ *
+ * @param center The center point of the marker.
+ * @param size The length of each arm of the cross.
+ * @param color The color of the marker.
+ */
+void DrawList::addMarker(Point center, int size, unsigned char color)
+{
+    size = std::max(size, 0);
+    this->primitives.push_back({MARKER, center.getX(), center.getY(), size, 0,
+                                center.getY() - size, center.getY() + size, color});
+}
+
+/**
+ * @brief Removes every shape.
+ */
+void DrawList::clear()
+{
+    this->primitives.clear();
+}
+
+/**
+ * @brief Returns the number of shapes.
+ *
+ * @return The number of shapes.
+ */
+size_t DrawList::size() const
+{
+    return this->primitives.size();
+}
+
+/**
+ * @brief Returns whether rendering is split across parallel row bands.
+ *
+ * @return True for parallel rendering.
+ */
+bool DrawList::isParallel() const
+{
+    return this->parallel;
+}
+
+/**
+ * @brief Sets whether rendering is split across parallel row bands.
+ *
+ * @param newParallel True for parallel rendering.
+ */
+void DrawList::setParallel(bool newParallel)
+{
+    this->parallel = newParallel;
+}
+
+/**
+ * Draws the row of a shape.
+ *
+ * Lines and circles are rasterized in closed form, so any row can be drawn without walking the
+ * rows above it: a line that is mostly horizontal covers, on row k below its top, the steps t
+ * whose rounded height t * dy / |dx| is k, which is one span; a mostly vertical line covers the
+ * single column rounded from k * |dx| / dy. Circle outlines find the run of their row from the
+ * midpoint decision in closed form, so no memory is kept per row of a circle.
+ *
+ * @param primitive The shape.
+ * @param y The row, between the top and the bottom of the shape.
+ * @param row The pixels of the row.
+ * @param width The width of the row.
+ */
+void DrawList::renderRow(const Primitive &primitive, int y, unsigned char *row, int width) const
+{
+    long long x0 = primitive.x0;
+    long long y0 = primitive.y0;
+    long long x1 = primitive.x1;
+    long long y1 = primitive.y1;
+    unsigned char color = primitive.color;
+    switch (primitive.shape)
+    {
+    case LINE:
+    {
+        long long dx = x1 - x0;
+        long long dy = y1 - y0;
+        long long adx = std::llabs(dx);
+        long long sx = dx < 0 ? -1 : 1;
+        long long k = y - y0;
+        if (dy == 0)
+            fillSpan(row, width, std::min(x0, x1), std::max(x0, x1), color);
+        else if (adx > dy)
+        {
+            long long start = k == 0 ? 0 : (adx * (2 * k - 1) + 2 * dy - 1) / (2 * dy);
+            long long end = k == dy ? adx : (adx * (2 * k + 1) + 2 * dy - 1) / (2 * dy) - 1;
+            fillSpan(row, width, std::min(x0 + sx * start, x0 + sx * end), std::max(x0 + sx * start, x0 + sx * end), color);
+        }
+        else
+        {
+            long long x = x0 + sx * ((2 * k * adx + dy) / (2 * dy));
+            if (x >= 0 && x < width)
+                row[x] = color;
+        }
+        break;
+    }
+    case RECTANGLE:
+        if (y == y0 || y == y1)
+            fillSpan(row, width, x0, x1, color);
+        else
+        {
+            if (x0 >= 0 && x0 < width)
+                row[x0] = color;
+            if (x1 >= 0 && x1 < width)
+                row[x1] = color;
+        }
+        break;
+    case FILLED_RECTANGLE:
+        fillSpan(row, width, x0, x1, color);
+        break;
+    case CIRCLE:
+    {
+        long long first, last;
+        if (circleOutlineRun(x1, std::llabs(y - y0), first, last))
+        {
+            fillSpan(row, width, x0 - last, x0 - first, color);
+            fillSpan(row, width, x0 + first, x0 + last, color);
+        }
+        break;
+    }
+    case FILLED_CIRCLE:
+    {
+        long long dx = circleHalfWidth(x1, y - y0);
+        fillSpan(row, width, x0 - dx, x0 + dx, color);
+        break;
+    }
+    case MARKER:
+        if (y == y0)
+            fillSpan(row, width, x0 - x1, x0 + x1, color);
+        else if (x0 >= 0 && x0 < width)
+            row[x0] = color;
+        break;
+    }
+}
+
+/**
+ * Renders the rows [first, last).
+ *
+ * The shapes crossing the current row are kept in an active list in painting order: shapes
+ * join it when the sweep reaches their top row and leave it after their bottom row.
+ *
+ * @param rows The rows of the image.
+ * @param width The width of the image.
+ * @param first The first row.
+ * @param last One past the last row.
+ * @param order The shapes sorted by their top row.
+ */
+void DrawList::renderRows(unsigned char **rows, int width, int first, int last, const std::vector<size_t> &order) const
+{
+    std::vector<size_t> active;
+    size_t next = 0;
+    for (; next < order.size() && this->primitives[order[next]].top < first; ++next)
+        if (this->primitives[order[next]].bottom >= first)
+            active.push_back(order[next]);
+    std::sort(active.begin(), active.end());
+
+    for (int y = first; y < last; ++y)
+    {
+        for (; next < order.size() && this->primitives[order[next]].top <= y; ++next)
+            active.insert(std::upper_bound(active.begin(), active.end(), order[next]), order[next]);
+        active.erase(std::remove_if(active.begin(), active.end(), [this, y](size_t index)
+                                    { return this->primitives[index].bottom < y; }),
+                     active.end());
+        for (size_t index : active)
+            renderRow(this->primitives[index], y, rows[y], width);
+    }
+}
+
+/**
+ * Draws every shape on an image, in one sweep over its rows, optionally in parallel row bands.
+ *
+ * @param img The Image on which to draw.
+ */
+void DrawList::render(Image &img) const
+{
+    int width = static_cast<int>(img.getWidth());
+    int height = static_cast<int>(img.getHeight());
+    if (width == 0 || height == 0 || this->primitives.empty())
+        return;
+
+    std::vector<size_t> order(this->primitives.size());
+    for (size_t k = 0; k < order.size(); ++k)
+        order[k] = k;
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b)
+                     { return this->primitives[a].top < this->primitives[b].top; });
+
+    unsigned char **rows = img.getData();
+    if (this->parallel)
+        Parallel::forRows(0, height, [&](unsigned int first, unsigned int last)
+                          { renderRows(rows, width, static_cast<int>(first), static_cast<int>(last), order); },
+                          32);
+    else
+        renderRows(rows, width, 0, height, order);
+}
@@ -0,0 +1,167 @@
+#pragma once
+#include <vector>
+#include "Image.h"
+#include "Point.h"
+#include "Rectangle.h"
+
+/**
+ * @class DrawList
+ * @brief Collects drawing primitives and rasterizes them all in one sweep over the rows.
+ *
+ * Drawing thousands of annotations one Draw call at a time walks every shape on its own, and
+ * the vertical edges of boxes stride across the rows. A DrawList instead records the shapes
+ * and renders them row after row: every row is visited once, and every shape crossing it writes
+ * its horizontal span, or its one or two edge pixels, into that row. Shapes are painted in the
+ * order they were added, and everything outside of the image is clipped before it is written.
+ *
+ * Rendering can be split across parallel row bands, since the rows of a band are only written
+ * by the thread of that band.
+ */
+class DrawList
+{
+private:
+    /**
+     * @brief The kinds of recorded shapes.
+     */
+    enum Shape
+    {
+        LINE,
+        RECTANGLE,
+        FILLED_RECTANGLE,
+        CIRCLE,
+        FILLED_CIRCLE,
+        MARKER
+    };
+
+    /**
+     * @brief A recorded shape.
+     */
+    struct Primitive
+    {
+        Shape shape;         ///< The kind of shape.
+        int x0, y0, x1, y1;  ///< The two points of lines and the corners of rectangles, the center and radius of circles and markers.
+        int top, bottom;     ///< The first and last rows covered by the shape.
+        unsigned char color; ///< The color of the shape.
+    };
+
+    std::vector<Primitive> primitives; ///< The shapes, in painting order.
+    bool parallel;                     ///< True to render in parallel row bands.
+
+public:
+    /**
+     * @brief Default constructor.
+     *
+     * Initializes an empty list rendered in parallel row bands.
+     */
+    DrawList();
+
+    /**
+     * @brief Adds a line.
+     *
+     * Where the ideal line passes exactly halfway between two pixels, the chosen pixel may differ
+     * from the one of Draw::drawLine.
+     *
+     * @param p1 The starting point of the line.
+     * @param p2 The ending point of the line.
+     * @param color The color of the line.
+     */
+    void addLine(Point p1, Point p2, unsigned char color);
+
+    /**
+     * @brief Adds the outline of a rectangle, with the same pixels as Draw::drawRectangle.
+     *
+     * @param r The rectangle, whose outline covers the columns x to x + width and the rows y to y + height.
+     * @param color The color of the rectangle.
+     */
+    void addRectangle(Rectangle r, unsigned char color);
+
+    /**
+     * @brief Adds a filled rectangle, with the same pixels as Draw::fillRectangle.
+     *
+     * @param r The rectangle, covering the columns [x, x + width) and the rows [y, y + height).
+     * @param color The color of the rectangle.
+     */
+    void addFilledRectangle(Rectangle r, unsigned char color);
+
+    /**
+     * @brief Adds the outline of a circle, with the same pixels as Draw::drawCircle.
+     *
+     * @param center The center point of the circle.
+     * @param radius The radius of the circle.
+     * @param color The color of the circle.
+     */
+    void addCircle(Point center, int radius, unsigned char color);
+
+    /**
+     * @brief Adds a filled circle, with the same pixels as Draw::fillCircle.
+     *
+     * @param center The center point of the circle.
+     * @param radius The radius of the circle.
+     * @param color The color of the circle.
+     */
+    void addFilledCircle(Point center, int radius, unsigned char color);
+
+    /**
+     * @brief Adds a cross-shaped marker.
+     *
+     * @param center The center point of the marker.
+     * @param size The length of each arm of the cross.
+     * @param color The color of the marker.
+     */
+    void addMarker(Point center, int size, unsigned char color);
+
+    /**
+     * @brief Removes every shape.
+     */
+    void clear();
+
+    /**
+     * @brief Returns the number of shapes.
+     *
+     * @return The number of shapes.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Returns whether rendering is split across parallel row bands.
+     *
+     * @return True for parallel rendering.
+     */
+    bool isParallel() const;
+
+    /**
+     * @brief Sets whether rendering is split across parallel row bands.
+     *
+     * @param newParallel True for parallel rendering.
+     */
+    void setParallel(bool newParallel);
+
+    /**
+     * @brief Draws every shape on an image.
+     *
+     * @param img The Image on which to draw.
+     */
+    void render(Image &img) const;
+
+private:
+    /**
+     * @brief Draws the row of a shape.
+     *
+     * @param primitive The shape.
+     * @param y The row, between the top and the bottom of the shape.
+     * @param row The pixels of the row.
+     * @param width The width of the row.
+     */
+    void renderRow(const Primitive &primitive, int y, unsigned char *row, int width) const;
+
+    /**
+     * @brief Renders the rows [first, last).
+     *
+     * @param rows The rows of the image.
+     * @param width The width of the image.
+     * @param first The first row.
+     * @param last One past the last row.
+     * @param order The shapes sorted by their top row.
+     */
+    void renderRows(unsigned char **rows, int width, int first, int last, const std::vector<size_t> &order) const;
+};
@@ -1,5 +1,9 @@
 #include "Gamma.h"
+#include <algorithm>
 #include <math.h>
+#include "Parallel.h"
+#include "ImageMetrics.h"
+#include "Trace.h"
 
 /**
  * @brief Constructs a Gamma object with the specified gamma value.
@@ -13,7 +17,10 @@
  * @brief Default constructor for the Gamma class.
  * Initializes the `gamma` member variable to 0.
  */
-Gamma::Gamma() : gamma{0} {}
+Gamma::Gamma() : gamma{0}
+{
+    updateTable();
+}
 
 /**
  * @brief Constructs a Gamma object with the specified gamma value.
@@ -23,6 +30,7 @@ Gamma::Gamma() : gamma{0} {}
 Gamma::Gamma(double gamma)
 {
     this->gamma = gamma;
+    updateTable();
 }
 
 /**
@@ -43,28 +51,80 @@ double Gamma::getGamma()
 void Gamma::setGamma(double newGamma)
 {
     this->gamma = newGamma;
+    updateTable();
+}
+
+/**
+ * Recomputes the corrected value of every pixel value: the value raised to the power gamma,
+ * truncated and clamped to 0-255.
+ */
+void Gamma::updateTable()
+{
+    for (int v = 0; v < 256; ++v)
+        this->table[v] = static_cast<unsigned char>(std::min(std::max(pow(v, this->gamma), 0.0), 255.0));
 }
 
 /**
  * Applies gamma correction to the source image and stores the result in the destination image.
  * Gamma correction is a non-linear adjustment to the image's brightness values.
  *
+ * Every pixel is looked up in the precomputed table, in parallel row bands, and dst keeps its
+ * buffers when it already has the size of src.
+ *
  * @param src The source image to be processed.
  * @param dst The destination image where the processed result will be stored.
  */
 void Gamma::process(const Image &src, Image &dst)
 {
-    dst = src;
-    for (int i = 0; i < dst.getHeight(); ++i)
+    TRACE_SCOPE("Gamma::process", "process");
+    ImageMetrics::Site site("Gamma::process");
+    dst.create(src.getWidth(), src.getHeight());
+    unsigned char **in = src.getData();
+    unsigned char **out = dst.getData();
+    Parallel::forRows(0, dst.getHeight(), [&](unsigned int first, unsigned int last)
+                      { processRows(in, src.size(), out, dst.size(), first, last); },
+                      64);
+}
+
+/**
+ * @brief Gamma correction maps every pixel on its own, so it can run in place.
+ *
+ * @return True.
+ */
+bool Gamma::supportsInPlace() const
+{
+    return true;
+}
+
+/**
+ * @brief Gamma correction maps every pixel on its own, so it can be computed a range of rows at a time.
+ *
+ * @return True.
+ */
+bool Gamma::supportsRows() const
+{
+    return true;
+}
+
+/**
+ * Computes the rows [first, last) of the output, looking every pixel up in the precomputed table.
+ *
+ * @param in The rows of the source.
+ * @param inputSize The size of the source.
+ * @param out The rows of the output.
+ * @param outputSize The size of the output.
+ * @param first The first row to compute.
+ * @param last One past the last row to compute.
+ */
+void Gamma::processRows(unsigned char **in, const Size & /* inputSize */, unsigned char **out, const Size &outputSize,
+                        unsigned int first, unsigned int last)
+{
+    unsigned int width = outputSize.getWidth();
+    for (unsigned int i = first; i < last; ++i)
     {
-        for (int j = 0; j < dst.getWidth(); ++j)
-        {
-            int newValue = pow(dst.at(i, j), this->gamma);
-            if (newValue > 255)
-                newValue = 255;
-            else if (newValue < 0)
-                newValue = 0;
-            dst.setPixel(i, j, newValue);
-        }
+        const unsigned char *row = in[i];
+        unsigned char *output = out[i];
+        for (unsigned int j = 0; j < width; ++j)
+            output[j] = this->table[row[j]];
     }
-}
\ No newline at end of file
+}
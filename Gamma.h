@@ -19,6 +19,12 @@ class Gamma : public ImageProcessing
 {
 private:
     double gamma; /**< The gamma value for gamma correction. */
+    unsigned char table[256]; /**< The corrected value of every pixel value, recomputed when gamma changes. */
+
+    /**
+     * @brief Recomputes the corrected value of every pixel value.
+     */
+    void updateTable();
 
 public:
     /**
@@ -61,4 +67,31 @@ public:
      * @param dst The output image with gamma correction applied.
      */
     void process(const Image &src, Image &dst) override;
+
+    /**
+     * @brief Gamma correction maps every pixel on its own, so it can run in place.
+     *
+     * @return True.
+     */
+    bool supportsInPlace() const override;
+
+    /**
+     * @brief Gamma correction maps every pixel on its own, so it can be computed a range of rows at a time.
+     *
+     * @return True.
+     */
+    bool supportsRows() const override;
+
+    /**
+     * @brief Computes the rows [first, last) of the output.
+     *
+     * @param in The rows of the source.
+     * @param inputSize The size of the source.
+     * @param out The rows of the output.
+     * @param outputSize The size of the output.
+     * @param first The first row to compute.
+     * @param last One past the last row to compute.
+     */
+    void processRows(unsigned char **in, const Size &inputSize, unsigned char **out, const Size &outputSize,
+                     unsigned int first, unsigned int last) override;
 };
\ No newline at end of file
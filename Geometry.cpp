@@ -0,0 +1,290 @@
+#include <algorithm>
+#include <vector>
+#include "Geometry.h"
+#include "Parallel.h"
+#include "Simd.h"
+
+static const unsigned int TILE = 64; ///< The side of the cache tiles, in pixels.
+
+/**
+ * Transposes the 8x8 block at (row, col) of the source rows into the destination rows.
+ */
+static inline void transposeBlock(unsigned char *const *srcRows, unsigned char *const *dstRows, unsigned int row, unsigned int col)
+{
+#ifdef IMAGE_PROCESSING_SSE2
+    __m128i a0 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(srcRows[row + 0] + col));
+    __m128i a1 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(srcRows[row + 1] + col));
+    __m128i a2 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(srcRows[row + 2] + col));
+    __m128i a3 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(srcRows[row + 3] + col));
+    __m128i a4 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(srcRows[row + 4] + col));
+    __m128i a5 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(srcRows[row + 5] + col));
+    __m128i a6 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(srcRows[row + 6] + col));
+    __m128i a7 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(srcRows[row + 7] + col));
+
+    __m128i b0 = _mm_unpacklo_epi8(a0, a1);
+    __m128i b1 = _mm_unpacklo_epi8(a2, a3);
+    __m128i b2 = _mm_unpacklo_epi8(a4, a5);
+    __m128i b3 = _mm_unpacklo_epi8(a6, a7);
+
+    __m128i c0 = _mm_unpacklo_epi16(b0, b1);
+    __m128i c1 = _mm_unpackhi_epi16(b0, b1);
+    __m128i c2 = _mm_unpacklo_epi16(b2, b3);
+    __m128i c3 = _mm_unpackhi_epi16(b2, b3);
+
+    __m128i d0 = _mm_unpacklo_epi32(c0, c2);
+    __m128i d1 = _mm_unpackhi_epi32(c0, c2);
+    __m128i d2 = _mm_unpacklo_epi32(c1, c3);
+    __m128i d3 = _mm_unpackhi_epi32(c1, c3);
+
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dstRows[col + 0] + row), d0);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dstRows[col + 1] + row), _mm_srli_si128(d0, 8));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dstRows[col + 2] + row), d1);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dstRows[col + 3] + row), _mm_srli_si128(d1, 8));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dstRows[col + 4] + row), d2);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dstRows[col + 5] + row), _mm_srli_si128(d2, 8));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dstRows[col + 6] + row), d3);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(dstRows[col + 7] + row), _mm_srli_si128(d3, 8));
+#else
+    for (unsigned int i = 0; i < 8; ++i)
+        for (unsigned int j = 0; j < 8; ++j)
+            dstRows[col + j][row + i] = srcRows[row + i][col + j];
+#endif
+}
+
+/**
+ * Transposes srcRows (height x width) into dstRows (width x height) tile by tile.
+ *
+ * The caller chooses the order of the row pointers: reversing the source rows turns the
+ * transpose into a clockwise rotation, reversing the destination rows into a counterclockwise one.
+ */
+static void transposeRows(unsigned char *const *srcRows, unsigned char *const *dstRows, unsigned int width, unsigned int height)
+{
+    Parallel::forRows(0, width, [&](unsigned int first, unsigned int last)
+                      {
+                          for (unsigned int tileCol = first; tileCol < last; tileCol += TILE)
+                          {
+                              unsigned int colEnd = std::min(tileCol + TILE, last);
+                              for (unsigned int tileRow = 0; tileRow < height; tileRow += TILE)
+                              {
+                                  unsigned int rowEnd = std::min(tileRow + TILE, height);
+                                  unsigned int col = tileCol;
+                                  for (; col + 8 <= colEnd; col += 8)
+                                  {
+                                      unsigned int row = tileRow;
+                                      for (; row + 8 <= rowEnd; row += 8)
+                                          transposeBlock(srcRows, dstRows, row, col);
+                                      for (; row < rowEnd; ++row)
+                                          for (unsigned int j = col; j < col + 8; ++j)
+                                              dstRows[j][row] = srcRows[row][j];
+                                  }
+                                  for (; col < colEnd; ++col)
+                                      for (unsigned int row = tileRow; row < rowEnd; ++row)
+                                          dstRows[col][row] = srcRows[row][col];
+                              }
+                          }
+                      },
+                      TILE);
+}
+
+/**
+ * Writes the bytes of in[0, width) to out in reverse order. The buffers must not overlap.
+ */
+static void reverseCopy(const unsigned char *in, unsigned char *out, unsigned int width)
+{
+    unsigned int j = 0;
+#ifdef IMAGE_PROCESSING_SSE2
+    for (; j + 16 <= width; j += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + width - j - 16));
+        v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+        v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + j), v);
+    }
+#endif
+    for (; j < width; ++j)
+        out[j] = in[width - 1 - j];
+}
+
+/**
+ * Returns the row pointers of img, optionally in reverse order.
+ */
+static std::vector<unsigned char *> rowPointers(const Image &img, bool reversed)
+{
+    unsigned int height = img.getHeight();
+    std::vector<unsigned char *> rows(height);
+    for (unsigned int i = 0; i < height; ++i)
+        rows[i] = img.getData()[reversed ? height - 1 - i : i];
+    return rows;
+}
+
+/**
+ * Transposes the source image (the rows become columns).
+ *
+ * @param src The source image.
+ * @param dst The transposed image.
+ */
+void Geometry::transpose(const Image &src, Image &dst)
+{
+    if (&src == &dst)
+    {
+        Image copy(src);
+        transpose(copy, dst);
+        return;
+    }
+    dst.create(src.getHeight(), src.getWidth());
+    transposeRows(src.getData(), dst.getData(), src.getWidth(), src.getHeight());
+}
+
+/**
+ * Rotates the source image by 90 degrees clockwise: the transpose of the image read bottom-up.
+ *
+ * @param src The source image.
+ * @param dst The rotated image.
+ */
+void Geometry::rotate90(const Image &src, Image &dst)
+{
+    if (&src == &dst)
+    {
+        Image copy(src);
+        rotate90(copy, dst);
+        return;
+    }
+    dst.create(src.getHeight(), src.getWidth());
+    std::vector<unsigned char *> srcRows = rowPointers(src, true);
+    transposeRows(srcRows.data(), dst.getData(), src.getWidth(), src.getHeight());
+}
+
+/**
+ * Rotates the source image by 180 degrees.
+ *
+ * @param src The source image.
+ * @param dst The rotated image.
+ */
+void Geometry::rotate180(const Image &src, Image &dst)
+{
+    if (&src == &dst)
+    {
+        rotate180(dst);
+        return;
+    }
+    unsigned int width = src.getWidth();
+    unsigned int height = src.getHeight();
+    dst.create(width, height);
+    unsigned char **out = dst.getData();
+    Parallel::forRows(0, height, [&](unsigned int first, unsigned int last)
+                      {
+                          for (unsigned int i = first; i < last; ++i)
+                              reverseCopy(src.getData()[height - 1 - i], out[i], width);
+                      });
+}
+
+/**
+ * Rotates the source image by 270 degrees clockwise: the transpose written bottom-up.
+ *
+ * @param src The source image.
+ * @param dst The rotated image.
+ */
+void Geometry::rotate270(const Image &src, Image &dst)
+{
+    if (&src == &dst)
+    {
+        Image copy(src);
+        rotate270(copy, dst);
+        return;
+    }
+    dst.create(src.getHeight(), src.getWidth());
+    std::vector<unsigned char *> dstRows = rowPointers(dst, true);
+    transposeRows(src.getData(), dstRows.data(), src.getWidth(), src.getHeight());
+}
+
+/**
+ * Mirrors the source image around its vertical axis.
+ *
+ * @param src The source image.
+ * @param dst The flipped image.
+ */
+void Geometry::flipHorizontal(const Image &src, Image &dst)
+{
+    if (&src == &dst)
+    {
+        flipHorizontal(dst);
+        return;
+    }
+    unsigned int width = src.getWidth();
+    dst.create(width, src.getHeight());
+    unsigned char **out = dst.getData();
+    Parallel::forRows(0, src.getHeight(), [&](unsigned int first, unsigned int last)
+                      {
+                          for (unsigned int i = first; i < last; ++i)
+                              reverseCopy(src.getData()[i], out[i], width);
+                      });
+}
+
+/**
+ * Mirrors the source image around its horizontal axis.
+ *
+ * @param src The source image.
+ * @param dst The flipped image.
+ */
+void Geometry::flipVertical(const Image &src, Image &dst)
+{
+    if (&src == &dst)
+    {
+        flipVertical(dst);
+        return;
+    }
+    unsigned int width = src.getWidth();
+    unsigned int height = src.getHeight();
+    dst.create(width, height);
+    unsigned char **out = dst.getData();
+    for (unsigned int i = 0; i < height; ++i)
+        std::copy(src.getData()[height - 1 - i], src.getData()[height - 1 - i] + width, out[i]);
+}
+
+/**
+ * Rotates the image by 180 degrees in place: the row order is reversed by swapping row pointers,
+ * then every row is mirrored.
+ *
+ * @param img The image to rotate.
+ */
+void Geometry::rotate180(Image &img)
+{
+    flipVertical(img);
+    flipHorizontal(img);
+}
+
+/**
+ * Mirrors every row of the image in place.
+ *
+ * @param img The image to flip.
+ */
+void Geometry::flipHorizontal(Image &img)
+{
+    unsigned int width = img.getWidth();
+    // The rows are fetched from several threads, so a shared buffer is copied here, once.
+    img.detach();
+    Parallel::forRows(0, img.getHeight(), [&](unsigned int first, unsigned int last)
+                      {
+                          std::vector<unsigned char> scratch(width);
+                          for (unsigned int i = first; i < last; ++i)
+                          {
+                              unsigned char *row = img.row(i);
+                              reverseCopy(row, scratch.data(), width);
+                              std::copy(scratch.begin(), scratch.end(), row);
+                          }
+                      });
+}
+
+/**
+ * Mirrors the image around its horizontal axis in place by reversing the order of its row pointers.
+ * No pixel is moved.
+ *
+ * @param img The image to flip.
+ */
+void Geometry::flipVertical(Image &img)
+{
+    unsigned char **rows = img.getData();
+    std::reverse(rows, rows + img.getHeight());
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "Image.h"
+
+/**
+ * @brief The Geometry class provides static methods for transposing, flipping and rotating images.
+ *
+ * Transposes and 90 degree rotations walk the image in cache-sized tiles and transpose each tile
+ * in 8x8 blocks, so neither the reads nor the column-wise writes thrash the cache. Vertical flips
+ * and 180 degree rotations done in place only reorder the row pointers of the image. The
+ * out-of-place versions write straight into dst, which keeps its buffer when it already has the
+ * output size; passing the same image as src and dst works on a copy, or in place for the flips
+ * and the 180 degree rotation.
+ */
+class Geometry
+{
+public:
+    /**
+     * @brief Transposes the source image (the rows become columns).
+     *
+     * @param src The source image.
+     * @param dst The transposed image.
+     */
+    static void transpose(const Image &src, Image &dst);
+
+    /**
+     * @brief Rotates the source image by 90 degrees clockwise.
+     *
+     * @param src The source image.
+     * @param dst The rotated image.
+     */
+    static void rotate90(const Image &src, Image &dst);
+
+    /**
+     * @brief Rotates the source image by 180 degrees.
+     *
+     * @param src The source image.
+     * @param dst The rotated image.
+     */
+    static void rotate180(const Image &src, Image &dst);
+
+    /**
+     * @brief Rotates the source image by 270 degrees clockwise (90 degrees counterclockwise).
+     *
+     * @param src The source image.
+     * @param dst The rotated image.
+     */
+    static void rotate270(const Image &src, Image &dst);
+
+    /**
+     * @brief Mirrors the source image around its vertical axis (left becomes right).
+     *
+     * @param src The source image.
+     * @param dst The flipped image.
+     */
+    static void flipHorizontal(const Image &src, Image &dst);
+
+    /**
+     * @brief Mirrors the source image around its horizontal axis (top becomes bottom).
+     *
+     * @param src The source image.
+     * @param dst The flipped image.
+     */
+    static void flipVertical(const Image &src, Image &dst);
+
+    /**
+     * @brief Rotates the image by 180 degrees in place.
+     *
+     * @param img The image to rotate.
+     */
+    static void rotate180(Image &img);
+
+    /**
+     * @brief Mirrors the image around its vertical axis in place.
+     *
+     * @param img The image to flip.
+     */
+    static void flipHorizontal(Image &img);
+
+    /**
+     * @brief Mirrors the image around its horizontal axis in place.
+     *
+     * @param img The image to flip.
+     */
+    static void flipVertical(Image &img);
+};
@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <mutex>
+#include "Histogram.h"
+#include "Parallel.h"
+
+/**
+ * @brief Default constructor for the Histogram class.
+ * Initializes every bin to zero.
+ */
+Histogram::Histogram() : bins{} {}
+
+/**
+ * @brief Constructs the histogram of an image.
+ *
+ * @param img The image.
+ */
+Histogram::Histogram(const Image &img) : bins{}
+{
+    compute(img);
+}
+
+/**
+ * @brief Computes the histogram of an image, replacing the current counts.
+ *
+ * @param img The image.
+ */
+void Histogram::compute(const Image &img)
+{
+    compute(img, Rectangle(0, 0, img.getWidth(), img.getHeight()));
+}
+
+/**
+ * Computes the histogram of a region of an image, replacing the current counts.
+ *
+ * Every row band counts into its own bins, which are merged into the result under a lock.
+ *
+ * @param img The image.
+ * @param roi The region, with (x, y) its top-left pixel. It is clipped to the image.
+ */
+void Histogram::compute(const Image &img, Rectangle roi)
+{
+    std::fill(this->bins, this->bins + 256, 0);
+    long long x0 = std::max(roi.getX(), 0);
+    long long y0 = std::max(roi.getY(), 0);
+    long long x1 = std::min<long long>(static_cast<long long>(roi.getX()) + roi.getWidth(), img.getWidth());
+    long long y1 = std::min<long long>(static_cast<long long>(roi.getY()) + roi.getHeight(), img.getHeight());
+    if (x1 <= x0 || y1 <= y0)
+        return;
+
+    std::mutex binsMutex;
+    Parallel::forRows(static_cast<unsigned int>(y0), static_cast<unsigned int>(y1), [&](unsigned int first, unsigned int last)
+                      {
+                          unsigned int local[256] = {};
+                          accumulate(img.getData(), first, last, static_cast<unsigned int>(x0), static_cast<unsigned int>(x1), local);
+                          std::lock_guard<std::mutex> lock(binsMutex);
+                          for (int k = 0; k < 256; ++k)
+                              this->bins[k] += local[k];
+                      },
+                      64);
+}
+
+/**
+ * @brief Returns the number of pixels with the given intensity.
+ *
+ * @param value The intensity.
+ * @return The number of pixels, or 0 for values above 255.
+ */
+unsigned int Histogram::operator[](unsigned int value) const
+{
+    return value < 256 ? this->bins[value] : 0;
+}
+
+/**
+ * @brief Returns the total number of pixels counted.
+ *
+ * @return The sum of all bins.
+ */
+unsigned long long Histogram::total() const
+{
+    unsigned long long sum = 0;
+    for (int k = 0; k < 256; ++k)
+        sum += this->bins[k];
+    return sum;
+}
+
+/**
+ * @brief Adds the counts of another histogram to this one.
+ *
+ * @param other The histogram to add.
+ * @return A reference to this histogram.
+ */
+Histogram &Histogram::operator+=(const Histogram &other)
+{
+    for (int k = 0; k < 256; ++k)
+        this->bins[k] += other.bins[k];
+    return *this;
+}
+
+/**
+ * Counts the pixels of rows [first, last), columns [x0, x1), into the given bins.
+ *
+ * Four consecutive pixels go to four different sub-histograms, so incrementing the counter of a
+ * pixel never has to wait for the increment of the previous pixel to reach memory.
+ *
+ * @param rows The row pointers of the image.
+ * @param first The first row.
+ * @param last One past the last row.
+ * @param x0 The first column.
+ * @param x1 One past the last column.
+ * @param bins The 256 bins to add to.
+ */
+void Histogram::accumulate(unsigned char *const *rows, unsigned int first, unsigned int last,
+                           unsigned int x0, unsigned int x1, unsigned int *bins)
+{
+    unsigned int banks[4][256] = {};
+    for (unsigned int i = first; i < last; ++i)
+    {
+        const unsigned char *row = rows[i];
+        unsigned int j = x0;
+        for (; j + 4 <= x1; j += 4)
+        {
+            ++banks[0][row[j]];
+            ++banks[1][row[j + 1]];
+            ++banks[2][row[j + 2]];
+            ++banks[3][row[j + 3]];
+        }
+        for (; j < x1; ++j)
+            ++banks[0][row[j]];
+    }
+    for (int k = 0; k < 256; ++k)
+        bins[k] += banks[0][k] + banks[1][k] + banks[2][k] + banks[3][k];
+}
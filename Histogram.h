@@ -0,0 +1,84 @@
+#pragma once
+#include "Image.h"
+
+/**
+ * @class Histogram
+ * @brief Represents the 256-bin intensity histogram of an image or of a region of an image.
+ *
+ * Counting is done in parallel row bands. Within a band, consecutive pixels are counted into
+ * four interleaved sub-histograms, so runs of equal pixels do not serialize on the same counter
+ * (a store-to-load dependency through memory); the sub-histograms are merged at the end.
+ */
+class Histogram
+{
+private:
+    unsigned int bins[256]; ///< The number of pixels of each intensity.
+
+public:
+    /**
+     * @brief Default constructor.
+     *
+     * Initializes an empty histogram.
+     */
+    Histogram();
+
+    /**
+     * @brief Constructs the histogram of an image.
+     *
+     * @param img The image.
+     */
+    Histogram(const Image &img);
+
+    /**
+     * @brief Computes the histogram of an image, replacing the current counts.
+     *
+     * @param img The image.
+     */
+    void compute(const Image &img);
+
+    /**
+     * @brief Computes the histogram of a region of an image, replacing the current counts.
+     *
+     * @param img The image.
+     * @param roi The region, with (x, y) its top-left pixel. It is clipped to the image.
+     */
+    void compute(const Image &img, Rectangle roi);
+
+    /**
+     * @brief Returns the number of pixels with the given intensity.
+     *
+     * @param value The intensity.
+     * @return The number of pixels.
+     */
+    unsigned int operator[](unsigned int value) const;
+
+    /**
+     * @brief Returns the total number of pixels counted.
+     *
+     * @return The sum of all bins.
+     */
+    unsigned long long total() const;
+
+    /**
+     * @brief Adds the counts of another histogram to this one.
+     *
+     * @param other The histogram to add.
+     * @return A reference to this histogram.
+     */
+    Histogram &operator+=(const Histogram &other);
+
+    /**
+     * @brief Counts the pixels of rows [first, last), columns [x0, x1), into the given bins.
+     *
+     * The counts are added to the existing contents of the bins.
+     *
+     * @param rows The row pointers of the image.
+     * @param first The first row.
+     * @param last One past the last row.
+     * @param x0 The first column.
+     * @param x1 One past the last column.
+     * @param bins The 256 bins to add to.
+     */
+    static void accumulate(unsigned char *const *rows, unsigned int first, unsigned int last,
+                           unsigned int x0, unsigned int x1, unsigned int *bins);
+};
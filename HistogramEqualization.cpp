@@ -0,0 +1,51 @@
+#include "HistogramEqualization.h"
+#include "Histogram.h"
+#include "Parallel.h"
+#include "ImageMetrics.h"
+#include "Trace.h"
+
+/**
+ * Equalizes the histogram of the source image and stores the result in the destination image.
+ *
+ * The lookup table maps every intensity v to round(255 * (cdf(v) - cdf(min)) / (total - cdf(min))),
+ * where min is the darkest intensity present, so the darkest pixels become 0 and the brightest 255.
+ *
+ * @param src The source image.
+ * @param dst The equalized image.
+ */
+void HistogramEqualization::process(const Image &src, Image &dst)
+{
+    TRACE_SCOPE("HistogramEqualization::process", "process");
+    ImageMetrics::Site site("HistogramEqualization::process");
+    unsigned int width = src.getWidth();
+    unsigned int height = src.getHeight();
+    Image output(width, height);
+
+    Histogram histogram(src);
+    unsigned long long total = histogram.total();
+    unsigned char lut[256];
+    unsigned long long cdf = 0;
+    unsigned long long cdfMin = 0;
+    for (int v = 0; v < 256; ++v)
+    {
+        if (cdfMin == 0 && histogram[v] > 0)
+            cdfMin = histogram[v];
+        cdf += histogram[v];
+        if (total == cdfMin)
+            lut[v] = static_cast<unsigned char>(v);
+        else
+            lut[v] = static_cast<unsigned char>(cdf <= cdfMin ? 0 : ((cdf - cdfMin) * 255 + (total - cdfMin) / 2) / (total - cdfMin));
+    }
+
+    Parallel::forRows(0, height, [&](unsigned int first, unsigned int last)
+                      {
+                          for (unsigned int i = first; i < last; ++i)
+                          {
+                              const unsigned char *in = src.getData()[i];
+                              unsigned char *out = output.row(i);
+                              for (unsigned int j = 0; j < width; ++j)
+                                  out[j] = lut[in[j]];
+                          }
+                      });
+    dst = output;
+}
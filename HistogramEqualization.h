@@ -0,0 +1,21 @@
+#pragma once
+#include "ImageProcessing.h"
+
+/**
+ * @class HistogramEqualization
+ * @brief A class that represents global histogram equalization.
+ *
+ * The intensities of the image are remapped through its normalized cumulative histogram, which
+ * spreads the most frequent intensities over the whole 0-255 range and increases the global contrast.
+ */
+class HistogramEqualization : public ImageProcessing
+{
+public:
+    /**
+     * @brief Equalizes the histogram of the source image and stores the result in the destination image.
+     *
+     * @param src The source image.
+     * @param dst The equalized image.
+     */
+    void process(const Image &src, Image &dst) override;
+};
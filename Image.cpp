@@ -1,7 +1,49 @@
 #include <iostream>
 #include <fstream>
 #include <exception>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+#include <new>
 #include "Image.h"
+#include "ImageMetrics.h"
+#include "ImagePool.h"
+#include "Trace.h"
+
+std::atomic<bool> Image::s_copyOnWrite{false};
+
+namespace
+{
+/**
+ * The start of every image buffer, before the row pointers.
+ */
+struct BufferHeader
+{
+    std::atomic<unsigned int> references; ///< The number of images sharing the buffer.
+    size_t pixels;                        ///< The number of pixels the buffer was allocated for.
+};
+
+const size_t HEADER_SIZE = (sizeof(BufferHeader) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) *
+                           alignof(std::max_align_t); ///< The header size, rounded up to keep the rows aligned.
+
+BufferHeader &header(unsigned char *buffer)
+{
+    return *reinterpret_cast<BufferHeader *>(buffer);
+}
+
+/**
+ * Drops a reference to a buffer, returning it to the pool with the last one.
+ */
+void unreference(unsigned char *buffer, size_t capacity)
+{
+    BufferHeader &h = header(buffer);
+    if (h.references.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+    ImageMetrics::release(h.pixels);
+    h.~BufferHeader();
+    ImagePool::deallocate(buffer, capacity);
+}
+} // namespace
 
 /**
  * @brief Default constructor for the Image class.
@@ -9,7 +51,7 @@
  * This constructor initializes the Image object with default values.
  * The image data is set to nullptr, and the width and height are set to 0.
  */
-Image::Image() : m_data{nullptr}, m_width{0}, m_height{0} {}
+Image::Image() : m_data{nullptr}, m_buffer{nullptr}, m_capacity{0}, m_width{0}, m_height{0}, m_statistics{}, m_statisticsValid{false} {}
 
 /**
  * @brief Constructs an Image object with the specified width and height.
@@ -17,17 +59,13 @@ Image::Image() : m_data{nullptr}, m_width{0}, m_height{0} {}
  * @param w The width of the image.
  * @param h The height of the image.
  */
-Image::Image(unsigned int w, unsigned int h)
+Image::Image(unsigned int w, unsigned int h) : m_statisticsValid{false}
 {
-    this->m_width = w;
-    this->m_height = h;
-    this->m_data = new unsigned char *[h];
-    for (int i = 0; i < h; ++i)
-    {
-        m_data[i] = new unsigned char[w];
-        for (int j = 0; j < w; ++j)
-            m_data[i][j] = 0;
-    }
+    TRACE_SCOPE("Image::Image", "memory");
+    ImageMetrics::Timer timer(ImageMetrics::ALLOCATION, static_cast<size_t>(w) * h);
+    allocate(w, h);
+    for (unsigned int i = 0; i < h; ++i)
+        std::memset(this->m_data[i], 0, w);
 }
 
 /**
@@ -60,6 +98,20 @@ unsigned char **Image::getData() const
     return this->m_data;
 }
 
+/**
+ * @brief Get the data of the image for writing.
+ *
+ * The caller may modify the pixels, so the cached statistics are discarded.
+ *
+ * @return unsigned char** The data of the image.
+ */
+unsigned char **Image::getData()
+{
+    invalidateStatistics();
+    detach();
+    return this->m_data;
+}
+
 /**
  * Returns the maximum pixel value in the image.
  *
@@ -67,12 +119,50 @@ unsigned char **Image::getData() const
  */
 unsigned int Image::maxPixelValue() const
 {
-    unsigned int maxx = 0;
-    for (int i = 0; i < this->m_height; ++i)
-        for (int j = 0; j < this->m_width; ++j)
-            if (this->m_data[i][j] > maxx)
-                maxx = this->m_data[i][j];
-    return maxx;
+    return statistics().getMax();
+}
+
+/**
+ * Returns the statistics of the image, computing them if the cached ones are out of date.
+ *
+ * @return The statistics of the image.
+ */
+ImageStatistics Image::statistics() const
+{
+    if (!this->m_statisticsValid.load(std::memory_order_acquire))
+    {
+        // Concurrent readers may all find them out of date; only the first one computes them, and
+        // no one writes them again until the pixels change.
+        std::lock_guard<std::mutex> lock(this->m_statisticsMutex);
+        if (!this->m_statisticsValid.load(std::memory_order_relaxed))
+        {
+            this->m_statistics = ImageStatistics::compute(this->m_data, this->m_width, this->m_height);
+            this->m_statisticsValid.store(true, std::memory_order_release);
+        }
+    }
+    return this->m_statistics;
+}
+
+/**
+ * Takes over the cached statistics of another image, if they are up to date. They are only read
+ * once published, so this is safe while other threads ask other for its statistics.
+ *
+ * @param other The image whose statistics are copied.
+ */
+void Image::copyStatistics(const Image &other)
+{
+    bool valid = other.m_statisticsValid.load(std::memory_order_acquire);
+    if (valid)
+        this->m_statistics = other.m_statistics;
+    this->m_statisticsValid.store(valid, std::memory_order_relaxed);
+}
+
+/**
+ * Discards the cached statistics; they are recomputed by the next call to statistics().
+ */
+void Image::invalidateStatistics()
+{
+    this->m_statisticsValid.store(false, std::memory_order_relaxed);
 }
 
 /**
@@ -86,28 +176,28 @@ unsigned int Image::maxPixelValue() const
  */
 void Image::setWidth(unsigned int newWidth)
 {
-    unsigned char **newData = new unsigned char *[this->m_height];
-    for (int i = 0; i < this->m_height; ++i)
+    TRACE_SCOPE("Image::setWidth", "memory");
+    ImageMetrics::Site site("Image::setWidth");
+    invalidateStatistics();
+    unsigned char **oldData = this->m_data;
+    unsigned char *oldBuffer = this->m_buffer;
+    size_t oldCapacity = this->m_capacity;
+    unsigned int oldWidth = this->m_width;
     {
-        newData[i] = new unsigned char[newWidth];
-        if (newWidth < this->m_width)
-        {
-            for (int j = 0; j < newWidth; ++j)
-                newData[i][j] = this->m_data[i][j];
-        }
-        else
+        ImageMetrics::Timer timer(ImageMetrics::ALLOCATION, static_cast<size_t>(newWidth) * this->m_height);
+        allocate(newWidth, this->m_height);
+    }
+    {
+        unsigned int kept = newWidth < oldWidth ? newWidth : oldWidth;
+        ImageMetrics::Timer timer(ImageMetrics::COPY, static_cast<size_t>(kept) * this->m_height);
+        for (int i = 0; i < this->m_height; ++i)
         {
-            for (int j = 0; j < this->m_width; ++j)
-                newData[i][j] = this->m_data[i][j];
-            for (int j = this->m_width; j < newWidth; ++j)
-                newData[i][j] = 0;
+            std::memcpy(this->m_data[i], oldData[i], kept);
+            std::memset(this->m_data[i] + kept, 0, newWidth - kept);
         }
     }
-    for (int i = 0; i < this->m_height; ++i)
-        delete[] this->m_data[i];
-    delete[] this->m_data;
-    this->m_width = newWidth;
-    this->m_data = newData;
+    if (oldBuffer != nullptr)
+        unreference(oldBuffer, oldCapacity);
 }
 
 /**
@@ -121,6 +211,8 @@ void Image::setWidth(unsigned int newWidth)
  */
 void Image::setPixel(int x, int y, int newValue)
 {
+    invalidateStatistics();
+    detach();
     if (newValue > 255)
         newValue = 255;
     else if (newValue < 0)
@@ -139,32 +231,33 @@ void Image::setPixel(int x, int y, int newValue)
  */
 void Image::setHeight(unsigned int newHeight)
 {
+    TRACE_SCOPE("Image::setHeight", "memory");
+    ImageMetrics::Site site("Image::setHeight");
+    invalidateStatistics();
     if (newHeight < this->m_height)
     {
-        for (int i = newHeight; i < this->m_height; ++i)
-            delete[] this->m_data[i];
+        // The rows below stay in the buffer, which may be shared, until it is released.
         this->m_height = newHeight;
     }
     else
     {
-        unsigned char **newData = new unsigned char *[newHeight];
-        for (int i = 0; i < newHeight; ++i)
+        unsigned char **oldData = this->m_data;
+        unsigned char *oldBuffer = this->m_buffer;
+        size_t oldCapacity = this->m_capacity;
+        unsigned int oldHeight = this->m_height;
         {
-            newData[i] = new unsigned char[this->m_width];
-            if (i < this->m_height)
-            {
-                for (int j = 0; j < this->m_width; ++j)
-                    newData[i][j] = this->m_data[i][j];
-            }
-            else
-            {
-                for (int j = 0; j < this->m_width; ++j)
-                    newData[i][j] = 0;
-            }
+            ImageMetrics::Timer timer(ImageMetrics::ALLOCATION, static_cast<size_t>(this->m_width) * newHeight);
+            allocate(this->m_width, newHeight);
         }
-        delete[] this->m_data;
-        this->m_height = newHeight;
-        this->m_data = newData;
+        {
+            ImageMetrics::Timer timer(ImageMetrics::COPY, static_cast<size_t>(this->m_width) * oldHeight);
+            for (int i = 0; i < oldHeight; ++i)
+                std::memcpy(this->m_data[i], oldData[i], this->m_width);
+        }
+        for (int i = oldHeight; i < newHeight; ++i)
+            std::memset(this->m_data[i], 0, this->m_width);
+        if (oldBuffer != nullptr)
+            unreference(oldBuffer, oldCapacity);
     }
 }
 
@@ -176,6 +269,8 @@ void Image::setHeight(unsigned int newHeight)
  */
 void Image::setPixel(Point point, unsigned int newValue)
 {
+    invalidateStatistics();
+    detach();
     this->m_data[point.getX()][point.getY()] = newValue;
 }
 
@@ -191,6 +286,21 @@ unsigned char &Image::at(int x, int y) const
     return this->m_data[x][y];
 }
 
+/**
+ * Returns a writable reference to the pixel value at the specified coordinates.
+ * The cached statistics are discarded.
+ *
+ * @param x The x-coordinate of the pixel.
+ * @param y The y-coordinate of the pixel.
+ * @return A reference to the pixel value at the specified coordinates.
+ */
+unsigned char &Image::at(int x, int y)
+{
+    invalidateStatistics();
+    detach();
+    return this->m_data[x][y];
+}
+
 /**
  * Returns a reference to the pixel value at the specified point.
  *
@@ -199,6 +309,8 @@ unsigned char &Image::at(int x, int y) const
  */
 unsigned char &Image::at(Point point)
 {
+    invalidateStatistics();
+    detach();
     return this->m_data[point.getX()][point.getY()];
 }
 
@@ -210,6 +322,8 @@ unsigned char &Image::at(Point point)
  */
 unsigned char *Image::row(int y)
 {
+    invalidateStatistics();
+    detach();
     return this->m_data[y];
 }
 
@@ -226,6 +340,7 @@ bool Image::getROI(Image &roiImg, Rectangle roiRect)
     if (roiRect.getX() + roiRect.getWidth() > roiImg.getWidth() || roiRect.getY() + roiRect.getHeight() > roiImg.getHeight())
         return false;
 
+    ImageMetrics::Site site("Image::getROI");
     Image cropped(roiRect.getWidth(), roiRect.getHeight());
     for (int i = 0; i < cropped.getHeight(); ++i)
     {
@@ -252,6 +367,7 @@ bool Image::getROI(Image &roiImg, unsigned int x, unsigned int y, unsigned int w
     if (x + width > roiImg.getWidth() || y + height > roiImg.getHeight())
         return false;
 
+    ImageMetrics::Site site("Image::getROI");
     Image cropped(width, height);
     for (int i = 0; i < cropped.getHeight(); ++i)
     {
@@ -262,18 +378,137 @@ bool Image::getROI(Image &roiImg, unsigned int x, unsigned int y, unsigned int w
     return true;
 }
 
+/**
+ * Makes the image w x h. The buffers are kept when the size is unchanged, so assigning or
+ * processing into an image of the right size allocates nothing; otherwise they are reallocated
+ * and zeroed.
+ *
+ * @param w The width of the image.
+ * @param h The height of the image.
+ */
+void Image::create(unsigned int w, unsigned int h)
+{
+    invalidateStatistics();
+    if (this->m_data != nullptr && w == this->m_width && h == this->m_height)
+    {
+        detach();
+        return;
+    }
+    TRACE_SCOPE("Image::create", "memory");
+    release();
+    ImageMetrics::Timer timer(ImageMetrics::ALLOCATION, static_cast<size_t>(w) * h);
+    allocate(w, h);
+    for (unsigned int i = 0; i < h; ++i)
+        std::memset(this->m_data[i], 0, w);
+}
+
+/**
+ * Points the image at a new w x h buffer from the pool: a header holding the reference count,
+ * the row pointers, then the rows. The current buffer is neither freed nor copied, and the
+ * pixels are not initialized.
+ *
+ * @param w The width of the image.
+ * @param h The height of the image.
+ */
+void Image::allocate(unsigned int w, unsigned int h)
+{
+    size_t pointers = static_cast<size_t>(h) * sizeof(unsigned char *);
+    size_t pixelCount = static_cast<size_t>(w) * h;
+    this->m_buffer = ImagePool::allocate(HEADER_SIZE + pointers + pixelCount, this->m_capacity);
+    BufferHeader *info = new (this->m_buffer) BufferHeader();
+    info->references.store(1, std::memory_order_relaxed);
+    info->pixels = pixelCount;
+    this->m_data = reinterpret_cast<unsigned char **>(this->m_buffer + HEADER_SIZE);
+    unsigned char *pixels = this->m_buffer + HEADER_SIZE + pointers;
+    for (unsigned int i = 0; i < h; ++i)
+        this->m_data[i] = pixels + static_cast<size_t>(i) * w;
+    this->m_width = w;
+    this->m_height = h;
+}
+
+/**
+ * Points the image at the buffer of another image, adding a reference to it. The current buffer
+ * is not freed.
+ *
+ * @param other The image whose pixels are shared.
+ */
+void Image::share(const Image &other)
+{
+    header(other.m_buffer).references.fetch_add(1, std::memory_order_relaxed);
+    this->m_buffer = other.m_buffer;
+    this->m_capacity = other.m_capacity;
+    this->m_data = other.m_data;
+    this->m_width = other.m_width;
+    this->m_height = other.m_height;
+}
+
+/**
+ * Returns whether copies share the pixels of their source until either is written.
+ *
+ * @return True if copy-on-write is on.
+ */
+bool Image::isCopyOnWrite()
+{
+    return s_copyOnWrite.load(std::memory_order_relaxed);
+}
+
+/**
+ * Turns copy-on-write on or off for the copies made from now on. Images already sharing a
+ * buffer keep sharing it until they are written.
+ *
+ * @param enabled True to share pixels between copies.
+ */
+void Image::setCopyOnWrite(bool enabled)
+{
+    s_copyOnWrite.store(enabled, std::memory_order_relaxed);
+}
+
+/**
+ * Returns whether the image shares its pixels with another image.
+ *
+ * @return True if the buffer is shared.
+ */
+bool Image::isShared() const
+{
+    return this->m_buffer != nullptr && header(this->m_buffer).references.load(std::memory_order_acquire) > 1;
+}
+
+/**
+ * Gives the image pixels of its own: a shared buffer is copied, row by row in the order of the
+ * row pointers, and the reference to it dropped. Does nothing when the buffer is not shared.
+ */
+void Image::detach()
+{
+    if (!isShared())
+        return;
+    TRACE_SCOPE("Image::detach", "memory");
+    ImageMetrics::Site site("Image::detach");
+    unsigned char **oldData = this->m_data;
+    unsigned char *oldBuffer = this->m_buffer;
+    size_t oldCapacity = this->m_capacity;
+    {
+        ImageMetrics::Timer timer(ImageMetrics::ALLOCATION, static_cast<size_t>(this->m_width) * this->m_height);
+        allocate(this->m_width, this->m_height);
+    }
+    {
+        ImageMetrics::Timer timer(ImageMetrics::COPY, static_cast<size_t>(this->m_width) * this->m_height);
+        for (unsigned int i = 0; i < this->m_height; ++i)
+            std::memcpy(this->m_data[i], oldData[i], this->m_width);
+    }
+    unreference(oldBuffer, oldCapacity);
+}
+
 // Rule of three: destructor, copy constructor, assignment operator
 /**
  * Releases the memory allocated for the image data.
  */
 void Image::release()
 {
-    for (int i = 0; i < this->m_height; ++i)
-    {
-        delete[] this->m_data[i];
-        this->m_data[i] = nullptr;
-    }
-    delete[] this->m_data;
+    invalidateStatistics();
+    if (this->m_buffer != nullptr)
+        unreference(this->m_buffer, this->m_capacity);
+    this->m_buffer = nullptr;
+    this->m_capacity = 0;
     this->m_data = nullptr;
 }
 
@@ -286,43 +521,60 @@ Image::~Image()
 }
 
 /**
- * Copy constructor for the Image class.
+ * Copy constructor for the Image class. With copy-on-write on, the pixels of other are shared
+ * instead of copied.
  *
  * @param other The image to be copied.
  */
-Image::Image(const Image &other)
+Image::Image(const Image &other) : m_statistics{}, m_statisticsValid{false}
 {
-    this->m_width = other.getWidth();
-    this->m_height = other.getHeight();
-    this->m_data = new unsigned char *[this->m_height];
-    for (int i = 0; i < this->m_height; ++i)
+    copyStatistics(other);
+    if (other.m_buffer != nullptr && isCopyOnWrite())
     {
-        this->m_data[i] = new unsigned char[this->m_width];
-        for (int j = 0; j < this->m_width; ++j)
-            m_data[i][j] = other.m_data[i][j];
+        share(other);
+        return;
+    }
+    TRACE_SCOPE("Image::Image(copy)", "memory");
+    {
+        ImageMetrics::Timer timer(ImageMetrics::ALLOCATION, static_cast<size_t>(other.getWidth()) * other.getHeight());
+        allocate(other.getWidth(), other.getHeight());
     }
+    ImageMetrics::Timer timer(ImageMetrics::COPY, static_cast<size_t>(this->m_width) * this->m_height);
+    for (int i = 0; i < this->m_height; ++i)
+        std::memcpy(this->m_data[i], other.m_data[i], this->m_width);
 }
 
 /**
- * Assignment operator for the Image class.
+ * Assignment operator for the Image class. With copy-on-write on, the pixels of other are shared
+ * instead of copied, and the current buffer is released.
  *
  * @param other The image to be assigned.
  * @return Reference to the assigned image.
  */
 Image &Image::operator=(const Image &other)
 {
-    if (this != &other)
+    if (this != &other && other.m_buffer != nullptr && isCopyOnWrite())
     {
-        release();
-        m_width = other.getWidth();
-        m_height = other.getHeight();
-        m_data = new unsigned char *[m_height];
-        for (int i = 0; i < m_height; ++i)
+        if (this->m_buffer != other.m_buffer)
         {
-            m_data[i] = new unsigned char[m_width];
-            for (int j = 0; j < m_width; ++j)
-                m_data[i][j] = other.m_data[i][j];
+            release();
+            share(other);
         }
+        else
+        {
+            this->m_data = other.m_data;
+            this->m_width = other.m_width;
+            this->m_height = other.m_height;
+        }
+        copyStatistics(other);
+    }
+    else if (this != &other)
+    {
+        create(other.getWidth(), other.getHeight());
+        ImageMetrics::Timer timer(ImageMetrics::COPY, static_cast<size_t>(m_width) * m_height);
+        for (int i = 0; i < m_height; ++i)
+            std::memcpy(m_data[i], other.m_data[i], m_width);
+        copyStatistics(other);
     }
     return *this;
 }
@@ -470,17 +722,66 @@ std::istream &operator>>(std::istream &is, Image &dt)
 }
 
 /**
- * Loads an image from a file.
+ * Reads the next number of a PGM header, skipping the white space and the comments before it.
+ *
+ * @param is The input stream.
+ * @param value The number read.
+ * @return True if a number was read.
+ */
+static bool readHeaderNumber(std::istream &is, unsigned int &value)
+{
+    while (true)
+    {
+        is >> std::ws;
+        if (is.peek() != '#')
+            break;
+        std::string comment;
+        std::getline(is, comment);
+    }
+    return static_cast<bool>(is >> value);
+}
+
+/**
+ * Loads an image from a file, in the ASCII (P2) or binary (P5) PGM format.
+ *
+ * The pixels of a binary file are read a whole row at a time, straight into the image. Its
+ * header is checked against the size of the file before anything is allocated, so a corrupt
+ * one fails the load. Binary files with more than 8 bits per pixel are not supported.
  *
  * @param imagePath The path to the image file.
  * @return True if the image is successfully loaded, false otherwise.
  */
 bool Image::load(const std::string imagePath)
 {
-    std::ifstream file(imagePath);
+    TRACE_SCOPE("Image::load", "io");
+    std::ifstream file(imagePath, std::ios::binary);
     if (!file.is_open())
         return false;
 
+    char magic[2] = {0, 0};
+    file.read(magic, 2);
+    if (magic[0] == 'P' && magic[1] == '5')
+    {
+        unsigned int width, height, maxPixelValue;
+        if (!readHeaderNumber(file, width) || !readHeaderNumber(file, height) || !readHeaderNumber(file, maxPixelValue) ||
+            maxPixelValue > 255)
+            return false;
+        // A single white space character separates the header from the pixels.
+        file.get();
+        // A header claiming more pixels than the file holds is rejected before allocating them.
+        std::streampos pixels = file.tellg();
+        file.seekg(0, std::ios::end);
+        std::streamoff remaining = file.tellg() - pixels;
+        file.seekg(pixels);
+        if (!file || remaining < 0 || static_cast<unsigned long long>(width) * height > static_cast<unsigned long long>(remaining))
+            return false;
+        create(width, height);
+        for (unsigned int i = 0; i < height; ++i)
+            file.read(reinterpret_cast<char *>(this->m_data[i]), width);
+        return static_cast<bool>(file);
+    }
+
+    file.seekg(0);
     file >> *this;
     file.close();
     return true;
@@ -489,17 +790,28 @@ bool Image::load(const std::string imagePath)
 /**
  * Saves the image to a file in PGM format.
  *
+ * The binary format writes every row with a single call and uses a maximum value of 255.
+ *
  * @param imagePath The path to save the image.
+ * @param binary True to write the binary (P5) format instead of the ASCII (P2) one.
  * @return True if the image is successfully saved, false otherwise.
  */
-bool Image::save(const std::string imagePath) const
+bool Image::save(const std::string imagePath, bool binary) const
 {
-    std::ofstream file(imagePath);
+    TRACE_SCOPE("Image::save", "io");
+    std::ofstream file(imagePath, binary ? std::ios::binary : std::ios::out);
     if (!file.is_open())
         return false;
-    file << *this;
+    if (binary)
+    {
+        file << "P5\n# This is a pgm format\n" << this->m_width << " " << this->m_height << "\n255\n";
+        for (unsigned int i = 0; i < this->m_height; ++i)
+            file.write(reinterpret_cast<const char *>(this->m_data[i]), this->m_width);
+    }
+    else
+        file << *this;
     file.close();
-    return true;
+    return static_cast<bool>(file);
 }
 
 /**
@@ -2,6 +2,9 @@
 #include "Size.h"
 #include "Point.h"
 #include "Rectangle.h"
+#include "ImageStatistics.h"
+#include <atomic>
+#include <mutex>
 #include <string>
 
 class Image
@@ -33,6 +36,7 @@ public:
     /**
      * @brief Assignment operator for the Image class.
      * Assigns the contents of another Image object to this object.
+     * The buffers are reused when both images have the same size.
      *
      * @param other Another Image object to assign from.
      * @return A reference to this Image object after assignment.
@@ -46,7 +50,7 @@ public:
     ~Image();
 
     /**
-     * @brief Loads an image from the specified file.
+     * @brief Loads an image from the specified file, in the ASCII (P2) or binary (P5) PGM format.
      *
      * @param imagePath Path to the image file.
      * @return True if the image was successfully loaded, false otherwise.
@@ -57,9 +61,10 @@ public:
      * @brief Saves the image to the specified file.
      *
      * @param imagePath Path to save the image file.
+     * @param binary True to write the binary (P5) PGM format instead of the ASCII (P2) one.
      * @return True if the image was successfully saved, false otherwise.
      */
-    bool save(std::string imagePath) const;
+    bool save(std::string imagePath, bool binary = false) const;
 
     /**
      * @brief Performs element-wise addition of two images.
@@ -141,6 +146,48 @@ public:
      */
     unsigned char **getData() const;
 
+    /**
+     * @brief Returns a pointer to the raw pixel data of the image, for writing.
+     * Invalidates the cached statistics.
+     *
+     * @return Pointer to the raw pixel data.
+     */
+    unsigned char **getData();
+
+    /**
+     * @brief Returns whether copies share the pixels of their source until either is written.
+     *
+     * @return True if copy-on-write is on.
+     */
+    static bool isCopyOnWrite();
+
+    /**
+     * @brief Turns copy-on-write on or off for the copies made from now on.
+     *
+     * When on, the copy constructor and operator= share the reference-counted buffer of their
+     * source instead of copying it, so copying a frame that is never written costs O(1). The
+     * first write through setPixel(), at(), row() or getData() on a non-const image, and
+     * create(), setWidth() and setHeight(), give the image pixels of its own again. Writing
+     * through the const at() or getData(), or through a pointer obtained before the copy, writes
+     * to every image sharing the buffer. An image shared with another must not be written from
+     * several threads before its first write; call detach() first.
+     *
+     * @param enabled True to share pixels between copies.
+     */
+    static void setCopyOnWrite(bool enabled);
+
+    /**
+     * @brief Returns whether the image shares its pixels with another image.
+     *
+     * @return True if the buffer is shared.
+     */
+    bool isShared() const;
+
+    /**
+     * @brief Gives the image pixels of its own, copying them if they are shared.
+     */
+    void detach();
+
     /**
      * @brief Sets the width of the image.
      *
@@ -181,6 +228,16 @@ public:
      */
     unsigned char &at(int x, int y) const;
 
+    /**
+     * @brief Accesses the pixel value at the specified coordinates, for writing.
+     * Invalidates the cached statistics.
+     *
+     * @param x X-coordinate of the pixel.
+     * @param y Y-coordinate of the pixel.
+     * @return Reference to the pixel value.
+     */
+    unsigned char &at(int x, int y);
+
     /**
      * @brief Accesses the pixel value at the specified point.
      *
@@ -197,6 +254,16 @@ public:
      */
     unsigned char *row(int y);
 
+    /**
+     * @brief Makes the image w x h, keeping its buffers when the size is unchanged.
+     *
+     * The pixels are left as they are when the size is unchanged, and zeroed otherwise.
+     *
+     * @param w Width of the image.
+     * @param h Height of the image.
+     */
+    void create(unsigned int w, unsigned int h);
+
     /**
      * @brief Releases the memory allocated for the image data.
      */
@@ -245,8 +312,56 @@ public:
      */
     unsigned int maxPixelValue() const;
 
+    /**
+     * @brief Returns the min, max, sum, sum of squares and non-zero count of the pixels.
+     *
+     * The statistics are computed in one pass on the first call and cached until the pixels are
+     * written through setPixel(), at(), row() or getData() on a non-const image. Several threads
+     * may ask for them at once; they are computed only once.
+     *
+     * @return The statistics of the image.
+     */
+    ImageStatistics statistics() const;
+
+    /**
+     * @brief Discards the cached statistics.
+     *
+     * Only needed after writing through a row pointer obtained before the last call to statistics().
+     */
+    void invalidateStatistics();
+
 private:
-    unsigned char **m_data; ///< Pointer to the raw pixel data of the image.
-    unsigned int m_width;   ///< Width of the image.
-    unsigned int m_height;  ///< Height of the image.
+    /**
+     * @brief Points the image at a new w x h buffer, without freeing the current one or
+     * initializing the pixels.
+     *
+     * @param w Width of the image.
+     * @param h Height of the image.
+     */
+    void allocate(unsigned int w, unsigned int h);
+
+    /**
+     * @brief Points the image at the buffer of another image, without freeing the current one.
+     *
+     * @param other The image whose pixels are shared.
+     */
+    void share(const Image &other);
+
+    /**
+     * @brief Takes over the cached statistics of another image, if they are up to date.
+     *
+     * @param other The image whose statistics are copied.
+     */
+    void copyStatistics(const Image &other);
+
+    unsigned char **m_data;                      ///< Pointer to the raw pixel data of the image.
+    unsigned char *m_buffer;                     ///< The pooled, reference-counted buffer holding the row pointers and the pixels.
+    size_t m_capacity;                           ///< The size of m_buffer.
+    unsigned int m_width;                        ///< Width of the image.
+    unsigned int m_height;                       ///< Height of the image.
+    mutable ImageStatistics m_statistics;        ///< The cached statistics of the pixels, written once per change of the pixels.
+    mutable std::atomic<bool> m_statisticsValid; ///< Whether m_statistics matches the pixels.
+    mutable std::mutex m_statisticsMutex;        ///< Serializes the computation of m_statistics.
+
+    static std::atomic<bool> s_copyOnWrite;      ///< Whether copies share their pixels.
 };
@@ -1,5 +1,10 @@
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include "ImageConvolution.h"
+#include "Parallel.h"
+#include "ImageMetrics.h"
+#include "Trace.h"
 
 /**
  * @brief Constructor.
@@ -121,27 +126,98 @@ int ImageConvolution::verticalSobelScaling(int filteredValue)
 /**
  * Applies convolution operation on the source image and stores the result in the destination image.
  *
+ * The result is written straight into dst, in parallel row bands, and dst keeps its buffers when it
+ * already has the output size.
+ *
  * @param src The source image on which the convolution operation is applied.
  * @param dst The destination image where the result of the convolution operation is stored.
  */
 void ImageConvolution::process(const Image &src, Image &dst)
 {
-    int outputW = src.getWidth() - (src.getWidth() % this->w);
-    int outputH = src.getHeight() - (src.getHeight() % this->h);
-    Image output(outputW, outputH);
+    TRACE_SCOPE("ImageConvolution::process", "process");
+    ImageMetrics::Site site("ImageConvolution::process");
+    if (&src == &dst)
+    {
+        Image copy(src);
+        process(copy, dst);
+        return;
+    }
+    Size size = outputSize(src.size());
+    dst.create(size.getWidth(), size.getHeight());
+    unsigned char **in = src.getData();
+    unsigned char **out = dst.getData();
+    Parallel::forRows(0, size.getHeight(), [&](unsigned int first, unsigned int last)
+                      { processRows(in, src.size(), out, size, first, last); });
+}
+
+/**
+ * @brief A convolution only reads the rows within the kernel radius, so it can be computed a range of rows at a time.
+ *
+ * @return True.
+ */
+bool ImageConvolution::supportsRows() const
+{
+    return true;
+}
+
+/**
+ * @brief Returns the vertical radius of the kernel.
+ *
+ * @return The number of rows above and below an output row that it depends on.
+ */
+unsigned int ImageConvolution::neighborhood() const
+{
+    return this->h / 2;
+}
 
+/**
+ * @brief Returns the size of the output, cropped to a multiple of the kernel size.
+ *
+ * @param inputSize The size of the source.
+ * @return The size of the output.
+ */
+Size ImageConvolution::outputSize(const Size &inputSize) const
+{
+    return Size(inputSize.getWidth() - inputSize.getWidth() % this->w, inputSize.getHeight() - inputSize.getHeight() % this->h);
+}
+
+/**
+ * Computes the rows [first, last) of the output, with the same result as applyKernel() on every
+ * pixel the kernel fits on. The border pixels the kernel does not fit on are set to zero.
+ *
+ * @param in The rows of the source.
+ * @param inputSize The size of the source.
+ * @param out The rows of the output.
+ * @param outputSize The size of the output.
+ * @param first The first row to compute.
+ * @param last One past the last row to compute.
+ */
+void ImageConvolution::processRows(unsigned char **in, const Size & /* inputSize */, unsigned char **out, const Size &outputSize,
+                                   unsigned int first, unsigned int last)
+{
+    int outputW = outputSize.getWidth();
+    int outputH = outputSize.getHeight();
     int paddingW = this->w / 2;
     int paddingH = this->h / 2;
 
-    for (int i = paddingH; i < outputH - paddingH; ++i)
+    for (int i = first; i < static_cast<int>(last); ++i)
     {
+        std::memset(out[i], 0, outputW);
+        if (i < paddingH || i >= outputH - paddingH)
+            continue;
         for (int j = paddingW; j < outputW - paddingW; ++j)
         {
-            int filteredValue = applyKernel(src, i, j);
-            output.setPixel(i, j, this->scalingFunction(filteredValue));
+            int filteredValue = 0;
+            for (int k = 0; k < this->h; ++k)
+            {
+                const unsigned char *row = in[i + k - paddingH] + j - paddingW;
+                const int *weights = this->kernel[k];
+                for (int l = 0; l < this->w; ++l)
+                    filteredValue += row[l] * weights[l];
+            }
+            out[i][j] = static_cast<unsigned char>(std::min(std::max(this->scalingFunction(filteredValue), 0), 255));
         }
     }
-    dst = output;
 }
 
 /**
@@ -42,6 +42,41 @@ public:
      */
     void process(const Image &src, Image &dst) override;
 
+    /**
+     * @brief A convolution only reads the rows within the kernel radius, so it can be computed a range of rows at a time.
+     *
+     * @return True.
+     */
+    bool supportsRows() const override;
+
+    /**
+     * @brief Returns the vertical radius of the kernel.
+     *
+     * @return The number of rows above and below an output row that it depends on.
+     */
+    unsigned int neighborhood() const override;
+
+    /**
+     * @brief Returns the size of the output, cropped to a multiple of the kernel size.
+     *
+     * @param inputSize The size of the source.
+     * @return The size of the output.
+     */
+    Size outputSize(const Size &inputSize) const override;
+
+    /**
+     * @brief Computes the rows [first, last) of the output.
+     *
+     * @param in The rows of the source.
+     * @param inputSize The size of the source.
+     * @param out The rows of the output.
+     * @param outputSize The size of the output.
+     * @param first The first row to compute.
+     * @param last One past the last row to compute.
+     */
+    void processRows(unsigned char **in, const Size &inputSize, unsigned char **out, const Size &outputSize,
+                     unsigned int first, unsigned int last) override;
+
     /**
      * @brief Static method for mean blur scaling.
      *
@@ -0,0 +1,301 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include "ImageMetrics.h"
+
+std::atomic<bool> ImageMetrics::enabled{false};
+std::atomic<long long> ImageMetrics::live{0};
+std::atomic<long long> ImageMetrics::peak{0};
+thread_local const char *ImageMetrics::current = nullptr;
+
+namespace
+{
+const char *const UNATTRIBUTED = "unattributed"; ///< The site of events outside of any site.
+
+/**
+ * The counters of one thread, keyed by the address of the site name. Only the thread adds to
+ * them, and the mutex is only contended while a snapshot is taken.
+ */
+struct Table
+{
+    std::mutex mutex;
+    std::unordered_map<const char *, ImageMetrics::SiteCounters> sites;
+};
+
+/**
+ * The tables of every thread that recorded an event. They are never freed, so that the counts of
+ * threads that exited stay in the snapshots.
+ */
+struct Registry
+{
+    std::mutex mutex;
+    std::vector<Table *> tables;
+};
+
+Registry &registry()
+{
+    static Registry *instance = new Registry();
+    return *instance;
+}
+
+/**
+ * Returns the table of the calling thread, registering it on first use.
+ */
+Table &localTable()
+{
+    thread_local Table *table = nullptr;
+    if (table == nullptr)
+    {
+        table = new Table();
+        Registry &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.tables.push_back(table);
+    }
+    return *table;
+}
+
+/**
+ * Returns the latency bucket of a duration: the number of doublings above 64 ns.
+ */
+int bucket(std::uint64_t nanoseconds)
+{
+    int k = 0;
+    for (std::uint64_t bound = 64; k < ImageMetrics::BUCKETS - 1 && nanoseconds >= bound; bound *= 2)
+        ++k;
+    return k;
+}
+
+/**
+ * Adds the counters of b to a.
+ */
+void add(ImageMetrics::Events &a, const ImageMetrics::Events &b)
+{
+    a.count += b.count;
+    a.bytes += b.bytes;
+    a.nanoseconds += b.nanoseconds;
+    for (int k = 0; k < ImageMetrics::BUCKETS; ++k)
+        a.latency[k] += b.latency[k];
+}
+
+/**
+ * Appends the counters of one kind of event at every site as a Prometheus counter of the count,
+ * a counter of the bytes and a histogram of the latency in seconds.
+ */
+void appendEvents(std::string &text, const std::vector<ImageMetrics::SiteCounters> &sites, const char *name,
+                  const char *help, ImageMetrics::Events ImageMetrics::SiteCounters::*events)
+{
+    char line[256];
+    std::snprintf(line, sizeof(line), "# HELP image_%s_total %s.\n# TYPE image_%s_total counter\n", name, help, name);
+    text += line;
+    for (const ImageMetrics::SiteCounters &site : sites)
+    {
+        std::snprintf(line, sizeof(line), "image_%s_total{site=\"%s\"} %llu\n", name, site.site.c_str(),
+                      (site.*events).count);
+        text += line;
+    }
+    std::snprintf(line, sizeof(line), "# HELP image_%s_bytes_total The bytes of the %s.\n# TYPE image_%s_bytes_total counter\n",
+                  name, name, name);
+    text += line;
+    for (const ImageMetrics::SiteCounters &site : sites)
+    {
+        std::snprintf(line, sizeof(line), "image_%s_bytes_total{site=\"%s\"} %llu\n", name, site.site.c_str(),
+                      (site.*events).bytes);
+        text += line;
+    }
+    std::snprintf(line, sizeof(line), "# HELP image_%s_seconds The latency of the %s.\n# TYPE image_%s_seconds histogram\n",
+                  name, name, name);
+    text += line;
+    for (const ImageMetrics::SiteCounters &site : sites)
+    {
+        const ImageMetrics::Events &e = site.*events;
+        unsigned long long cumulative = 0;
+        for (int k = 0; k < ImageMetrics::BUCKETS; ++k)
+        {
+            cumulative += e.latency[k];
+            if (k < ImageMetrics::BUCKETS - 1)
+                std::snprintf(line, sizeof(line), "image_%s_seconds_bucket{site=\"%s\",le=\"%g\"} %llu\n", name,
+                              site.site.c_str(), static_cast<double>(64ull << k) * 1e-9, cumulative);
+            else
+                std::snprintf(line, sizeof(line), "image_%s_seconds_bucket{site=\"%s\",le=\"+Inf\"} %llu\n", name,
+                              site.site.c_str(), cumulative);
+            text += line;
+        }
+        std::snprintf(line, sizeof(line), "image_%s_seconds_sum{site=\"%s\"} %.9f\nimage_%s_seconds_count{site=\"%s\"} %llu\n",
+                      name, site.site.c_str(), static_cast<double>(e.nanoseconds) * 1e-9, name, site.site.c_str(),
+                      e.count);
+        text += line;
+    }
+}
+} // namespace
+
+/**
+ * @brief Turns accounting on or off.
+ *
+ * @param newEnabled True to record events.
+ */
+void ImageMetrics::setEnabled(bool newEnabled)
+{
+    enabled.store(newEnabled, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Returns the time on the steady clock.
+ *
+ * @return The time in nanoseconds.
+ */
+std::uint64_t ImageMetrics::now()
+{
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+/**
+ * @brief Records an event at the current site of the calling thread. Allocations also raise the
+ * live bytes and, with them, the peak.
+ *
+ * @param kind The kind of the event.
+ * @param bytes The bytes allocated or copied.
+ * @param nanoseconds The time the event took.
+ */
+void ImageMetrics::record(Kind kind, size_t bytes, std::uint64_t nanoseconds)
+{
+    if (!isEnabled())
+        return;
+    const char *site = current != nullptr ? current : UNATTRIBUTED;
+    Table &table = localTable();
+    {
+        std::lock_guard<std::mutex> lock(table.mutex);
+        SiteCounters &counters = table.sites[site];
+        Events &events = kind == ALLOCATION ? counters.allocations : counters.copies;
+        ++events.count;
+        events.bytes += bytes;
+        events.nanoseconds += nanoseconds;
+        ++events.latency[bucket(nanoseconds)];
+    }
+    if (kind == ALLOCATION)
+    {
+        long long now = live.fetch_add(static_cast<long long>(bytes), std::memory_order_relaxed) +
+                        static_cast<long long>(bytes);
+        long long seen = peak.load(std::memory_order_relaxed);
+        while (now > seen && !peak.compare_exchange_weak(seen, now, std::memory_order_relaxed))
+        {
+        }
+    }
+}
+
+/**
+ * @brief Records that a pixel buffer was freed.
+ *
+ * @param bytes The size of the buffer.
+ */
+void ImageMetrics::release(size_t bytes)
+{
+    if (isEnabled())
+        live.fetch_sub(static_cast<long long>(bytes), std::memory_order_relaxed);
+}
+
+/**
+ * @brief Returns the counters of every site that recorded an event, summed over the threads and
+ * sorted by name.
+ *
+ * @return The counters.
+ */
+std::vector<ImageMetrics::SiteCounters> ImageMetrics::sites()
+{
+    std::map<std::string, SiteCounters> merged;
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (Table *table : r.tables)
+    {
+        std::lock_guard<std::mutex> tableLock(table->mutex);
+        for (const auto &entry : table->sites)
+        {
+            SiteCounters &counters = merged[entry.first];
+            add(counters.allocations, entry.second.allocations);
+            add(counters.copies, entry.second.copies);
+        }
+    }
+    std::vector<SiteCounters> result;
+    result.reserve(merged.size());
+    for (auto &entry : merged)
+    {
+        entry.second.site = entry.first;
+        result.push_back(entry.second);
+    }
+    return result;
+}
+
+/**
+ * @brief Returns the bytes of image memory allocated and not freed yet.
+ *
+ * @return The live bytes, 0 if more was freed than allocated while accounting was on.
+ */
+long long ImageMetrics::liveBytes()
+{
+    return std::max(live.load(std::memory_order_relaxed), 0ll);
+}
+
+/**
+ * @brief Returns the highest value of liveBytes() since accounting started or was reset.
+ *
+ * @return The peak bytes.
+ */
+long long ImageMetrics::peakBytes()
+{
+    return peak.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Zeroes the counters of every site and restarts the peak from the live bytes.
+ */
+void ImageMetrics::reset()
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (Table *table : r.tables)
+    {
+        std::lock_guard<std::mutex> tableLock(table->mutex);
+        table->sites.clear();
+    }
+    peak.store(liveBytes(), std::memory_order_relaxed);
+}
+
+/**
+ * Returns a snapshot of the counters in the Prometheus text format: per site, counters of the
+ * allocations, the copies and their bytes and histograms of their latency, followed by gauges of
+ * the live and peak bytes.
+ *
+ * @return The snapshot.
+ */
+std::string ImageMetrics::toText()
+{
+    std::vector<SiteCounters> counters = sites();
+    std::string text;
+    appendEvents(text, counters, "allocations", "The pixel buffers allocated", &SiteCounters::allocations);
+    appendEvents(text, counters, "copies", "The frames copied", &SiteCounters::copies);
+    text += "# HELP image_live_bytes The image memory allocated and not freed yet.\n# TYPE image_live_bytes gauge\n";
+    text += "image_live_bytes " + std::to_string(liveBytes()) + "\n";
+    text += "# HELP image_peak_live_bytes The peak of image_live_bytes.\n# TYPE image_peak_live_bytes gauge\n";
+    text += "image_peak_live_bytes " + std::to_string(peakBytes()) + "\n";
+    return text;
+}
+
+/**
+ * @brief Writes a snapshot of the counters in the Prometheus text format.
+ *
+ * @param path The path of the file.
+ * @return True if the file was written.
+ */
+bool ImageMetrics::write(const std::string &path)
+{
+    std::ofstream file(path);
+    if (!file.is_open())
+        return false;
+    file << toText();
+    file.close();
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,211 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @class ImageMetrics
+ * @brief Counts the pixel buffers the library allocates and the frames it copies, per call site.
+ *
+ * Image reports every allocation of its buffers (construction, create() with a new size,
+ * setWidth(), setHeight()) and every copy of a whole frame (the copy constructor, operator=,
+ * getROI(), and the copy of the kept pixels in setWidth() and setHeight()), with the number of
+ * bytes and the time it took. The events are attributed to the innermost Site of the calling
+ * thread: the operators open one named after themselves in process() and processBatch(), and
+ * Parallel carries the site of a forRows() call over to the threads running its chunks.
+ *
+ * For every site the counts, bytes and a latency histogram of allocations and copies are kept;
+ * the live and peak bytes of image memory are kept process-wide. sites() queries them at
+ * runtime, and toText() snapshots them in the Prometheus text format.
+ *
+ * Accounting is off until setEnabled(true); while off, an event costs one relaxed atomic load.
+ * Buffers allocated or freed while it is off are not counted, so the live and peak bytes are
+ * only exact when it is turned on before the first image is created and left on.
+ */
+class ImageMetrics
+{
+public:
+    static const int BUCKETS = 21; ///< The latency buckets: bucket k < BUCKETS - 1 holds times below 2^(k + 6) ns.
+
+    /**
+     * @brief The kinds of events.
+     */
+    enum Kind
+    {
+        ALLOCATION, ///< A pixel buffer was allocated.
+        COPY        ///< A frame was copied.
+    };
+
+    /**
+     * @brief The events of one kind at one site.
+     */
+    struct Events
+    {
+        unsigned long long count = 0;             ///< The number of events.
+        unsigned long long bytes = 0;             ///< The bytes allocated or copied.
+        unsigned long long nanoseconds = 0;       ///< The total time of the events.
+        unsigned long long latency[BUCKETS] = {}; ///< The number of events per latency bucket.
+    };
+
+    /**
+     * @brief The counters of one call site.
+     */
+    struct SiteCounters
+    {
+        std::string site;   ///< The name of the site.
+        Events allocations; ///< The buffers allocated at the site.
+        Events copies;      ///< The frames copied at the site.
+    };
+
+    /**
+     * @class Site
+     * @brief Attributes the events of the calling thread to a name for the rest of the enclosing block.
+     */
+    class Site
+    {
+    private:
+        const char *previous; ///< The site it replaces.
+
+    public:
+        /**
+         * @brief Enters the site.
+         *
+         * @param name The name of the site, a string that outlives the metrics.
+         */
+        explicit Site(const char *name) : previous{current} { current = name; }
+
+        /**
+         * @brief Returns to the enclosing site.
+         */
+        ~Site() { current = this->previous; }
+
+        Site(const Site &) = delete;
+        Site &operator=(const Site &) = delete;
+    };
+
+    /**
+     * @class Timer
+     * @brief Records an event covering the rest of the enclosing block when accounting is on.
+     */
+    class Timer
+    {
+    private:
+        Kind kind;           ///< The kind of the event.
+        size_t bytes;        ///< The bytes allocated or copied.
+        std::uint64_t start; ///< The start of the event plus one, 0 when accounting was off.
+
+    public:
+        /**
+         * @brief Starts the event.
+         *
+         * @param kind The kind of the event.
+         * @param bytes The bytes allocated or copied.
+         */
+        Timer(Kind kind, size_t bytes) : kind{kind}, bytes{bytes}, start{isEnabled() ? now() + 1 : 0} {}
+
+        /**
+         * @brief Ends the event and records it.
+         */
+        ~Timer()
+        {
+            if (this->start != 0)
+                record(this->kind, this->bytes, now() - (this->start - 1));
+        }
+
+        Timer(const Timer &) = delete;
+        Timer &operator=(const Timer &) = delete;
+    };
+
+    /**
+     * @brief Returns whether events are recorded.
+     *
+     * @return True if accounting is on.
+     */
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Turns accounting on or off.
+     *
+     * @param newEnabled True to record events.
+     */
+    static void setEnabled(bool newEnabled);
+
+    /**
+     * @brief Returns the site the events of the calling thread are attributed to.
+     *
+     * @return The name of the site, nullptr outside of any site.
+     */
+    static const char *currentSite() { return current; }
+
+    /**
+     * @brief Returns the time on the steady clock.
+     *
+     * @return The time in nanoseconds.
+     */
+    static std::uint64_t now();
+
+    /**
+     * @brief Records an event at the current site of the calling thread.
+     *
+     * @param kind The kind of the event.
+     * @param bytes The bytes allocated or copied.
+     * @param nanoseconds The time the event took.
+     */
+    static void record(Kind kind, size_t bytes, std::uint64_t nanoseconds);
+
+    /**
+     * @brief Records that a pixel buffer was freed.
+     *
+     * @param bytes The size of the buffer.
+     */
+    static void release(size_t bytes);
+
+    /**
+     * @brief Returns the counters of every site that recorded an event, sorted by name.
+     *
+     * @return The counters.
+     */
+    static std::vector<SiteCounters> sites();
+
+    /**
+     * @brief Returns the bytes of image memory allocated and not freed yet.
+     *
+     * @return The live bytes.
+     */
+    static long long liveBytes();
+
+    /**
+     * @brief Returns the highest value of liveBytes() since accounting started or was reset.
+     *
+     * @return The peak bytes.
+     */
+    static long long peakBytes();
+
+    /**
+     * @brief Zeroes the counters of every site and restarts the peak from the live bytes.
+     */
+    static void reset();
+
+    /**
+     * @brief Returns a snapshot of the counters in the Prometheus text format.
+     *
+     * @return The snapshot.
+     */
+    static std::string toText();
+
+    /**
+     * @brief Writes a snapshot of the counters in the Prometheus text format.
+     *
+     * @param path The path of the file.
+     * @return True if the file was written.
+     */
+    static bool write(const std::string &path);
+
+private:
+    static std::atomic<bool> enabled;        ///< True while events are recorded.
+    static std::atomic<long long> live;      ///< The live bytes of image memory.
+    static std::atomic<long long> peak;      ///< The peak of live.
+    static thread_local const char *current; ///< The site of the calling thread.
+};
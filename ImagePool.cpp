@@ -0,0 +1,259 @@
+#include <cassert>
+#include <mutex>
+#include <new>
+#include <vector>
+#include "ImagePool.h"
+
+std::atomic<bool> ImagePool::enabled{true};
+
+namespace
+{
+const int MIN_SHIFT = 6;                                 ///< The smallest size class is 2^MIN_SHIFT bytes.
+const int MAX_SHIFT = 40;                                ///< Buffers above 2^(MAX_SHIFT + 1) bytes are not pooled.
+const int CLASSES = (MAX_SHIFT - MIN_SHIFT + 1) * 4 + 1; ///< The number of size classes, 4 per power of two up to MAX_SHIFT.
+const size_t LOCAL_BLOCKS = 4;                           ///< The buffers a thread keeps per size class.
+const size_t LOCAL_BYTES = size_t(64) << 20;             ///< The bytes a thread keeps in all.
+
+std::atomic<size_t> cacheLimit{size_t(256) << 20};       ///< The bytes the shared cache may hold.
+
+/**
+ * Returns the size class of a size: 2^MIN_SHIFT, or 2^k plus one to four quarters of 2^k.
+ *
+ * @param bytes The size.
+ * @return The index of the class, CLASSES when the size is too large to pool.
+ */
+int sizeClass(size_t bytes)
+{
+    if (bytes <= (size_t(1) << MIN_SHIFT))
+        return 0;
+    int k = MIN_SHIFT;
+    while (k < MAX_SHIFT && (size_t(1) << (k + 1)) < bytes)
+        ++k;
+    if ((size_t(1) << (k + 1)) < bytes)
+        return CLASSES;
+    size_t step = size_t(1) << (k - 2);
+    size_t quarters = (bytes - (size_t(1) << k) + step - 1) / step;
+    return (k - MIN_SHIFT) * 4 + static_cast<int>(quarters);
+}
+
+/**
+ * Returns the size of the buffers of a size class.
+ */
+size_t classSize(int index)
+{
+    if (index == 0)
+        return size_t(1) << MIN_SHIFT;
+    int k = MIN_SHIFT + (index - 1) / 4;
+    size_t quarters = static_cast<size_t>((index - 1) % 4 + 1);
+    return (size_t(1) << k) + quarters * (size_t(1) << (k - 2));
+}
+
+/**
+ * The cache shared by every thread, with a lock per size class. It is never destroyed, so that
+ * threads exiting after main() can still flush into it.
+ */
+struct Shared
+{
+    std::mutex mutexes[CLASSES];
+    std::vector<unsigned char *> buffers[CLASSES];
+    std::atomic<size_t> bytes{0};
+};
+
+Shared &shared()
+{
+    static Shared *instance = new Shared();
+    return *instance;
+}
+
+/**
+ * Puts a buffer of class index into the shared cache, or frees it when the cache is full.
+ */
+void release(unsigned char *buffer, size_t capacity, int index)
+{
+    Shared &s = shared();
+    if (s.bytes.fetch_add(capacity, std::memory_order_relaxed) + capacity <= cacheLimit.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(s.mutexes[index]);
+        s.buffers[index].push_back(buffer);
+        return;
+    }
+    s.bytes.fetch_sub(capacity, std::memory_order_relaxed);
+    ::operator delete(buffer);
+}
+
+/**
+ * Takes a buffer of class index from the shared cache.
+ *
+ * @return The buffer, or nullptr if there is none.
+ */
+unsigned char *acquire(size_t capacity, int index)
+{
+    Shared &s = shared();
+    std::lock_guard<std::mutex> lock(s.mutexes[index]);
+    if (s.buffers[index].empty())
+        return nullptr;
+    unsigned char *buffer = s.buffers[index].back();
+    s.buffers[index].pop_back();
+    s.bytes.fetch_sub(capacity, std::memory_order_relaxed);
+    return buffer;
+}
+
+thread_local bool localDestroyed = false; ///< Set once the cache of the thread is destroyed.
+
+/**
+ * The cache of one thread. Its buffers go to the shared cache when the thread exits.
+ */
+struct Local
+{
+    std::vector<unsigned char *> buffers[CLASSES];
+    size_t bytes = 0;
+
+    /**
+     * Moves every buffer to the shared cache.
+     */
+    void flush()
+    {
+        for (int index = 0; index < CLASSES; ++index)
+        {
+            for (unsigned char *buffer : this->buffers[index])
+                release(buffer, classSize(index), index);
+            this->buffers[index].clear();
+        }
+        this->bytes = 0;
+    }
+
+    ~Local()
+    {
+        flush();
+        localDestroyed = true;
+    }
+};
+
+/**
+ * Returns the cache of the calling thread, or nullptr once it is destroyed at thread exit, when
+ * images with static or thread storage may still be freed.
+ */
+Local *local()
+{
+    if (localDestroyed)
+        return nullptr;
+    thread_local Local cache;
+    return &cache;
+}
+} // namespace
+
+/**
+ * @brief Turns the pool on or off. Buffers allocated either way may be freed either way.
+ *
+ * @param newEnabled True to recycle buffers, false to use the heap.
+ */
+void ImagePool::setEnabled(bool newEnabled)
+{
+    enabled.store(newEnabled, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Returns the number of bytes the shared cache may hold.
+ *
+ * @return The limit in bytes.
+ */
+size_t ImagePool::getCacheLimit()
+{
+    return cacheLimit.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Sets the number of bytes the shared cache may hold. Buffers already cached stay until
+ * they are used or trimmed.
+ *
+ * @param bytes The limit in bytes.
+ */
+void ImagePool::setCacheLimit(size_t bytes)
+{
+    cacheLimit.store(bytes, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Returns the number of bytes held by the shared cache.
+ *
+ * @return The cached bytes, not counting the caches of the threads.
+ */
+size_t ImagePool::cachedBytes()
+{
+    return shared().bytes.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Allocates a buffer of the size class of the request, from the cache of the calling
+ * thread, else from the shared cache, else from the heap.
+ *
+ * @param bytes The minimum size of the buffer.
+ * @param capacity Set to the actual size of the buffer, to be passed to deallocate().
+ * @return The buffer, never nullptr even for 0 bytes.
+ */
+unsigned char *ImagePool::allocate(size_t bytes, size_t &capacity)
+{
+    int index = sizeClass(bytes);
+    if (!isEnabled() || index == CLASSES)
+    {
+        capacity = bytes > 0 ? bytes : 1;
+        return static_cast<unsigned char *>(::operator new(capacity));
+    }
+    assert(index >= 0 && index < CLASSES);
+    capacity = classSize(index);
+    Local *cache = local();
+    if (cache != nullptr && !cache->buffers[index].empty())
+    {
+        unsigned char *buffer = cache->buffers[index].back();
+        cache->buffers[index].pop_back();
+        cache->bytes -= capacity;
+        return buffer;
+    }
+    unsigned char *buffer = acquire(capacity, index);
+    return buffer != nullptr ? buffer : static_cast<unsigned char *>(::operator new(capacity));
+}
+
+/**
+ * @brief Returns a buffer to the cache of the calling thread, or to the shared cache when that
+ * one is full. Buffers allocated while the pool was off are only pooled if their size happens to
+ * be a size class.
+ *
+ * @param buffer The buffer, as returned by allocate().
+ * @param capacity The capacity returned with it by allocate().
+ */
+void ImagePool::deallocate(unsigned char *buffer, size_t capacity)
+{
+    int index = sizeClass(capacity);
+    if (!isEnabled() || index == CLASSES || classSize(index) != capacity)
+    {
+        ::operator delete(buffer);
+        return;
+    }
+    assert(index >= 0 && index < CLASSES);
+    Local *cache = local();
+    if (cache != nullptr && cache->buffers[index].size() < LOCAL_BLOCKS && cache->bytes + capacity <= LOCAL_BYTES)
+    {
+        cache->buffers[index].push_back(buffer);
+        cache->bytes += capacity;
+        return;
+    }
+    release(buffer, capacity, index);
+}
+
+/**
+ * @brief Frees the buffers of the shared cache and of the cache of the calling thread.
+ */
+void ImagePool::trim()
+{
+    if (Local *cache = local())
+        cache->flush();
+    Shared &s = shared();
+    for (int index = 0; index < CLASSES; ++index)
+    {
+        std::lock_guard<std::mutex> lock(s.mutexes[index]);
+        for (unsigned char *buffer : s.buffers[index])
+            ::operator delete(buffer);
+        s.bytes.fetch_sub(s.buffers[index].size() * classSize(index), std::memory_order_relaxed);
+        s.buffers[index].clear();
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+/**
+ * @class ImagePool
+ * @brief Recycles the pixel buffers of images instead of returning them to the heap.
+ *
+ * Requests are rounded up to a size class, four per power of two, so frames of about the same
+ * size share buffers. A freed buffer goes to a small cache of the freeing thread, which later
+ * allocations of the thread take from without locking; when that cache is full it goes to a
+ * shared cache with a lock per size class, which threads fall back to when their own is empty.
+ * A pipeline that frees its frames on one thread and allocates them on another still reuses them
+ * through the shared cache. Buffers beyond the limit of the shared cache are freed.
+ *
+ * Image uses the pool by default; setEnabled(false) makes it allocate from the heap again.
+ */
+class ImagePool
+{
+public:
+    /**
+     * @brief Returns whether new buffers come from the pool.
+     *
+     * @return True if the pool is on.
+     */
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Turns the pool on or off. Buffers allocated either way may be freed either way.
+     *
+     * @param newEnabled True to recycle buffers, false to use the heap.
+     */
+    static void setEnabled(bool newEnabled);
+
+    /**
+     * @brief Returns the number of bytes the shared cache may hold.
+     *
+     * @return The limit in bytes.
+     */
+    static size_t getCacheLimit();
+
+    /**
+     * @brief Sets the number of bytes the shared cache may hold; buffers beyond it are freed.
+     *
+     * @param bytes The limit in bytes.
+     */
+    static void setCacheLimit(size_t bytes);
+
+    /**
+     * @brief Returns the number of bytes held by the shared cache.
+     *
+     * @return The cached bytes, not counting the caches of the threads.
+     */
+    static size_t cachedBytes();
+
+    /**
+     * @brief Allocates a buffer.
+     *
+     * @param bytes The minimum size of the buffer.
+     * @param capacity Set to the actual size of the buffer, to be passed to deallocate().
+     * @return The buffer, never nullptr even for 0 bytes.
+     */
+    static unsigned char *allocate(size_t bytes, size_t &capacity);
+
+    /**
+     * @brief Returns a buffer to the pool, or to the heap when the pool is off or full.
+     *
+     * @param buffer The buffer, as returned by allocate().
+     * @param capacity The capacity returned with it by allocate().
+     */
+    static void deallocate(unsigned char *buffer, size_t capacity);
+
+    /**
+     * @brief Frees the buffers of the shared cache and of the cache of the calling thread.
+     */
+    static void trim();
+
+private:
+    static std::atomic<bool> enabled; ///< True while buffers are recycled.
+};
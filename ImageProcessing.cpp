@@ -0,0 +1,27 @@
+#include "ImageProcessing.h"
+#include "Parallel.h"
+#include "ImageMetrics.h"
+#include "Trace.h"
+
+/**
+ * Processes a batch of images, spreading them across the threads of the pool.
+ *
+ * Every thread takes a contiguous run of images and processes them one after another. The
+ * parallel row bands of process() go to the same pool, so a batch of a few large images still
+ * keeps every thread busy, while a batch of many small ones runs mostly one image per thread.
+ *
+ * @param src The source images.
+ * @param dst The processed images, resized to the number of source images.
+ */
+void ImageProcessing::processBatch(const std::vector<Image> &src, std::vector<Image> &dst)
+{
+    TRACE_SCOPE("ImageProcessing::processBatch", "process");
+    ImageMetrics::Site site("ImageProcessing::processBatch");
+    dst.resize(src.size());
+    Parallel::forRows(0, static_cast<unsigned int>(src.size()), [&](unsigned int first, unsigned int last)
+                      {
+                          for (unsigned int i = first; i < last; ++i)
+                              process(src[i], dst[i]);
+                      },
+                      1);
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <vector>
 #include "Image.h"
 
 /**
@@ -14,4 +15,68 @@ public:
      * @param dst The destination image where the processed result will be stored.
      */
     virtual void process(const Image &src, Image &dst) = 0;
+
+    /**
+     * @brief Processes a batch of images, spreading them across the threads of the pool.
+     *
+     * The default runs process() on several images at once, so operators whose process() changes
+     * their own state override it, as do operators with setup worth sharing across the batch.
+     *
+     * @param src The source images.
+     * @param dst The processed images, resized to the number of source images.
+     */
+    virtual void processBatch(const std::vector<Image> &src, std::vector<Image> &dst);
+
+    /**
+     * @brief Returns whether process() may be given the same image as source and destination.
+     *
+     * @return True if the operation can run in place.
+     */
+    virtual bool supportsInPlace() const { return false; }
+
+    /**
+     * @brief Returns whether the output can be computed a range of rows at a time with processRows().
+     *
+     * Row-wise operations keep the size of the image, or crop it from the bottom and the right, so
+     * row i of the output only depends on the rows of the source within neighborhood() of row i.
+     *
+     * @return True if processRows() is implemented.
+     */
+    virtual bool supportsRows() const { return false; }
+
+    /**
+     * @brief Returns the number of rows above and below row i of the source that row i of the output depends on.
+     *
+     * @return 0 for pointwise operations, the vertical radius of the kernel for convolutions.
+     */
+    virtual unsigned int neighborhood() const { return 0; }
+
+    /**
+     * @brief Returns the size of the output of a row-wise operation.
+     *
+     * @param inputSize The size of the source.
+     * @return The size of the output.
+     */
+    virtual Size outputSize(const Size &inputSize) const { return inputSize; }
+
+    /**
+     * @brief Computes the rows [first, last) of the output of a row-wise operation.
+     *
+     * Only called when supportsRows() is true. Both row arrays are indexed by row, but only the
+     * rows that are read or written have to be valid.
+     *
+     * @param in The rows of the source; the rows [first - neighborhood(), last + neighborhood()) within the source are valid.
+     * @param inputSize The size of the source.
+     * @param out The rows of the output; the rows [first, last) are valid.
+     * @param outputSize The size of the output, as returned by outputSize().
+     * @param first The first row to compute.
+     * @param last One past the last row to compute.
+     */
+    virtual void processRows(unsigned char ** /* in */, const Size & /* inputSize */, unsigned char ** /* out */,
+                             const Size & /* outputSize */, unsigned int /* first */, unsigned int /* last */) {}
+
+    /**
+     * @brief Virtual destructor.
+     */
+    virtual ~ImageProcessing() = default;
 };
\ No newline at end of file
@@ -0,0 +1,195 @@
+#include <cmath>
+#include <mutex>
+#include "ImageStatistics.h"
+#include "Parallel.h"
+#include "Simd.h"
+
+/**
+ * @brief Default constructor for the ImageStatistics class.
+ * Initializes the statistics of an empty image.
+ */
+ImageStatistics::ImageStatistics() : min{0}, max{0}, sum{0}, sumOfSquares{0}, nonZero{0}, count{0} {}
+
+/**
+ * @brief Get the smallest pixel value.
+ *
+ * @return The minimum, or 0 for an empty image.
+ */
+unsigned char ImageStatistics::getMin() const
+{
+    return this->min;
+}
+
+/**
+ * @brief Get the largest pixel value.
+ *
+ * @return The maximum, or 0 for an empty image.
+ */
+unsigned char ImageStatistics::getMax() const
+{
+    return this->max;
+}
+
+/**
+ * @brief Get the sum of all pixel values.
+ *
+ * @return The sum.
+ */
+unsigned long long ImageStatistics::getSum() const
+{
+    return this->sum;
+}
+
+/**
+ * @brief Get the sum of all squared pixel values.
+ *
+ * @return The sum of squares.
+ */
+unsigned long long ImageStatistics::getSumOfSquares() const
+{
+    return this->sumOfSquares;
+}
+
+/**
+ * @brief Get the number of pixels that are not 0.
+ *
+ * @return The number of non-zero pixels.
+ */
+unsigned long long ImageStatistics::getNonZero() const
+{
+    return this->nonZero;
+}
+
+/**
+ * @brief Get the number of pixels.
+ *
+ * @return The number of pixels.
+ */
+unsigned long long ImageStatistics::getCount() const
+{
+    return this->count;
+}
+
+/**
+ * @brief Returns the mean pixel value.
+ *
+ * @return The mean, or 0 for an empty image.
+ */
+double ImageStatistics::mean() const
+{
+    return this->count > 0 ? static_cast<double>(this->sum) / this->count : 0.0;
+}
+
+/**
+ * @brief Returns the variance of the pixel values.
+ *
+ * @return The population variance, or 0 for an empty image.
+ */
+double ImageStatistics::variance() const
+{
+    if (this->count == 0)
+        return 0.0;
+    double m = mean();
+    double v = static_cast<double>(this->sumOfSquares) / this->count - m * m;
+    return v > 0 ? v : 0.0;
+}
+
+/**
+ * @brief Returns the standard deviation of the pixel values.
+ *
+ * @return The population standard deviation, or 0 for an empty image.
+ */
+double ImageStatistics::standardDeviation() const
+{
+    return std::sqrt(variance());
+}
+
+/**
+ * Computes the statistics of an image in one pass, in parallel row bands.
+ *
+ * With SSE2, 16 pixels are processed per step: the minimum and maximum with byte min/max, the
+ * sum with a sum of absolute differences against zero, the squares with 16-bit multiply-adds
+ * (flushed to 64 bits before they can overflow) and the zero pixels with a byte compare.
+ *
+ * @param rows The row pointers of the image.
+ * @param width The width of the image.
+ * @param height The height of the image.
+ * @return The statistics.
+ */
+ImageStatistics ImageStatistics::compute(unsigned char *const *rows, unsigned int width, unsigned int height)
+{
+    ImageStatistics result;
+    if (width == 0 || height == 0)
+        return result;
+    result.min = 255;
+    result.count = static_cast<unsigned long long>(width) * height;
+
+    std::mutex resultMutex;
+    Parallel::forRows(0, height, [&](unsigned int first, unsigned int last)
+                      {
+                          unsigned char low = 255, high = 0;
+                          unsigned long long sum = 0, squares = 0, zeros = 0;
+                          for (unsigned int i = first; i < last; ++i)
+                          {
+                              const unsigned char *row = rows[i];
+                              unsigned int j = 0;
+#ifdef IMAGE_PROCESSING_SSE2
+                              const __m128i zero = _mm_setzero_si128();
+                              const __m128i one = _mm_set1_epi8(1);
+                              __m128i vmin = _mm_set1_epi8(static_cast<char>(0xFF));
+                              __m128i vmax = zero;
+                              __m128i vsum = zero;
+                              __m128i vzeros = zero;
+                              while (j + 16 <= width)
+                              {
+                                  // 4096 steps keep every 32-bit square accumulator below 2^31.
+                                  __m128i vsquares = zero;
+                                  for (unsigned int steps = 0; steps < 4096 && j + 16 <= width; ++steps, j += 16)
+                                  {
+                                      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + j));
+                                      vmin = _mm_min_epu8(vmin, v);
+                                      vmax = _mm_max_epu8(vmax, v);
+                                      vsum = _mm_add_epi64(vsum, _mm_sad_epu8(v, zero));
+                                      vzeros = _mm_add_epi64(vzeros, _mm_sad_epu8(_mm_and_si128(_mm_cmpeq_epi8(v, zero), one), zero));
+                                      __m128i lo = _mm_unpacklo_epi8(v, zero);
+                                      __m128i hi = _mm_unpackhi_epi8(v, zero);
+                                      vsquares = _mm_add_epi32(vsquares, _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi)));
+                                  }
+                                  unsigned int lanes[4];
+                                  _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), vsquares);
+                                  squares += static_cast<unsigned long long>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+                              }
+                              unsigned char bytes[16];
+                              _mm_storeu_si128(reinterpret_cast<__m128i *>(bytes), vmin);
+                              for (int k = 0; k < 16; ++k)
+                                  low = bytes[k] < low ? bytes[k] : low;
+                              _mm_storeu_si128(reinterpret_cast<__m128i *>(bytes), vmax);
+                              for (int k = 0; k < 16; ++k)
+                                  high = bytes[k] > high ? bytes[k] : high;
+                              unsigned long long halves[2];
+                              _mm_storeu_si128(reinterpret_cast<__m128i *>(halves), vsum);
+                              sum += halves[0] + halves[1];
+                              _mm_storeu_si128(reinterpret_cast<__m128i *>(halves), vzeros);
+                              zeros += halves[0] + halves[1];
+#endif
+                              for (; j < width; ++j)
+                              {
+                                  unsigned int v = row[j];
+                                  low = v < low ? v : low;
+                                  high = v > high ? v : high;
+                                  sum += v;
+                                  squares += v * v;
+                                  zeros += v == 0;
+                              }
+                          }
+
+                          std::lock_guard<std::mutex> lock(resultMutex);
+                          result.min = low < result.min ? low : result.min;
+                          result.max = high > result.max ? high : result.max;
+                          result.sum += sum;
+                          result.sumOfSquares += squares;
+                          result.nonZero += static_cast<unsigned long long>(last - first) * width - zeros;
+                      },
+                      64);
+    return result;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+/**
+ * @class ImageStatistics
+ * @brief Represents the summary statistics of the pixels of an image.
+ *
+ * All values are gathered together in a single SIMD pass over the image, see compute().
+ * Images cache their statistics (see Image::statistics()), so asking again for the statistics
+ * of an image that was not modified in between costs nothing.
+ */
+class ImageStatistics
+{
+private:
+    unsigned char min;               ///< The smallest pixel value.
+    unsigned char max;               ///< The largest pixel value.
+    unsigned long long sum;          ///< The sum of all pixel values.
+    unsigned long long sumOfSquares; ///< The sum of all squared pixel values.
+    unsigned long long nonZero;      ///< The number of pixels that are not 0.
+    unsigned long long count;        ///< The number of pixels.
+
+public:
+    /**
+     * @brief Default constructor.
+     *
+     * Initializes the statistics of an empty image.
+     */
+    ImageStatistics();
+
+    /**
+     * @brief Get the smallest pixel value.
+     *
+     * @return The minimum, or 0 for an empty image.
+     */
+    unsigned char getMin() const;
+
+    /**
+     * @brief Get the largest pixel value.
+     *
+     * @return The maximum, or 0 for an empty image.
+     */
+    unsigned char getMax() const;
+
+    /**
+     * @brief Get the sum of all pixel values.
+     *
+     * @return The sum.
+     */
+    unsigned long long getSum() const;
+
+    /**
+     * @brief Get the sum of all squared pixel values.
+     *
+     * @return The sum of squares.
+     */
+    unsigned long long getSumOfSquares() const;
+
+    /**
+     * @brief Get the number of pixels that are not 0.
+     *
+     * @return The number of non-zero pixels.
+     */
+    unsigned long long getNonZero() const;
+
+    /**
+     * @brief Get the number of pixels.
+     *
+     * @return The number of pixels.
+     */
+    unsigned long long getCount() const;
+
+    /**
+     * @brief Returns the mean pixel value.
+     *
+     * @return The mean, or 0 for an empty image.
+     */
+    double mean() const;
+
+    /**
+     * @brief Returns the variance of the pixel values.
+     *
+     * @return The population variance, or 0 for an empty image.
+     */
+    double variance() const;
+
+    /**
+     * @brief Returns the standard deviation of the pixel values.
+     *
+     * @return The population standard deviation, or 0 for an empty image.
+     */
+    double standardDeviation() const;
+
+    /**
+     * @brief Computes the statistics of an image given by its rows.
+     *
+     * @param rows The row pointers of the image.
+     * @param width The width of the image.
+     * @param height The height of the image.
+     * @return The statistics.
+     */
+    static ImageStatistics compute(unsigned char *const *rows, unsigned int width, unsigned int height);
+};
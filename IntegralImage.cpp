@@ -0,0 +1,241 @@
+#include <algorithm>
+#include "IntegralImage.h"
+#include "Parallel.h"
+
+/**
+ * Fills the summed-area tables of the pixels and of their squares, of (width + 1) x (height + 1)
+ * entries whose first row and column are zero, in one pass over the rows.
+ *
+ * @param img The source image.
+ * @param sums The table of sums.
+ * @param squares The table of squared sums.
+ */
+template <typename S, typename Q>
+static void buildTables(const Image &img, std::vector<S> &sums, std::vector<Q> &squares)
+{
+    unsigned int width = img.getWidth();
+    unsigned int height = img.getHeight();
+    size_t stride = static_cast<size_t>(width) + 1;
+    sums.assign(stride * (height + 1), 0);
+    squares.assign(stride * (height + 1), 0);
+    for (unsigned int i = 0; i < height; ++i)
+    {
+        const unsigned char *in = img.getData()[i];
+        const S *sumsAbove = &sums[i * stride];
+        const Q *squaresAbove = &squares[i * stride];
+        S *sumsOut = &sums[(i + 1) * stride];
+        Q *squaresOut = &squares[(i + 1) * stride];
+        S rowSum = 0;
+        Q rowSquares = 0;
+        for (unsigned int j = 0; j < width; ++j)
+        {
+            rowSum += in[j];
+            rowSquares += static_cast<Q>(in[j]) * in[j];
+            sumsOut[j + 1] = sumsAbove[j + 1] + rowSum;
+            squaresOut[j + 1] = squaresAbove[j + 1] + rowSquares;
+        }
+    }
+}
+
+/**
+ * Reads the total of the clipped region [x0, x1) x [y0, y1) from the four corners of a table.
+ */
+template <typename T>
+static inline unsigned long long regionTotal(const std::vector<T> &table, size_t stride,
+                                             unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1)
+{
+    return static_cast<unsigned long long>(static_cast<T>(table[y1 * stride + x1] - table[y0 * stride + x1] -
+                                                          table[y1 * stride + x0] + table[y0 * stride + x0]));
+}
+
+/**
+ * @brief Default constructor for the IntegralImage class.
+ * Initializes the tables of an empty image.
+ */
+IntegralImage::IntegralImage() : width{0}, height{0} {}
+
+/**
+ * @brief Constructs the tables of an image.
+ *
+ * @param img The source image.
+ */
+IntegralImage::IntegralImage(const Image &img) : width{0}, height{0}
+{
+    compute(img);
+}
+
+/**
+ * Builds the tables of an image in one pass over its rows.
+ *
+ * The sums fit in 32 bits as long as width * height * 255 does, and the squared sums as long as
+ * width * height * 255 * 255 does; larger images switch to 64-bit tables.
+ *
+ * @param img The source image.
+ */
+void IntegralImage::compute(const Image &img)
+{
+    this->width = img.getWidth();
+    this->height = img.getHeight();
+    unsigned long long area = static_cast<unsigned long long>(this->width) * this->height;
+
+    this->sums32.clear();
+    this->sums64.clear();
+    this->squares32.clear();
+    this->squares64.clear();
+    if (area * 255 * 255 <= 0xFFFFFFFFull)
+        buildTables(img, this->sums32, this->squares32);
+    else if (area * 255 <= 0xFFFFFFFFull)
+        buildTables(img, this->sums32, this->squares64);
+    else
+        buildTables(img, this->sums64, this->squares64);
+}
+
+/**
+ * @brief Returns the size of the source image.
+ *
+ * @return The size of the source image.
+ */
+Size IntegralImage::size() const
+{
+    return Size(this->width, this->height);
+}
+
+/**
+ * @brief Clips a region to the image.
+ *
+ * @param region The region.
+ * @param x0 The first column of the clipped region.
+ * @param y0 The first row of the clipped region.
+ * @param x1 One past the last column of the clipped region.
+ * @param y1 One past the last row of the clipped region.
+ * @return False if the clipped region is empty.
+ */
+bool IntegralImage::clip(const Rectangle &region, unsigned int &x0, unsigned int &y0, unsigned int &x1, unsigned int &y1) const
+{
+    long long left = std::max(region.getX(), 0);
+    long long top = std::max(region.getY(), 0);
+    long long right = std::min<long long>(static_cast<long long>(region.getX()) + region.getWidth(), this->width);
+    long long bottom = std::min<long long>(static_cast<long long>(region.getY()) + region.getHeight(), this->height);
+    if (right <= left || bottom <= top)
+        return false;
+    x0 = static_cast<unsigned int>(left);
+    y0 = static_cast<unsigned int>(top);
+    x1 = static_cast<unsigned int>(right);
+    y1 = static_cast<unsigned int>(bottom);
+    return true;
+}
+
+/**
+ * @brief Computes the sum, the squared sum and the area of a region.
+ *
+ * @param region The region.
+ * @param sum The sum of the pixels.
+ * @param squaredSum The sum of the squared pixels.
+ * @return The number of pixels of the clipped region.
+ */
+unsigned long long IntegralImage::moments(const Rectangle &region, unsigned long long &sum, unsigned long long &squaredSum) const
+{
+    unsigned int x0, y0, x1, y1;
+    sum = squaredSum = 0;
+    if (!clip(region, x0, y0, x1, y1))
+        return 0;
+    size_t stride = static_cast<size_t>(this->width) + 1;
+    sum = this->sums64.empty() ? regionTotal(this->sums32, stride, x0, y0, x1, y1)
+                               : regionTotal(this->sums64, stride, x0, y0, x1, y1);
+    squaredSum = this->squares64.empty() ? regionTotal(this->squares32, stride, x0, y0, x1, y1)
+                                         : regionTotal(this->squares64, stride, x0, y0, x1, y1);
+    return static_cast<unsigned long long>(x1 - x0) * (y1 - y0);
+}
+
+/**
+ * @brief Returns the sum of the pixels of a region.
+ *
+ * @param region The region, with (x, y) its top-left pixel. It is clipped to the image.
+ * @return The sum of the pixels.
+ */
+unsigned long long IntegralImage::sum(Rectangle region) const
+{
+    unsigned int x0, y0, x1, y1;
+    if (!clip(region, x0, y0, x1, y1))
+        return 0;
+    size_t stride = static_cast<size_t>(this->width) + 1;
+    return this->sums64.empty() ? regionTotal(this->sums32, stride, x0, y0, x1, y1)
+                                : regionTotal(this->sums64, stride, x0, y0, x1, y1);
+}
+
+/**
+ * @brief Returns the sum of the squared pixels of a region.
+ *
+ * @param region The region, with (x, y) its top-left pixel. It is clipped to the image.
+ * @return The sum of the squared pixels.
+ */
+unsigned long long IntegralImage::squaredSum(Rectangle region) const
+{
+    unsigned int x0, y0, x1, y1;
+    if (!clip(region, x0, y0, x1, y1))
+        return 0;
+    size_t stride = static_cast<size_t>(this->width) + 1;
+    return this->squares64.empty() ? regionTotal(this->squares32, stride, x0, y0, x1, y1)
+                                   : regionTotal(this->squares64, stride, x0, y0, x1, y1);
+}
+
+/**
+ * @brief Returns the mean of the pixels of a region.
+ *
+ * @param region The region, with (x, y) its top-left pixel. It is clipped to the image.
+ * @return The mean, or 0 for an empty region.
+ */
+double IntegralImage::mean(Rectangle region) const
+{
+    unsigned long long total, squares;
+    unsigned long long area = moments(region, total, squares);
+    return area > 0 ? static_cast<double>(total) / area : 0.0;
+}
+
+/**
+ * @brief Returns the variance of the pixels of a region.
+ *
+ * @param region The region, with (x, y) its top-left pixel. It is clipped to the image.
+ * @return The population variance, or 0 for an empty region.
+ */
+double IntegralImage::variance(Rectangle region) const
+{
+    unsigned long long total, squares;
+    unsigned long long area = moments(region, total, squares);
+    if (area == 0)
+        return 0.0;
+    double m = static_cast<double>(total) / area;
+    double v = static_cast<double>(squares) / area - m * m;
+    return v > 0 ? v : 0.0;
+}
+
+/**
+ * Computes the mean and the variance of many regions, spreading large batches over threads.
+ *
+ * @param regions The regions.
+ * @param means The mean of every region.
+ * @param variances The variance of every region.
+ */
+void IntegralImage::query(const std::vector<Rectangle> &regions, std::vector<double> &means, std::vector<double> &variances) const
+{
+    means.resize(regions.size());
+    variances.resize(regions.size());
+    Parallel::forRows(0, static_cast<unsigned int>(regions.size()), [&](unsigned int first, unsigned int last)
+                      {
+                          for (unsigned int k = first; k < last; ++k)
+                          {
+                              unsigned long long total, squares;
+                              unsigned long long area = moments(regions[k], total, squares);
+                              if (area == 0)
+                              {
+                                  means[k] = variances[k] = 0.0;
+                                  continue;
+                              }
+                              double m = static_cast<double>(total) / area;
+                              double v = static_cast<double>(squares) / area - m * m;
+                              means[k] = m;
+                              variances[k] = v > 0 ? v : 0.0;
+                          }
+                      },
+                      4096);
+}
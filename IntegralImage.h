@@ -0,0 +1,118 @@
+#pragma once
+#include <vector>
+#include "Image.h"
+
+/**
+ * @class IntegralImage
+ * @brief Represents the summed-area tables of an image.
+ *
+ * The tables hold, for every pixel, the sum and the sum of squares of all pixels above and to
+ * the left of it. Once built in a single pass, the sum, mean and variance of any rectangular
+ * region can be read in constant time from the four corners of the region.
+ *
+ * The tables use 32-bit entries when the totals of the image are guaranteed to fit, and 64-bit
+ * entries otherwise, so small images stay compact.
+ */
+class IntegralImage
+{
+private:
+    unsigned int width;                        ///< The width of the source image.
+    unsigned int height;                       ///< The height of the source image.
+    std::vector<unsigned int> sums32;          ///< The table of sums, when 32 bits are enough.
+    std::vector<unsigned long long> sums64;    ///< The table of sums, when 64 bits are needed.
+    std::vector<unsigned int> squares32;       ///< The table of squared sums, when 32 bits are enough.
+    std::vector<unsigned long long> squares64; ///< The table of squared sums, when 64 bits are needed.
+
+public:
+    /**
+     * @brief Default constructor.
+     *
+     * Initializes the tables of an empty image.
+     */
+    IntegralImage();
+
+    /**
+     * @brief Constructs the tables of an image.
+     *
+     * @param img The source image.
+     */
+    IntegralImage(const Image &img);
+
+    /**
+     * @brief Builds the tables of an image, replacing the current ones.
+     *
+     * @param img The source image.
+     */
+    void compute(const Image &img);
+
+    /**
+     * @brief Returns the size of the source image.
+     *
+     * @return The size of the source image.
+     */
+    Size size() const;
+
+    /**
+     * @brief Returns the sum of the pixels of a region.
+     *
+     * @param region The region, with (x, y) its top-left pixel. It is clipped to the image.
+     * @return The sum of the pixels.
+     */
+    unsigned long long sum(Rectangle region) const;
+
+    /**
+     * @brief Returns the sum of the squared pixels of a region.
+     *
+     * @param region The region, with (x, y) its top-left pixel. It is clipped to the image.
+     * @return The sum of the squared pixels.
+     */
+    unsigned long long squaredSum(Rectangle region) const;
+
+    /**
+     * @brief Returns the mean of the pixels of a region.
+     *
+     * @param region The region, with (x, y) its top-left pixel. It is clipped to the image.
+     * @return The mean, or 0 for an empty region.
+     */
+    double mean(Rectangle region) const;
+
+    /**
+     * @brief Returns the variance of the pixels of a region.
+     *
+     * @param region The region, with (x, y) its top-left pixel. It is clipped to the image.
+     * @return The population variance, or 0 for an empty region.
+     */
+    double variance(Rectangle region) const;
+
+    /**
+     * @brief Computes the mean and the variance of many regions.
+     *
+     * @param regions The regions.
+     * @param means The mean of every region.
+     * @param variances The variance of every region.
+     */
+    void query(const std::vector<Rectangle> &regions, std::vector<double> &means, std::vector<double> &variances) const;
+
+private:
+    /**
+     * @brief Clips a region to the image.
+     *
+     * @param region The region.
+     * @param x0 The first column of the clipped region.
+     * @param y0 The first row of the clipped region.
+     * @param x1 One past the last column of the clipped region.
+     * @param y1 One past the last row of the clipped region.
+     * @return False if the clipped region is empty.
+     */
+    bool clip(const Rectangle &region, unsigned int &x0, unsigned int &y0, unsigned int &x1, unsigned int &y1) const;
+
+    /**
+     * @brief Computes the sum, the squared sum and the area of a region.
+     *
+     * @param region The region.
+     * @param sum The sum of the pixels.
+     * @param squaredSum The sum of the squared pixels.
+     * @return The number of pixels of the clipped region.
+     */
+    unsigned long long moments(const Rectangle &region, unsigned long long &sum, unsigned long long &squaredSum) const;
+};
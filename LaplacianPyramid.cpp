@@ -0,0 +1,183 @@
+#include <algorithm>
+#include "LaplacianPyramid.h"
+#include "Parallel.h"
+
+/**
+ * Upsamples a level by two with the (1 4 6 4 1) kernel and combines it with a base level.
+ *
+ * Even output samples use the weights (1 6 1) / 8 and odd samples (4 4) / 8 in each direction,
+ * which is the 5-tap kernel applied to the zero-stuffed level. The result is
+ * out = base + sign * expand(src). Borders are replicated.
+ *
+ * @param src The values of the level to expand.
+ * @param srcSize The size of the level to expand.
+ * @param base The values of the base level.
+ * @param out The combined values, with the size of the base level.
+ * @param outSize The size of the base level.
+ * @param sign +1 to add the expansion to the base level, -1 to subtract it.
+ */
+template <typename Source, typename Base>
+static void expandAndCombine(const Source *src, Size srcSize, const Base *base, short *out, Size outSize, int sign)
+{
+    int srcWidth = srcSize.getWidth();
+    int srcHeight = srcSize.getHeight();
+    int outWidth = outSize.getWidth();
+    Parallel::forRows(0, outSize.getHeight(), [&](unsigned int first, unsigned int last)
+                      {
+                          std::vector<int> column(srcWidth);
+                          for (unsigned int y = first; y < last; ++y)
+                          {
+                              int k = y / 2;
+                              const Source *r0 = src + static_cast<size_t>(std::max(k - 1, 0)) * srcWidth;
+                              const Source *r1 = src + static_cast<size_t>(k) * srcWidth;
+                              const Source *r2 = src + static_cast<size_t>(std::min(k + 1, srcHeight - 1)) * srcWidth;
+                              if (y % 2 == 0)
+                                  for (int x = 0; x < srcWidth; ++x)
+                                      column[x] = r0[x] + 6 * r1[x] + r2[x];
+                              else
+                                  for (int x = 0; x < srcWidth; ++x)
+                                      column[x] = 4 * (r1[x] + r2[x]);
+
+                              const Base *in = base + static_cast<size_t>(y) * outWidth;
+                              short *o = out + static_cast<size_t>(y) * outWidth;
+                              for (int x = 0; x < outWidth; ++x)
+                              {
+                                  int c = x / 2;
+                                  int next = std::min(c + 1, srcWidth - 1);
+                                  int sum;
+                                  if (x % 2 == 0)
+                                      sum = column[std::max(c - 1, 0)] + 6 * column[c] + column[next];
+                                  else
+                                      sum = 4 * (column[c] + column[next]);
+                                  int expanded = (sum + 32) >> 6;
+                                  o[x] = static_cast<short>(in[x] + sign * expanded);
+                              }
+                          }
+                      });
+}
+
+/**
+ * @brief Default constructor for the LaplacianPyramid class.
+ * Initializes a pyramid with 4 levels.
+ */
+LaplacianPyramid::LaplacianPyramid() : gaussian{4} {}
+
+/**
+ * @brief Constructs a pyramid with the specified number of levels.
+ *
+ * @param levels The number of levels, including the full-resolution level 0.
+ */
+LaplacianPyramid::LaplacianPyramid(unsigned int levels) : gaussian{levels} {}
+
+/**
+ * Builds the pyramid of the source image.
+ *
+ * @param src The source image.
+ */
+void LaplacianPyramid::build(const Image &src)
+{
+    this->gaussian.build(src);
+    unsigned int levels = this->gaussian.getLevels();
+
+    size_t total = 0;
+    this->offsets.resize(levels);
+    for (unsigned int level = 0; level < levels; ++level)
+    {
+        Size size = this->gaussian.getLevelSize(level);
+        this->offsets[level] = total;
+        total += static_cast<size_t>(size.getWidth()) * size.getHeight();
+    }
+    if (this->buffer.size() != total)
+        this->buffer.resize(total);
+
+    for (unsigned int level = 0; level + 1 < levels; ++level)
+        expandAndCombine(this->gaussian.levelRow(level + 1, 0), this->gaussian.getLevelSize(level + 1),
+                         this->gaussian.levelRow(level, 0), levelRow(level, 0), this->gaussian.getLevelSize(level), -1);
+
+    Size top = this->gaussian.getLevelSize(levels - 1);
+    const unsigned char *in = this->gaussian.levelRow(levels - 1, 0);
+    std::copy(in, in + static_cast<size_t>(top.getWidth()) * top.getHeight(), levelRow(levels - 1, 0));
+}
+
+/**
+ * @brief Get the number of levels of the last built pyramid.
+ *
+ * @return The number of levels, or 0 if the pyramid was never built.
+ */
+unsigned int LaplacianPyramid::getLevels() const
+{
+    return static_cast<unsigned int>(this->offsets.size());
+}
+
+/**
+ * @brief Get the size of a level.
+ *
+ * @param level The index of the level.
+ * @return The size of the level.
+ */
+Size LaplacianPyramid::getLevelSize(unsigned int level) const
+{
+    return this->gaussian.getLevelSize(level);
+}
+
+/**
+ * @brief Returns a pointer to a row of a level.
+ *
+ * @param level The index of the level.
+ * @param y The index of the row.
+ * @return Pointer to the values of the row.
+ */
+short *LaplacianPyramid::levelRow(unsigned int level, unsigned int y)
+{
+    return &this->buffer[this->offsets.at(level) + static_cast<size_t>(y) * getLevelSize(level).getWidth()];
+}
+
+/**
+ * @brief Returns a pointer to a row of a level.
+ *
+ * @param level The index of the level.
+ * @param y The index of the row.
+ * @return Pointer to the values of the row.
+ */
+const short *LaplacianPyramid::levelRow(unsigned int level, unsigned int y) const
+{
+    return &this->buffer[this->offsets.at(level) + static_cast<size_t>(y) * getLevelSize(level).getWidth()];
+}
+
+/**
+ * Rebuilds the full-resolution image by expanding each level and adding the next finer one.
+ *
+ * @param dst The reconstructed image.
+ */
+void LaplacianPyramid::reconstruct(Image &dst) const
+{
+    unsigned int levels = getLevels();
+    if (levels == 0)
+    {
+        dst = Image();
+        return;
+    }
+
+    // Two scratch buffers large enough for level 0, alternating between levels.
+    Size base = getLevelSize(0);
+    size_t area = static_cast<size_t>(base.getWidth()) * base.getHeight();
+    std::vector<short> current(levelRow(levels - 1, 0), levelRow(levels - 1, 0) +
+                                   static_cast<size_t>(getLevelSize(levels - 1).getWidth()) * getLevelSize(levels - 1).getHeight());
+    current.resize(area);
+    std::vector<short> next(area);
+    for (unsigned int level = levels - 1; level > 0; --level)
+    {
+        expandAndCombine(current.data(), getLevelSize(level), levelRow(level - 1, 0), next.data(), getLevelSize(level - 1), 1);
+        current.swap(next);
+    }
+
+    Image output(base.getWidth(), base.getHeight());
+    for (unsigned int i = 0; i < base.getHeight(); ++i)
+    {
+        const short *in = &current[static_cast<size_t>(i) * base.getWidth()];
+        unsigned char *out = output.row(i);
+        for (unsigned int j = 0; j < base.getWidth(); ++j)
+            out[j] = static_cast<unsigned char>(std::min(std::max(static_cast<int>(in[j]), 0), 255));
+    }
+    dst = output;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <vector>
+#include "Pyramid.h"
+
+/**
+ * @class LaplacianPyramid
+ * @brief Represents a Laplacian image pyramid.
+ *
+ * Level i stores the difference between level i of the Gaussian pyramid and the expansion of
+ * Gaussian level i + 1; the last level stores the coarsest Gaussian level itself. The differences
+ * are signed, so the levels are kept as 16-bit values in one contiguous buffer that is reused
+ * across builds of images with the same size. The reconstruction is exact.
+ */
+class LaplacianPyramid
+{
+private:
+    Pyramid gaussian;            ///< The Gaussian pyramid the levels are derived from.
+    std::vector<short> buffer;   ///< The values of every level, stored one level after another.
+    std::vector<size_t> offsets; ///< The offset of every level in the buffer.
+
+public:
+    /**
+     * @brief Default constructor.
+     *
+     * Initializes a pyramid with 4 levels.
+     */
+    LaplacianPyramid();
+
+    /**
+     * @brief Constructs a pyramid with the specified number of levels.
+     *
+     * @param levels The number of levels, including the full-resolution level 0.
+     */
+    LaplacianPyramid(unsigned int levels);
+
+    /**
+     * @brief Builds the pyramid of the source image.
+     *
+     * @param src The source image.
+     */
+    void build(const Image &src);
+
+    /**
+     * @brief Get the number of levels of the last built pyramid.
+     *
+     * @return The number of levels.
+     */
+    unsigned int getLevels() const;
+
+    /**
+     * @brief Get the size of a level.
+     *
+     * @param level The index of the level.
+     * @return The size of the level.
+     */
+    Size getLevelSize(unsigned int level) const;
+
+    /**
+     * @brief Returns a pointer to a row of a level.
+     *
+     * @param level The index of the level.
+     * @param y The index of the row.
+     * @return Pointer to the values of the row.
+     */
+    short *levelRow(unsigned int level, unsigned int y);
+
+    /**
+     * @brief Returns a pointer to a row of a level.
+     *
+     * @param level The index of the level.
+     * @param y The index of the row.
+     * @return Pointer to the values of the row.
+     */
+    const short *levelRow(unsigned int level, unsigned int y) const;
+
+    /**
+     * @brief Rebuilds the full-resolution image from the levels.
+     *
+     * The levels may have been edited (for example for blending or detail enhancement);
+     * the result is clamped to the 0-255 range.
+     *
+     * @param dst The reconstructed image.
+     */
+    void reconstruct(Image &dst) const;
+};
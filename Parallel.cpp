@@ -0,0 +1,559 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+#include "ImageMetrics.h"
+#include "Parallel.h"
+#include "Trace.h"
+
+unsigned int Parallel::threadCount = 0;
+unsigned int Parallel::grainSize = 0;
+std::vector<unsigned int> Parallel::cpus;
+
+namespace
+{
+const size_t MAX_TASKS = 256; ///< The most halves a job splits off; beyond, the chunks get larger.
+
+struct Job;
+
+/**
+ * A range of rows of a job, waiting in a deque.
+ */
+struct Task
+{
+    Job *job;           ///< The job the rows belong to.
+    unsigned int first; ///< The first row.
+    unsigned int last;  ///< One past the last row.
+};
+
+/**
+ * One call to forRows(): the body, the rows still to process and the storage of its tasks.
+ */
+struct Job
+{
+    const FunctionRef<void(unsigned int, unsigned int)> *body; ///< The body of the call.
+    unsigned int grain;                                        ///< The rows below which ranges are not split.
+    const char *site;                                          ///< The metrics site of the calling thread.
+    std::atomic<unsigned int> remaining;                       ///< The rows not processed yet.
+    Task tasks[MAX_TASKS];                                     ///< The storage of the split-off halves, on the stack of the caller.
+    size_t taskCount;                                          ///< The number of tasks the job may split off.
+    std::atomic<size_t> used;                                  ///< The number of tasks handed out.
+    std::mutex errorMutex;                                     ///< Guards error.
+    std::exception_ptr error;                                  ///< The first exception thrown by the body.
+};
+
+/**
+ * A fixed-size Chase-Lev deque of tasks.
+ *
+ * Its owner pushes and pops at the bottom, and other threads steal from the top, so the owner
+ * works depth first on its latest, smallest ranges while thieves take the oldest, largest ones.
+ * Only a steal racing for the last task needs a compare-and-swap. The orderings follow Lê et al.,
+ * "Correct and efficient work-stealing for weak memory models" (PPoPP 2013), with the
+ * sequentially consistent fences folded into the accesses to top and bottom around them.
+ */
+class Deque
+{
+public:
+    static const long long capacity = 1024; ///< The maximum number of tasks, a power of two.
+
+    Deque() : top{0}, bottom{0}
+    {
+        for (std::atomic<Task *> &slot : this->slots)
+            slot.store(nullptr, std::memory_order_relaxed);
+    }
+
+    /**
+     * Pushes a task at the bottom; only called by the owner.
+     *
+     * @return False if the deque is full.
+     */
+    bool push(Task *task)
+    {
+        long long b = this->bottom.load(std::memory_order_relaxed);
+        long long t = this->top.load(std::memory_order_acquire);
+        if (b - t >= capacity)
+            return false;
+        this->slots[b & (capacity - 1)].store(task, std::memory_order_relaxed);
+        this->bottom.store(b + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Pops the task at the bottom; only called by the owner.
+     *
+     * @return The task, or nullptr if the deque is empty.
+     */
+    Task *pop()
+    {
+        long long b = this->bottom.load(std::memory_order_relaxed) - 1;
+        this->bottom.store(b, std::memory_order_seq_cst);
+        long long t = this->top.load(std::memory_order_seq_cst);
+        if (t > b)
+        {
+            this->bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        Task *task = this->slots[b & (capacity - 1)].load(std::memory_order_relaxed);
+        if (t == b)
+        {
+            if (!this->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                task = nullptr;
+            this->bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+
+    /**
+     * Steals the task at the top; called by any thread.
+     *
+     * @return The task, or nullptr if the deque is empty or the race for the task was lost.
+     */
+    Task *steal()
+    {
+        long long t = this->top.load(std::memory_order_seq_cst);
+        long long b = this->bottom.load(std::memory_order_seq_cst);
+        if (t >= b)
+            return nullptr;
+        Task *task = this->slots[t & (capacity - 1)].load(std::memory_order_relaxed);
+        if (!this->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return task;
+    }
+
+private:
+    std::atomic<long long> top;          ///< The index of the oldest task.
+    std::atomic<long long> bottom;       ///< One past the index of the newest task.
+    std::atomic<Task *> slots[capacity]; ///< The tasks, at their index modulo the capacity.
+};
+
+/**
+ * The library-wide pool of worker threads.
+ *
+ * Every thread taking part, worker or caller of forRows(), owns one of a fixed set of deques for
+ * as long as it lives. Deques are never freed, so a thief may always read the deque of a thread
+ * that just exited.
+ */
+class Scheduler
+{
+public:
+    /**
+     * Returns the pool, created on first use and never destroyed, so that worker threads blocked
+     * at exit do not outlive it.
+     */
+    static Scheduler &instance()
+    {
+        static Scheduler *scheduler = new Scheduler();
+        return *scheduler;
+    }
+
+    /**
+     * Starts the workers if they are not running.
+     */
+    void ensureStarted(unsigned int workerCount, const std::vector<unsigned int> &cpus)
+    {
+        if (this->running.load(std::memory_order_acquire))
+            return;
+        std::lock_guard<std::mutex> lock(this->configMutex);
+        if (this->running.load(std::memory_order_relaxed))
+            return;
+        this->stopping.store(false);
+        for (unsigned int k = 0; k < workerCount; ++k)
+            this->workers.emplace_back([this, k, cpus]()
+                                       { work(k, cpus); });
+        this->running.store(true, std::memory_order_release);
+    }
+
+    /**
+     * Stops and joins the workers; they are started again by the next parallel call.
+     */
+    void stop()
+    {
+        std::lock_guard<std::mutex> lock(this->configMutex);
+        if (!this->running.load(std::memory_order_relaxed))
+            return;
+        {
+            std::lock_guard<std::mutex> sleepLock(this->sleepMutex);
+            this->stopping.store(true);
+        }
+        this->wake.notify_all();
+        for (std::thread &worker : this->workers)
+            worker.join();
+        this->workers.clear();
+        this->running.store(false, std::memory_order_release);
+    }
+
+    /**
+     * Returns the index of the deque of the calling thread, acquiring one on first use, or -1 if
+     * every deque is taken.
+     */
+    int localDeque()
+    {
+        struct Slot
+        {
+            int index = -1;
+            ~Slot()
+            {
+                if (this->index >= 0)
+                    Scheduler::instance().owned[this->index].store(false, std::memory_order_release);
+            }
+        };
+        thread_local Slot slot;
+        if (slot.index < 0)
+            slot.index = acquireDeque();
+        return slot.index;
+    }
+
+    /**
+     * Runs a job from the calling thread, which owns the deque self, working on it and helping
+     * with any other work until all its rows are processed.
+     */
+    void run(Job &job, unsigned int first, unsigned int last, int self)
+    {
+        Deque &deque = *this->deques[self].load(std::memory_order_acquire);
+        Task root{&job, first, last};
+        execute(deque, root);
+        while (job.remaining.load(std::memory_order_acquire) > 0)
+        {
+            Task *task = deque.pop();
+            if (task == nullptr)
+                task = steal(self);
+            if (task != nullptr)
+                execute(deque, *task);
+            else
+                std::this_thread::yield();
+        }
+    }
+
+private:
+    static const int maxDeques = 256; ///< The maximum number of threads taking part at once.
+
+    std::atomic<Deque *> deques[maxDeques]; ///< The deques, allocated on first use.
+    std::atomic<bool> owned[maxDeques];     ///< Whether a live thread owns every deque.
+    std::atomic<int> dequeCount;            ///< One past the highest deque ever used.
+    std::vector<std::thread> workers;       ///< The worker threads.
+    std::atomic<bool> running;              ///< Whether the workers are started.
+    std::atomic<bool> stopping;             ///< Asks the workers to exit.
+    std::mutex configMutex;                 ///< Serializes starting and stopping.
+    std::atomic<unsigned long long> epoch;  ///< Bumped whenever work is pushed.
+    std::atomic<unsigned int> sleepers;     ///< The number of workers about to sleep or sleeping.
+    std::mutex sleepMutex;                  ///< Guards sleeping.
+    std::condition_variable wake;           ///< Wakes sleeping workers.
+
+    Scheduler() : dequeCount{0}, running{false}, stopping{false}, epoch{0}, sleepers{0}
+    {
+        for (int k = 0; k < maxDeques; ++k)
+        {
+            this->deques[k].store(nullptr, std::memory_order_relaxed);
+            this->owned[k].store(false, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Takes a free deque, allocating it if it was never used.
+     */
+    int acquireDeque()
+    {
+        for (int k = 0; k < maxDeques; ++k)
+        {
+            bool expected = false;
+            if (!this->owned[k].compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+                continue;
+            if (this->deques[k].load(std::memory_order_acquire) == nullptr)
+                this->deques[k].store(new Deque(), std::memory_order_release);
+            int count = this->dequeCount.load();
+            while (count < k + 1 && !this->dequeCount.compare_exchange_weak(count, k + 1))
+                ;
+            return k;
+        }
+        return -1;
+    }
+
+    /**
+     * Tries to steal a task from the deques of the other threads, starting after self.
+     */
+    Task *steal(int self)
+    {
+        int count = this->dequeCount.load(std::memory_order_acquire);
+        for (int k = 1; k < count; ++k)
+        {
+            Deque *victim = this->deques[(self + k) % count].load(std::memory_order_acquire);
+            if (victim == nullptr)
+                continue;
+            Task *task = victim->steal();
+            if (task != nullptr)
+                return task;
+        }
+        return nullptr;
+    }
+
+    /**
+     * Wakes the sleeping workers after work was pushed.
+     */
+    void notify()
+    {
+        this->epoch.fetch_add(1);
+        if (this->sleepers.load() > 0)
+        {
+            std::lock_guard<std::mutex> lock(this->sleepMutex);
+            this->wake.notify_all();
+        }
+    }
+
+    /**
+     * Processes a range: halves above the grain are pushed for other threads to steal, until
+     * the range kept is small enough to run the body on.
+     */
+    void execute(Deque &deque, Task task)
+    {
+        Job &job = *task.job;
+        unsigned int first = task.first;
+        unsigned int last = task.last;
+        while (last - first > job.grain)
+        {
+            size_t index = job.used.fetch_add(1, std::memory_order_relaxed);
+            if (index >= job.taskCount)
+                break;
+            unsigned int middle = first + (last - first) / 2;
+            job.tasks[index] = {&job, middle, last};
+            if (!deque.push(&job.tasks[index]))
+                break;
+            notify();
+            last = middle;
+        }
+        try
+        {
+            TRACE_SCOPE("Parallel::task", "pool");
+            ImageMetrics::Site site(job.site);
+            (*job.body)(first, last);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(job.errorMutex);
+            if (!job.error)
+                job.error = std::current_exception();
+        }
+        job.remaining.fetch_sub(last - first, std::memory_order_acq_rel);
+    }
+
+    /**
+     * The loop of worker k: run its own tasks, steal, and sleep when there is no work.
+     */
+    void work(unsigned int k, const std::vector<unsigned int> &cpus)
+    {
+#ifdef __linux__
+        if (!cpus.empty())
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpus[k % cpus.size()], &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
+#else
+        (void)k;
+        (void)cpus;
+#endif
+#ifdef IMAGE_PROCESSING_TRACE
+        Trace::setThreadName("worker " + std::to_string(k));
+#endif
+        int self = localDeque();
+        if (self < 0)
+            return;
+        Deque &deque = *this->deques[self].load(std::memory_order_acquire);
+        unsigned int idle = 0;
+        while (!this->stopping.load(std::memory_order_acquire))
+        {
+            Task *task = deque.pop();
+            if (task == nullptr)
+                task = steal(self);
+            if (task != nullptr)
+            {
+                execute(deque, *task);
+                idle = 0;
+                continue;
+            }
+            if (++idle < 64)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            // Work pushed after the epoch is read either is found by the last steal, or bumps
+            // the epoch and sees this worker among the sleepers.
+            unsigned long long seen = this->epoch.load();
+            this->sleepers.fetch_add(1);
+            task = steal(self);
+            if (task == nullptr)
+            {
+                std::unique_lock<std::mutex> lock(this->sleepMutex);
+                this->wake.wait(lock, [this, seen]()
+                                { return this->epoch.load() != seen || this->stopping.load(); });
+            }
+            this->sleepers.fetch_sub(1);
+            if (task != nullptr)
+                execute(deque, *task);
+            idle = 0;
+        }
+    }
+};
+} // namespace
+
+/**
+ * @brief Get the number of threads used by forRows().
+ *
+ * @return The configured thread count, or the number of hardware threads if none was set.
+ */
+unsigned int Parallel::getThreadCount()
+{
+    if (threadCount > 0)
+        return threadCount;
+    unsigned int hardware = std::thread::hardware_concurrency();
+    return hardware > 0 ? hardware : 1;
+}
+
+/**
+ * @brief Set the number of threads used by forRows(), the calling thread included.
+ *
+ * The workers are stopped, and started again with the new count by the next parallel call.
+ *
+ * @param count The new thread count. A value of 0 restores the hardware default.
+ */
+void Parallel::setThreadCount(unsigned int count)
+{
+    Scheduler::instance().stop();
+    threadCount = count;
+}
+
+/**
+ * @brief Get the CPUs the worker threads are pinned to.
+ *
+ * @return The CPUs, empty when the workers are not pinned.
+ */
+std::vector<unsigned int> Parallel::getAffinity()
+{
+    return cpus;
+}
+
+/**
+ * @brief Pins the worker threads to CPUs, worker k running on cpus[k % cpus.size()].
+ *
+ * The workers are stopped, and started again on their CPUs by the next parallel call.
+ *
+ * @param newCpus The CPUs, or an empty list to leave the workers unpinned.
+ */
+void Parallel::setAffinity(const std::vector<unsigned int> &newCpus)
+{
+    Scheduler::instance().stop();
+    cpus = newCpus;
+}
+
+/**
+ * @brief Get the number of rows below which ranges are not split any further.
+ *
+ * @return The grain size, 0 when it is chosen automatically.
+ */
+unsigned int Parallel::getGrainSize()
+{
+    return grainSize;
+}
+
+/**
+ * @brief Sets the number of rows below which ranges are not split any further.
+ *
+ * @param rows The grain size, or 0 to split every range into about four chunks per thread.
+ */
+void Parallel::setGrainSize(unsigned int rows)
+{
+    grainSize = rows;
+}
+
+/**
+ * @brief Runs the body over the row range [begin, end), split into contiguous chunks.
+ *
+ * The range is split in halves down to chunks of at most the grain size, but never below minRows
+ * rows, on the shared work-stealing pool; the calling thread takes part until every chunk is
+ * done. A range that fits in a single chunk runs on the calling thread directly. An exception
+ * thrown by the body is rethrown here once every chunk is done.
+ *
+ * The body is referenced rather than copied, and the split-off halves live in a fixed array on
+ * the stack, so a call allocates nothing.
+ *
+ * @param begin The first row of the range.
+ * @param end One past the last row of the range.
+ * @param body The function called with the [first, last) rows of each chunk.
+ * @param minRows The minimum number of rows per chunk.
+ */
+void Parallel::forRows(unsigned int begin, unsigned int end, FunctionRef<void(unsigned int first, unsigned int last)> body,
+                       unsigned int minRows)
+{
+    if (end <= begin)
+        return;
+    if (minRows == 0)
+        minRows = 1;
+
+    unsigned int rows = end - begin;
+    unsigned int threads = getThreadCount();
+    unsigned int grain = grainSize > 0 ? grainSize : (rows + 4 * threads - 1) / (4 * threads);
+    grain = std::max(grain, minRows);
+    if (threads <= 1 || rows <= grain)
+    {
+        body(begin, end);
+        return;
+    }
+
+    Scheduler &scheduler = Scheduler::instance();
+    scheduler.ensureStarted(threads - 1, cpus);
+    int self = scheduler.localDeque();
+    if (self < 0)
+    {
+        body(begin, end);
+        return;
+    }
+
+    Job job;
+    job.body = &body;
+    job.grain = grain;
+    job.site = ImageMetrics::currentSite();
+    job.remaining.store(rows);
+    job.taskCount = std::min(2 * static_cast<size_t>(rows / grain) + 2, MAX_TASKS);
+    job.used.store(0);
+    scheduler.run(job, begin, end, self);
+    if (job.error)
+        std::rethrow_exception(job.error);
+}
+
+/**
+ * @brief Runs the body over the tiles of a width x height area, the tiles being split across
+ * threads like the rows of forRows().
+ *
+ * @param width The width of the area.
+ * @param height The height of the area.
+ * @param tileWidth The width of the tiles; the last column of tiles may be narrower.
+ * @param tileHeight The height of the tiles; the last row of tiles may be shorter.
+ * @param body The function called with every tile.
+ */
+void Parallel::forTiles(unsigned int width, unsigned int height, unsigned int tileWidth, unsigned int tileHeight,
+                        FunctionRef<void(const Rectangle &tile)> body)
+{
+    if (width == 0 || height == 0 || tileWidth == 0 || tileHeight == 0)
+        return;
+    unsigned int columns = (width + tileWidth - 1) / tileWidth;
+    unsigned int tileRows = (height + tileHeight - 1) / tileHeight;
+    forRows(0, columns * tileRows, [&](unsigned int first, unsigned int last)
+            {
+                for (unsigned int index = first; index < last; ++index)
+                {
+                    unsigned int x = index % columns * tileWidth;
+                    unsigned int y = index / columns * tileHeight;
+                    body(Rectangle(static_cast<int>(x), static_cast<int>(y), std::min(tileWidth, width - x), std::min(tileHeight, height - y)));
+                }
+            },
+            1);
+}
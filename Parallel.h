@@ -0,0 +1,144 @@
+#pragma once
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "Rectangle.h"
+
+template <typename Signature>
+class FunctionRef;
+
+/**
+ * @class FunctionRef
+ * @brief A non-owning reference to a callable, for bodies that only live for the duration of a call.
+ *
+ * Unlike std::function it never copies the callable, so passing a lambda with any number of
+ * captures allocates nothing. The callable must outlive the reference, which holds for a
+ * temporary passed straight to a function taking one.
+ */
+template <typename R, typename... Args>
+class FunctionRef<R(Args...)>
+{
+private:
+    void *object;               ///< The referenced callable.
+    R (*call)(void *, Args...); ///< Calls the callable with its real type.
+
+    template <typename F>
+    static R invoke(void *object, Args... args)
+    {
+        return (*static_cast<F *>(object))(std::forward<Args>(args)...);
+    }
+
+public:
+    /**
+     * @brief References a callable.
+     *
+     * @param function The callable, which must outlive the reference.
+     */
+    template <typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, FunctionRef>::value>::type>
+    FunctionRef(F &&function)
+        : object{const_cast<void *>(static_cast<const void *>(std::addressof(function)))},
+          call{&invoke<typename std::remove_reference<F>::type>} {}
+
+    /**
+     * @brief Calls the referenced callable.
+     */
+    R operator()(Args... args) const { return call(this->object, std::forward<Args>(args)...); }
+};
+
+/**
+ * @class Parallel
+ * @brief Provides static helpers for splitting row-based image work across threads.
+ *
+ * Operators hand a range of rows to forRows(), which cuts it into contiguous chunks and runs
+ * the body once per chunk. Each chunk is processed by exactly one thread, so a body may write
+ * freely to the rows of its own chunk.
+ *
+ * The chunks run on one library-wide pool of worker threads with work stealing: every thread
+ * has its own deque of pending ranges, splits the range it works on in halves, pushing one half
+ * and keeping the other, and idle threads steal the largest pending ranges from the others
+ * without locking. The calling thread works on its own call too, and a body that calls forRows()
+ * again (a parallel batch of images, each running a parallel operator) pushes the nested work
+ * onto the same pool instead of starting threads of its own, so nested calls never
+ * oversubscribe the cores.
+ */
+class Parallel
+{
+public:
+    /**
+     * @brief Get the number of threads used by forRows().
+     *
+     * @return The thread count (defaults to the number of hardware threads).
+     */
+    static unsigned int getThreadCount();
+
+    /**
+     * @brief Set the number of threads used by forRows(), the calling thread included.
+     *
+     * The pool is restarted, so this must not be called while forRows() is running.
+     *
+     * @param count The new thread count. A value of 0 restores the hardware default.
+     */
+    static void setThreadCount(unsigned int count);
+
+    /**
+     * @brief Get the CPUs the worker threads are pinned to.
+     *
+     * @return The CPUs, empty when the workers are not pinned.
+     */
+    static std::vector<unsigned int> getAffinity();
+
+    /**
+     * @brief Pins the worker threads to CPUs, worker k running on cpus[k % cpus.size()].
+     *
+     * Only supported on Linux; elsewhere the workers are left unpinned. The pool is restarted, so
+     * this must not be called while forRows() is running.
+     *
+     * @param newCpus The CPUs, or an empty list to leave the workers unpinned.
+     */
+    static void setAffinity(const std::vector<unsigned int> &newCpus);
+
+    /**
+     * @brief Get the number of rows below which ranges are not split any further.
+     *
+     * @return The grain size, 0 when it is chosen automatically.
+     */
+    static unsigned int getGrainSize();
+
+    /**
+     * @brief Sets the number of rows below which ranges are not split any further.
+     *
+     * The minRows argument of forRows() still takes precedence when it is larger.
+     *
+     * @param rows The grain size, or 0 to split every range into about four chunks per thread.
+     */
+    static void setGrainSize(unsigned int rows);
+
+    /**
+     * @brief Runs the body over the row range [begin, end), split into contiguous chunks.
+     *
+     * @param begin The first row of the range.
+     * @param end One past the last row of the range.
+     * @param body The function called with the [first, last) rows of each chunk.
+     * @param minRows The minimum number of rows per chunk.
+     */
+    static void forRows(unsigned int begin, unsigned int end, FunctionRef<void(unsigned int first, unsigned int last)> body,
+                        unsigned int minRows = 16);
+
+    /**
+     * @brief Runs the body over the tiles of a width x height area.
+     *
+     * @param width The width of the area.
+     * @param height The height of the area.
+     * @param tileWidth The width of the tiles; the last column of tiles may be narrower.
+     * @param tileHeight The height of the tiles; the last row of tiles may be shorter.
+     * @param body The function called with every tile.
+     */
+    static void forTiles(unsigned int width, unsigned int height, unsigned int tileWidth, unsigned int tileHeight,
+                         FunctionRef<void(const Rectangle &tile)> body);
+
+private:
+    static unsigned int threadCount;       ///< The number of threads used by forRows(), 0 for the hardware default.
+    static unsigned int grainSize;         ///< The rows below which ranges are not split, 0 for automatic.
+    static std::vector<unsigned int> cpus; ///< The CPUs the workers are pinned to, empty for none.
+};
@@ -0,0 +1,407 @@
+#include <algorithm>
+#include "Pipeline.h"
+#include "Parallel.h"
+#include "ImageMetrics.h"
+#include "Trace.h"
+
+/**
+ * @brief Default constructor for the Pipeline class.
+ * Initializes a pipeline without stages, which copies its source, tiled for a 256 KB cache.
+ */
+Pipeline::Pipeline() : tiled{true}, tileBytes{256 * 1024} {}
+
+/**
+ * @brief Appends a stage.
+ *
+ * @param stage The stage, run after the ones already added.
+ */
+void Pipeline::add(ImageProcessing &stage)
+{
+    this->stages.push_back(&stage);
+    this->outputSizes.clear();
+}
+
+/**
+ * @brief Removes every stage and releases the scratch images.
+ */
+void Pipeline::clear()
+{
+    this->stages.clear();
+    this->buffers.clear();
+    this->outputSizes.clear();
+    this->strips.clear();
+    this->batches[0].clear();
+    this->batches[1].clear();
+}
+
+/**
+ * @brief Returns the number of stages.
+ *
+ * @return The number of stages.
+ */
+size_t Pipeline::size() const
+{
+    return this->stages.size();
+}
+
+/**
+ * @brief Returns the number of scratch images.
+ *
+ * @return The number of scratch images.
+ */
+size_t Pipeline::bufferCount() const
+{
+    return this->buffers.size();
+}
+
+/**
+ * @brief Returns whether row-wise pipelines run band by band.
+ *
+ * @return True for tiled execution.
+ */
+bool Pipeline::isTiled() const
+{
+    return this->tiled;
+}
+
+/**
+ * @brief Sets whether row-wise pipelines run band by band.
+ *
+ * @param newTiled True for tiled execution.
+ */
+void Pipeline::setTiled(bool newTiled)
+{
+    this->tiled = newTiled;
+}
+
+/**
+ * @brief Get the size the rows kept for one band should fit in.
+ *
+ * @return The size in bytes.
+ */
+size_t Pipeline::getTileBytes() const
+{
+    return this->tileBytes;
+}
+
+/**
+ * @brief Sets the size the rows kept for one band should fit in, typically the size of the L2 cache.
+ *
+ * @param newTileBytes The new size in bytes.
+ */
+void Pipeline::setTileBytes(size_t newTileBytes)
+{
+    this->tileBytes = newTileBytes;
+}
+
+/**
+ * Picks the scratch image a stage writes to, which is never the one it reads.
+ *
+ * A scratch image that already has the output size the stage had on the last image is taken
+ * first, so it keeps its buffers. When that size is known but no scratch image has it, a new
+ * one is added rather than resizing one another stage relies on; when the size is unknown, any
+ * other scratch image will do.
+ *
+ * @param exclude The scratch image the stage reads, or -1 for the source image.
+ * @param expected The output size of the stage on the last image, or nullptr when unknown.
+ * @return The index of the scratch image.
+ */
+int Pipeline::pickBuffer(int exclude, const Size *expected)
+{
+    int fallback = -1;
+    for (size_t k = 0; k < this->buffers.size(); ++k)
+    {
+        if (static_cast<int>(k) == exclude)
+            continue;
+        if (expected != nullptr && this->buffers[k].size() == *expected)
+            return static_cast<int>(k);
+        if (fallback < 0)
+            fallback = static_cast<int>(k);
+    }
+    if (expected == nullptr && fallback >= 0)
+        return fallback;
+    this->buffers.emplace_back();
+    return static_cast<int>(this->buffers.size()) - 1;
+}
+
+/**
+ * Runs every stage on the source image.
+ *
+ * The stages up to the last one that cannot run in place ping-pong between the scratch images,
+ * running in place on the current one when they can. That last stage writes into dst, and the
+ * stages after it run on dst in place. When the size of the source changes, the output sizes of
+ * the stages are forgotten and the scratch images beyond the first two are released.
+ *
+ * Row-wise pipelines run band by band instead when tiling is on.
+ *
+ * @param src The source image.
+ * @param dst The output of the last stage.
+ */
+void Pipeline::process(const Image &src, Image &dst)
+{
+    TRACE_SCOPE("Pipeline::process", "process");
+    ImageMetrics::Site site("Pipeline::process");
+    if (this->stages.empty())
+    {
+        dst = src;
+        return;
+    }
+    if (this->tiled && std::all_of(this->stages.begin(), this->stages.end(), [](const ImageProcessing *stage)
+                                   { return stage->supportsRows(); }))
+    {
+        processTiled(src, dst);
+        return;
+    }
+    bool known = this->outputSizes.size() == this->stages.size() && src.size() == this->inputSize;
+    if (!known)
+    {
+        if (this->buffers.size() > 2)
+            this->buffers.resize(2);
+        this->outputSizes.assign(this->stages.size(), Size());
+        this->inputSize = src.size();
+    }
+
+    size_t last = 0;
+    for (size_t k = 0; k < this->stages.size(); ++k)
+        if (!this->stages[k]->supportsInPlace())
+            last = k;
+
+    // The image the next stage reads: a scratch image, or -1 for src and -2 for dst.
+    int current = -1;
+    for (size_t k = 0; k < this->stages.size(); ++k)
+    {
+        ImageProcessing *stage = this->stages[k];
+        int target;
+        if (k >= last)
+            target = -2;
+        else if (current >= 0 && stage->supportsInPlace())
+            target = current;
+        else
+            target = pickBuffer(current, known ? &this->outputSizes[k] : nullptr);
+
+        const Image &input = current == -1 ? src : current == -2 ? dst : this->buffers[current];
+        Image &output = target == -2 ? dst : this->buffers[target];
+        stage->process(input, output);
+        this->outputSizes[k] = output.size();
+        current = target;
+    }
+}
+
+/**
+ * Runs every stage on a batch of images.
+ *
+ * Row-wise pipelines spread the images across the threads of the pool: every thread runs its run
+ * of images band by band through a pipeline of its own, whose ring buffers are allocated once
+ * for the run. The stages are shared, which is safe since processRows() already runs on several
+ * row bands at once.
+ *
+ * Other pipelines run stage by stage, every stage processing the whole batch with its own
+ * processBatch(). The batches ping-pong between two scratch batches the same way process() does
+ * with scratch images: in place when the stage can, the last stage that cannot run in place
+ * writing into dst and the stages after it running on dst in place.
+ *
+ * @param src The source images.
+ * @param dst The outputs of the last stage.
+ */
+void Pipeline::processBatch(const std::vector<Image> &src, std::vector<Image> &dst)
+{
+    TRACE_SCOPE("Pipeline::processBatch", "process");
+    ImageMetrics::Site site("Pipeline::processBatch");
+    if (this->stages.empty())
+    {
+        dst = src;
+        return;
+    }
+    if (this->tiled && std::all_of(this->stages.begin(), this->stages.end(), [](const ImageProcessing *stage)
+                                   { return stage->supportsRows(); }))
+    {
+        dst.resize(src.size());
+        Parallel::forRows(0, static_cast<unsigned int>(src.size()), [&](unsigned int first, unsigned int last)
+                          {
+                              Pipeline worker;
+                              worker.stages = this->stages;
+                              worker.tileBytes = this->tileBytes;
+                              for (unsigned int i = first; i < last; ++i)
+                                  worker.processTiled(src[i], dst[i]);
+                          },
+                          1);
+        return;
+    }
+
+    size_t last = 0;
+    for (size_t k = 0; k < this->stages.size(); ++k)
+        if (!this->stages[k]->supportsInPlace())
+            last = k;
+
+    // The batch the next stage reads: a scratch batch, or -1 for src and -2 for dst.
+    int current = -1;
+    for (size_t k = 0; k < this->stages.size(); ++k)
+    {
+        ImageProcessing *stage = this->stages[k];
+        int target;
+        if (k >= last)
+            target = -2;
+        else if (current >= 0 && stage->supportsInPlace())
+            target = current;
+        else
+            target = current == 0 ? 1 : 0;
+
+        const std::vector<Image> &input = current == -1 ? src : current == -2 ? dst : this->batches[current];
+        std::vector<Image> &output = target == -2 ? dst : this->batches[target];
+        stage->processBatch(input, output);
+        current = target;
+    }
+}
+
+/**
+ * Runs every stage band by band.
+ *
+ * Stage k keeps its rows in a ring buffer of band + 2 R rows, R being the sum of the
+ * neighborhoods of the stages after it, and row i lives in slot i modulo that size. For the
+ * output rows [y0, y1), stage k has to provide its rows up to y1 + R; the rows below the ones
+ * it computed for the previous band are still in its ring buffer, so it only computes the new
+ * ones. The band height is chosen so that the ring buffers, and one band of the source and of
+ * the output, fit in tileBytes.
+ *
+ * The output is cut into one strip per thread, as long as every strip gets at least a band, and
+ * the strips run in parallel with ring buffers of their own, kept from image to image. Every row
+ * of every stage is computed once, except the R rows above a strip, which the strip before it
+ * computes too.
+ *
+ * @param src The source image.
+ * @param dst The output of the last stage.
+ */
+void Pipeline::processTiled(const Image &src, Image &dst)
+{
+    if (&src == &dst)
+    {
+        Image copy(src);
+        processTiled(copy, dst);
+        return;
+    }
+    size_t n = this->stages.size();
+    this->inputSize = src.size();
+    this->outputSizes.resize(n);
+    Size size = src.size();
+    unsigned int halo = 0;
+    for (size_t k = 0; k < n; ++k)
+    {
+        size = this->stages[k]->outputSize(size);
+        this->outputSizes[k] = size;
+        if (k > 0)
+            halo += this->stages[k]->neighborhood();
+    }
+    dst.create(size.getWidth(), size.getHeight());
+    unsigned int height = size.getHeight();
+    for (const Size &stageSize : this->outputSizes)
+        if (stageSize.getWidth() == 0 || stageSize.getHeight() == 0)
+            return;
+
+    size_t haloBytes = 0;
+    size_t rowBytes = static_cast<size_t>(src.getWidth()) + size.getWidth();
+    unsigned int reach = halo;
+    for (size_t k = 0; k + 1 < n; ++k)
+    {
+        if (k > 0)
+            reach -= this->stages[k]->neighborhood();
+        haloBytes += 2 * static_cast<size_t>(reach) * this->outputSizes[k].getWidth();
+        rowBytes += this->outputSizes[k].getWidth();
+    }
+    size_t band = this->tileBytes > haloBytes ? (this->tileBytes - haloBytes) / rowBytes : 0;
+    band = std::min(std::max(band, static_cast<size_t>(8)), static_cast<size_t>(height));
+
+    size_t count = std::max(static_cast<size_t>(1), std::min(static_cast<size_t>(Parallel::getThreadCount()), height / band));
+    if (this->strips.size() < count)
+        this->strips.resize(count);
+    for (size_t s = 0; s < count; ++s)
+    {
+        Strip &strip = this->strips[s];
+        strip.rings.resize(n - 1);
+        strip.ringRows.resize(n - 1);
+        strip.computedRows.resize(n);
+        reach = halo;
+        for (size_t k = 0; k + 1 < n; ++k)
+        {
+            if (k > 0)
+                reach -= this->stages[k]->neighborhood();
+            size_t capacity = std::min(band + 2 * static_cast<size_t>(reach), static_cast<size_t>(this->outputSizes[k].getHeight()));
+            strip.rings[k].resize(capacity * this->outputSizes[k].getWidth());
+            strip.ringRows[k].resize(this->outputSizes[k].getHeight());
+        }
+    }
+
+    // dst was detached by create(), so its rows can be written from every strip.
+    unsigned char **out = dst.getData();
+    if (count == 1)
+    {
+        processStrip(this->strips[0], src, out, 0, height, band, halo);
+        return;
+    }
+    Parallel::forRows(0, static_cast<unsigned int>(count), [&](unsigned int first, unsigned int last)
+                      {
+                          for (unsigned int s = first; s < last; ++s)
+                              processStrip(this->strips[s], src, out, static_cast<unsigned int>(height * s / count),
+                                           static_cast<unsigned int>(height * (s + 1) / count), band, halo);
+                      },
+                      1);
+}
+
+/**
+ * Runs every stage band by band over the output rows [first, last). Stage k starts R rows above
+ * the strip, R being the sum of the neighborhoods of the stages after it, so the first band has
+ * the rows its neighborhoods reach.
+ *
+ * @param strip The ring buffers of the strip.
+ * @param src The source image.
+ * @param out The rows of the output of the last stage.
+ * @param first The first output row of the strip.
+ * @param last One past the last output row of the strip.
+ * @param band The number of output rows per band.
+ * @param halo The sum of the neighborhoods of the stages after the first.
+ */
+void Pipeline::processStrip(Strip &strip, const Image &src, unsigned char **out, unsigned int first, unsigned int last,
+                            size_t band, unsigned int halo)
+{
+    size_t n = this->stages.size();
+    unsigned int reach = halo;
+    for (size_t k = 0; k < n; ++k)
+    {
+        if (k > 0)
+            reach -= this->stages[k]->neighborhood();
+        strip.computedRows[k] = first > reach ? first - reach : 0;
+    }
+
+    for (unsigned int y0 = first; y0 < last; y0 += static_cast<unsigned int>(band))
+    {
+        unsigned int y1 = static_cast<unsigned int>(std::min(y0 + band, static_cast<size_t>(last)));
+        unsigned char **in = src.getData();
+        Size inSize = src.size();
+        reach = halo;
+        for (size_t k = 0; k < n; ++k)
+        {
+            if (k > 0)
+                reach -= this->stages[k]->neighborhood();
+            const Size &outSize = this->outputSizes[k];
+            unsigned int end = std::min(y1 + reach, outSize.getHeight());
+            unsigned int begin = strip.computedRows[k];
+            unsigned char **rows;
+            if (k + 1 == n)
+                rows = out;
+            else
+            {
+                rows = strip.ringRows[k].data();
+                size_t width = outSize.getWidth();
+                size_t capacity = strip.rings[k].size() / width;
+                for (unsigned int i = begin; i < end; ++i)
+                    rows[i] = strip.rings[k].data() + (i % capacity) * width;
+            }
+            if (begin < end)
+            {
+                this->stages[k]->processRows(in, inSize, rows, outSize, begin, end);
+                strip.computedRows[k] = end;
+            }
+            in = rows;
+            inSize = outSize;
+        }
+    }
+}
@@ -0,0 +1,167 @@
+#pragma once
+#include <vector>
+#include "ImageProcessing.h"
+
+/**
+ * @class Pipeline
+ * @brief Runs a chain of image processing stages, reusing its intermediate images from frame to frame.
+ *
+ * Chaining stages by hand allocates a new image for every intermediate result. A Pipeline keeps
+ * scratch images instead and ping-pongs between them: every stage reads the output of the
+ * previous one and writes into another scratch image, or into the same one when the stage
+ * supports running in place. The last stage that cannot run in place writes straight into the
+ * destination, and the stages after it run on the destination in place.
+ *
+ * The scratch images are picked by the output size every stage had on the previous image, so
+ * once an image size has been seen, processing more images of that size through stages that
+ * write into their destination without reallocating it (see Image::create) allocates nothing.
+ * Usually two scratch images are enough; stages that change the size may need a few more.
+ *
+ * When every stage is row-wise (see ImageProcessing::supportsRows()), the pipeline instead runs
+ * tiled by default: the output is produced in bands of rows sized so that the rows every stage
+ * keeps for a band fit in the cache, and the whole chain runs on one band before moving to the
+ * next. Every stage keeps its latest rows in a small ring buffer, enough for the neighborhoods
+ * of the stages after it, so the halo rows a band shares with the previous one are reused rather
+ * than recomputed, and the intermediate images never go through main memory. The output is
+ * split into one horizontal strip per thread of the pool, each running its own bands with ring
+ * buffers of its own; only the halo rows at the top of every strip are computed twice.
+ *
+ * A batch of images runs band by band too, every thread of the pool taking a run of images with
+ * ring buffers of its own. Other pipelines run a batch stage by stage instead, every stage
+ * processing the whole batch, so stages with setup shared across a batch (see
+ * ImageProcessing::processBatch()) only do it once.
+ *
+ * The stages are not owned by the pipeline and must outlive it.
+ */
+class Pipeline : public ImageProcessing
+{
+private:
+    /**
+     * @brief The state of one horizontal strip of the output in tiled execution.
+     */
+    struct Strip
+    {
+        std::vector<std::vector<unsigned char>> rings;      ///< The ring buffer of the latest rows of every stage but the last.
+        std::vector<std::vector<unsigned char *>> ringRows; ///< The rows of every stage but the last, indexed by row.
+        std::vector<unsigned int> computedRows;             ///< One past the last row computed by every stage.
+    };
+
+    std::vector<ImageProcessing *> stages; ///< The stages, in order.
+    std::vector<Image> buffers;            ///< The scratch images.
+    std::vector<Size> outputSizes;         ///< The output size of every stage on the last image.
+    Size inputSize;                        ///< The size of the last image.
+    bool tiled;                            ///< True to run row-wise stages band by band.
+    size_t tileBytes;                      ///< The size the rows kept for one band should fit in.
+    std::vector<Strip> strips;             ///< The strips of tiled execution, run in parallel.
+    std::vector<Image> batches[2];         ///< The scratch batches of pipelines that are not row-wise.
+
+public:
+    /**
+     * @brief Default constructor.
+     *
+     * Initializes a pipeline without stages, which copies its source.
+     */
+    Pipeline();
+
+    /**
+     * @brief Appends a stage.
+     *
+     * @param stage The stage, run after the ones already added.
+     */
+    void add(ImageProcessing &stage);
+
+    /**
+     * @brief Removes every stage and releases the scratch images.
+     */
+    void clear();
+
+    /**
+     * @brief Returns the number of stages.
+     *
+     * @return The number of stages.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Returns the number of scratch images.
+     *
+     * @return The number of scratch images.
+     */
+    size_t bufferCount() const;
+
+    /**
+     * @brief Returns whether row-wise pipelines run band by band.
+     *
+     * @return True for tiled execution.
+     */
+    bool isTiled() const;
+
+    /**
+     * @brief Sets whether row-wise pipelines run band by band.
+     *
+     * @param newTiled True for tiled execution.
+     */
+    void setTiled(bool newTiled);
+
+    /**
+     * @brief Get the size the rows kept for one band should fit in.
+     *
+     * @return The size in bytes.
+     */
+    size_t getTileBytes() const;
+
+    /**
+     * @brief Sets the size the rows kept for one band should fit in, typically the size of the L2 cache.
+     *
+     * @param newTileBytes The new size in bytes.
+     */
+    void setTileBytes(size_t newTileBytes);
+
+    /**
+     * @brief Runs every stage on the source image.
+     *
+     * @param src The source image.
+     * @param dst The output of the last stage.
+     */
+    void process(const Image &src, Image &dst) override;
+
+    /**
+     * @brief Runs every stage on a batch of images.
+     *
+     * @param src The source images.
+     * @param dst The outputs of the last stage.
+     */
+    void processBatch(const std::vector<Image> &src, std::vector<Image> &dst) override;
+
+private:
+    /**
+     * @brief Runs every stage band by band.
+     *
+     * @param src The source image.
+     * @param dst The output of the last stage.
+     */
+    void processTiled(const Image &src, Image &dst);
+
+    /**
+     * @brief Runs every stage band by band over the output rows [first, last).
+     *
+     * @param strip The ring buffers of the strip.
+     * @param src The source image.
+     * @param out The rows of the output of the last stage.
+     * @param first The first output row of the strip.
+     * @param last One past the last output row of the strip.
+     * @param band The number of output rows per band.
+     * @param halo The sum of the neighborhoods of the stages after the first.
+     */
+    void processStrip(Strip &strip, const Image &src, unsigned char **out, unsigned int first, unsigned int last,
+                      size_t band, unsigned int halo);
+
+    /**
+     * @brief Picks the scratch image a stage writes to.
+     *
+     * @param exclude The scratch image the stage reads, or -1 for the source image.
+     * @param expected The output size of the stage on the last image, or nullptr when unknown.
+     * @return The index of the scratch image.
+     */
+    int pickBuffer(int exclude, const Size *expected);
+};
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <stdexcept>
+#include "Pyramid.h"
+#include "Parallel.h"
+
+/**
+ * Blurs the source level with the 5x5 (1 4 6 4 1) kernel and keeps every second pixel of every second row.
+ *
+ * The vertical taps are applied to whole rows first (a contiguous, vectorizable loop), then the
+ * horizontal taps are evaluated only at the even columns. Borders are replicated.
+ *
+ * @param src The pixels of the source level.
+ * @param srcSize The size of the source level.
+ * @param dst The pixels of the destination level.
+ * @param dstSize The size of the destination level.
+ */
+static void blurAndDecimate(const unsigned char *src, Size srcSize, unsigned char *dst, Size dstSize)
+{
+    int srcWidth = srcSize.getWidth();
+    int srcHeight = srcSize.getHeight();
+    int dstWidth = dstSize.getWidth();
+    Parallel::forRows(0, dstSize.getHeight(), [&](unsigned int first, unsigned int last)
+                      {
+                          std::vector<int> column(srcWidth);
+                          for (unsigned int y = first; y < last; ++y)
+                          {
+                              const unsigned char *rows[5];
+                              for (int k = 0; k < 5; ++k)
+                              {
+                                  int r = std::min(std::max(2 * static_cast<int>(y) + k - 2, 0), srcHeight - 1);
+                                  rows[k] = src + static_cast<size_t>(r) * srcWidth;
+                              }
+                              for (int x = 0; x < srcWidth; ++x)
+                                  column[x] = rows[0][x] + 4 * rows[1][x] + 6 * rows[2][x] + 4 * rows[3][x] + rows[4][x];
+
+                              unsigned char *out = dst + static_cast<size_t>(y) * dstWidth;
+                              for (int x = 0; x < dstWidth; ++x)
+                              {
+                                  int c = 2 * x;
+                                  int sum;
+                                  if (c >= 2 && c + 2 < srcWidth)
+                                      sum = column[c - 2] + 4 * column[c - 1] + 6 * column[c] + 4 * column[c + 1] + column[c + 2];
+                                  else
+                                  {
+                                      sum = 0;
+                                      const int weights[5] = {1, 4, 6, 4, 1};
+                                      for (int k = 0; k < 5; ++k)
+                                          sum += weights[k] * column[std::min(std::max(c + k - 2, 0), srcWidth - 1)];
+                                  }
+                                  out[x] = static_cast<unsigned char>((sum + 128) >> 8);
+                              }
+                          }
+                      });
+}
+
+/**
+ * @brief Default constructor for the Pyramid class.
+ * Initializes a pyramid with 4 levels.
+ */
+Pyramid::Pyramid() : levels{4}, baseSize{} {}
+
+/**
+ * @brief Constructs a pyramid with the specified number of levels.
+ *
+ * @param levels The number of levels, including the full-resolution level 0.
+ */
+Pyramid::Pyramid(unsigned int levels)
+{
+    this->levels = levels > 0 ? levels : 1;
+}
+
+/**
+ * Builds the pyramid of the source image.
+ *
+ * The level layout is only recomputed (and the buffer only reallocated) when the size of the
+ * source image differs from the size of the previous build.
+ *
+ * @param src The source image.
+ * @throws std::invalid_argument if the source image is empty.
+ */
+void Pyramid::build(const Image &src)
+{
+    if (src.getWidth() == 0 || src.getHeight() == 0)
+        throw std::invalid_argument("Cannot build the pyramid of an empty image!");
+
+    if (!(src.size() == this->baseSize) || this->sizes.empty())
+    {
+        this->baseSize = src.size();
+        this->sizes.clear();
+        this->offsets.clear();
+        size_t total = 0;
+        Size size = this->baseSize;
+        for (unsigned int level = 0; level < this->levels; ++level)
+        {
+            this->sizes.push_back(size);
+            this->offsets.push_back(total);
+            total += static_cast<size_t>(size.getWidth()) * size.getHeight();
+            if (size.getWidth() == 1 && size.getHeight() == 1)
+                break;
+            size = Size((size.getWidth() + 1) / 2, (size.getHeight() + 1) / 2);
+        }
+        this->buffer.resize(total);
+    }
+
+    unsigned int width = src.getWidth();
+    for (unsigned int i = 0; i < src.getHeight(); ++i)
+        std::copy(src.getData()[i], src.getData()[i] + width, &this->buffer[static_cast<size_t>(i) * width]);
+
+    for (size_t level = 1; level < this->sizes.size(); ++level)
+        blurAndDecimate(&this->buffer[this->offsets[level - 1]], this->sizes[level - 1],
+                        &this->buffer[this->offsets[level]], this->sizes[level]);
+}
+
+/**
+ * @brief Get the number of levels of the last built pyramid.
+ *
+ * @return The number of levels, or 0 if the pyramid was never built.
+ */
+unsigned int Pyramid::getLevels() const
+{
+    return static_cast<unsigned int>(this->sizes.size());
+}
+
+/**
+ * @brief Get the size of a level.
+ *
+ * @param level The index of the level.
+ * @return The size of the level.
+ */
+Size Pyramid::getLevelSize(unsigned int level) const
+{
+    return this->sizes.at(level);
+}
+
+/**
+ * @brief Returns a pointer to a row of a level.
+ *
+ * @param level The index of the level.
+ * @param y The index of the row.
+ * @return Pointer to the pixels of the row.
+ */
+const unsigned char *Pyramid::levelRow(unsigned int level, unsigned int y) const
+{
+    return &this->buffer[this->offsets.at(level) + static_cast<size_t>(y) * this->sizes[level].getWidth()];
+}
+
+/**
+ * @brief Copies a level into an image.
+ *
+ * @param level The index of the level.
+ * @param dst The image that receives the level.
+ */
+void Pyramid::getLevel(unsigned int level, Image &dst) const
+{
+    Size size = this->sizes.at(level);
+    Image output(size.getWidth(), size.getHeight());
+    for (unsigned int i = 0; i < size.getHeight(); ++i)
+    {
+        const unsigned char *in = levelRow(level, i);
+        std::copy(in, in + size.getWidth(), output.row(i));
+    }
+    dst = output;
+}
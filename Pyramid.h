@@ -0,0 +1,81 @@
+#pragma once
+#include <vector>
+#include "Image.h"
+
+/**
+ * @class Pyramid
+ * @brief Represents a Gaussian image pyramid.
+ *
+ * Level 0 is a copy of the source image and every following level is half the width and half
+ * the height of the previous one. Each level is produced from the previous one with a fused
+ * 5-tap (1 4 6 4 1) blur-and-decimate kernel that only evaluates the pixels that are kept.
+ *
+ * All levels live in one contiguous buffer. Building a pyramid of an image with the same size
+ * as the previous one reuses that buffer, so processing a video stream allocates nothing after
+ * the first frame.
+ */
+class Pyramid
+{
+private:
+    unsigned int levels;                ///< The requested number of levels.
+    Size baseSize;                      ///< The size of level 0, or 0x0 before the first build.
+    std::vector<unsigned char> buffer;  ///< The pixels of every level, stored one level after another.
+    std::vector<size_t> offsets;        ///< The offset of every level in the buffer.
+    std::vector<Size> sizes;            ///< The size of every level.
+
+public:
+    /**
+     * @brief Default constructor.
+     *
+     * Initializes a pyramid with 4 levels.
+     */
+    Pyramid();
+
+    /**
+     * @brief Constructs a pyramid with the specified number of levels.
+     *
+     * @param levels The number of levels, including the full-resolution level 0.
+     */
+    Pyramid(unsigned int levels);
+
+    /**
+     * @brief Builds the pyramid of the source image.
+     *
+     * Fewer levels than requested are built when a level would become smaller than 1x1.
+     *
+     * @param src The source image.
+     */
+    void build(const Image &src);
+
+    /**
+     * @brief Get the number of levels of the last built pyramid.
+     *
+     * @return The number of levels.
+     */
+    unsigned int getLevels() const;
+
+    /**
+     * @brief Get the size of a level.
+     *
+     * @param level The index of the level.
+     * @return The size of the level.
+     */
+    Size getLevelSize(unsigned int level) const;
+
+    /**
+     * @brief Returns a pointer to a row of a level.
+     *
+     * @param level The index of the level.
+     * @param y The index of the row.
+     * @return Pointer to the pixels of the row.
+     */
+    const unsigned char *levelRow(unsigned int level, unsigned int y) const;
+
+    /**
+     * @brief Copies a level into an image.
+     *
+     * @param level The index of the level.
+     * @param dst The image that receives the level.
+     */
+    void getLevel(unsigned int level, Image &dst) const;
+};
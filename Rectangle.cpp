@@ -1,4 +1,5 @@
 #include <iostream>
+#include <algorithm>
 #include "Rectangle.h"
 
 /**
@@ -140,17 +141,22 @@ void Rectangle::operator-(const Point &point)
  */
 Rectangle Rectangle::operator&(const Rectangle &rtg)
 {
-    if (this->x + this->getWidth() <= rtg.getX() ||
-        this->y - this->height >= rtg.getY() ||
-        this->x >= rtg.getX() + rtg.getWidth() ||
-        this->y <= rtg.getY() - rtg.getHeight())
+    // Signed edges: mixing the int coordinates with the unsigned sizes would wrap around for negative coordinates.
+    int right = this->x + static_cast<int>(this->width);
+    int bottom = this->y - static_cast<int>(this->height);
+    int otherRight = rtg.getX() + static_cast<int>(rtg.getWidth());
+    int otherBottom = rtg.getY() - static_cast<int>(rtg.getHeight());
+    if (right <= rtg.getX() ||
+        bottom >= rtg.getY() ||
+        this->x >= otherRight ||
+        this->y <= otherBottom)
     {
         return Rectangle(0, 0, 0, 0);
     }
     int xIntersect = std::max(this->x, rtg.getX());
     int yIntersect = std::min(this->y, rtg.getY());
-    int widthIntersect = std::min(this->x + this->width, rtg.getX() + rtg.getWidth()) - xIntersect;
-    int heightIntersect = yIntersect - std::max(this->y - this->height, rtg.getY() - rtg.getHeight());
+    int widthIntersect = std::min(right, otherRight) - xIntersect;
+    int heightIntersect = yIntersect - std::max(bottom, otherBottom);
     return Rectangle(xIntersect, yIntersect, widthIntersect, heightIntersect);
 }
 
@@ -167,7 +173,7 @@ Rectangle Rectangle::operator|(const Rectangle &rtg)
 {
     int xReunion = std::min(this->x, rtg.getX());
     int yReunion = std::max(this->y, rtg.getY());
-    int widthReunion = std::max(this->x + this->width, rtg.getX() + rtg.getWidth()) - xReunion;
-    int heightReunion = yReunion - std::min(this->y - this->height, rtg.getY() - rtg.getHeight());
+    int widthReunion = std::max(this->x + static_cast<int>(this->width), rtg.getX() + static_cast<int>(rtg.getWidth())) - xReunion;
+    int heightReunion = yReunion - std::min(this->y - static_cast<int>(this->height), rtg.getY() - static_cast<int>(rtg.getHeight()));
     return Rectangle(xReunion, yReunion, widthReunion, heightReunion);
 }
\ No newline at end of file
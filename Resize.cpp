@@ -0,0 +1,524 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <vector>
+#include "Resize.h"
+#include "Parallel.h"
+#include "Simd.h"
+#include "ImageMetrics.h"
+#include "Trace.h"
+
+static const int PRECISION_BITS = 14;              ///< Fractional bits of the fixed-point filter weights.
+static const int ONE = 1 << PRECISION_BITS;        ///< The weight 1.0 in fixed point.
+static const int HALF = 1 << (PRECISION_BITS - 1); ///< The rounding term 0.5 in fixed point.
+static const int SIMD_MIN_TAPS = 4;                ///< The horizontal pass vectorizes output samples with more taps.
+static const double PI = 3.14159265358979323846;
+
+/**
+ * The fixed-point filter weights of a one-dimensional resampling pass.
+ *
+ * Output sample o is the weighted sum of the count[o] source samples starting at start[o],
+ * using the weights stored at weights[o * taps]. taps is rounded up to a multiple of 8 and the
+ * weights past count[o] are zero, so the horizontal pass can read them 8 at a time.
+ */
+struct ResampleCoefficients
+{
+    std::vector<int> start;
+    std::vector<int> count;
+    std::vector<short> weights;
+    int taps;
+};
+
+static double boxFilter(double x)
+{
+    return (x >= -0.5 && x < 0.5) ? 1.0 : 0.0;
+}
+
+static double triangleFilter(double x)
+{
+    x = std::fabs(x);
+    return x < 1.0 ? 1.0 - x : 0.0;
+}
+
+static double cubicFilter(double x)
+{
+    const double a = -0.5;
+    x = std::fabs(x);
+    if (x < 1.0)
+        return ((a + 2.0) * x - (a + 3.0)) * x * x + 1;
+    if (x < 2.0)
+        return (((x - 5) * x + 8) * x - 4) * a;
+    return 0.0;
+}
+
+static double sinc(double x)
+{
+    if (x == 0.0)
+        return 1.0;
+    x *= PI;
+    return std::sin(x) / x;
+}
+
+static double lanczosFilter(double x)
+{
+    if (x > -3.0 && x < 3.0)
+        return sinc(x) * sinc(x / 3.0);
+    return 0.0;
+}
+
+/**
+ * Computes the fixed-point weights that resample inSize samples to outSize samples.
+ *
+ * The weights of every output sample are normalized so that they sum to exactly 1.0 in fixed
+ * point, which keeps flat regions exactly flat.
+ *
+ * @param inSize The number of source samples.
+ * @param outSize The number of output samples.
+ * @param interpolation The interpolation method.
+ * @param coefficients The computed weights.
+ */
+static void computeCoefficients(unsigned int inSize, unsigned int outSize, Resize::Interpolation interpolation,
+                                ResampleCoefficients &coefficients)
+{
+    double (*filter)(double) = triangleFilter;
+    double support = 1.0;
+    switch (interpolation)
+    {
+    case Resize::BICUBIC:
+        filter = cubicFilter;
+        support = 2.0;
+        break;
+    case Resize::LANCZOS:
+        filter = lanczosFilter;
+        support = 3.0;
+        break;
+    case Resize::AREA:
+        filter = boxFilter;
+        support = 0.5;
+        break;
+    default:
+        break;
+    }
+
+    double scale = static_cast<double>(inSize) / outSize;
+    double filterScale = scale < 1.0 ? 1.0 : scale;
+    double radius = support * filterScale;
+    int taps = static_cast<int>(std::ceil(radius)) * 2 + 1;
+
+    coefficients.taps = (taps + 7) / 8 * 8;
+    coefficients.start.assign(outSize, 0);
+    coefficients.count.assign(outSize, 0);
+    coefficients.weights.assign(static_cast<size_t>(outSize) * coefficients.taps, 0);
+
+    std::vector<double> weights(taps);
+    for (unsigned int o = 0; o < outSize; ++o)
+    {
+        double center = (o + 0.5) * scale;
+        int first = static_cast<int>(center - radius + 0.5);
+        int last = static_cast<int>(center + radius + 0.5);
+        if (first < 0)
+            first = 0;
+        if (last > static_cast<int>(inSize))
+            last = inSize;
+        int count = last - first;
+        if (count > taps)
+            count = taps;
+
+        double total = 0.0;
+        for (int k = 0; k < count; ++k)
+        {
+            weights[k] = filter((first + k - center + 0.5) / filterScale);
+            total += weights[k];
+        }
+        if (total == 0.0)
+        {
+            // The filter missed every sample (only possible for tiny boxes): take the nearest one.
+            int nearest = static_cast<int>(center);
+            first = nearest < static_cast<int>(inSize) ? nearest : inSize - 1;
+            count = 1;
+            weights[0] = total = 1.0;
+        }
+
+        short *fixed = &coefficients.weights[static_cast<size_t>(o) * coefficients.taps];
+        int sum = 0;
+        int largest = 0;
+        for (int k = 0; k < count; ++k)
+        {
+            fixed[k] = static_cast<short>(std::lround(weights[k] / total * ONE));
+            sum += fixed[k];
+            if (fixed[k] > fixed[largest])
+                largest = k;
+        }
+        fixed[largest] = static_cast<short>(fixed[largest] + ONE - sum);
+
+        coefficients.start[o] = first;
+        coefficients.count[o] = count;
+    }
+}
+
+/**
+ * Clamps a fixed-point accumulator to a pixel value.
+ */
+static inline unsigned char toPixel(int accumulator)
+{
+    int value = accumulator >> PRECISION_BITS;
+    if (value < 0)
+        return 0;
+    if (value > 255)
+        return 255;
+    return static_cast<unsigned char>(value);
+}
+
+/**
+ * Resamples the rows [first, last) of the source horizontally.
+ *
+ * With SSE2 the taps of an output sample are summed 8 at a time: the samples are widened to 16
+ * bits and multiplied with the weights by _mm_madd_epi16, which also adds adjacent products into
+ * 32 bits. The padding weights are zero. Output samples with few taps, where the reduction of
+ * the sum would cost more than it saves, and those whose last group of 8 would read past the
+ * end of the row use the scalar loop.
+ */
+static void horizontalPass(unsigned char *const *srcRows, unsigned char *const *dstRows, unsigned int first, unsigned int last,
+                           unsigned int inWidth, unsigned int outWidth, const ResampleCoefficients &coefficients)
+{
+    for (unsigned int i = first; i < last; ++i)
+    {
+        const unsigned char *in = srcRows[i];
+        unsigned char *out = dstRows[i];
+        for (unsigned int o = 0; o < outWidth; ++o)
+        {
+            const unsigned char *samples = in + coefficients.start[o];
+            const short *weights = &coefficients.weights[static_cast<size_t>(o) * coefficients.taps];
+#ifdef IMAGE_PROCESSING_SSE2
+            int groups = (coefficients.count[o] + 7) / 8;
+            if (coefficients.count[o] > SIMD_MIN_TAPS && static_cast<unsigned int>(coefficients.start[o] + groups * 8) <= inWidth)
+            {
+                const __m128i zero = _mm_setzero_si128();
+                __m128i sum = _mm_setzero_si128();
+                for (int g = 0; g < groups; ++g)
+                {
+                    __m128i pixels = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(samples + 8 * g)), zero);
+                    __m128i weight = _mm_loadu_si128(reinterpret_cast<const __m128i *>(weights + 8 * g));
+                    sum = _mm_add_epi32(sum, _mm_madd_epi16(pixels, weight));
+                }
+                sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+                sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+                out[o] = toPixel(HALF + _mm_cvtsi128_si32(sum));
+                continue;
+            }
+#endif
+            int accumulator = HALF;
+            for (int k = 0; k < coefficients.count[o]; ++k)
+                accumulator += samples[k] * weights[k];
+            out[o] = toPixel(accumulator);
+        }
+    }
+}
+
+/**
+ * Resamples the output rows [first, last) vertically from the horizontally resampled rows.
+ */
+static void verticalPass(unsigned char *const *srcRows, Image &dst, unsigned int first, unsigned int last,
+                         const ResampleCoefficients &coefficients)
+{
+    unsigned int width = dst.getWidth();
+    for (unsigned int o = first; o < last; ++o)
+    {
+        unsigned char *const *rows = srcRows + coefficients.start[o];
+        const short *weights = &coefficients.weights[static_cast<size_t>(o) * coefficients.taps];
+        int count = coefficients.count[o];
+        unsigned char *out = dst.row(o);
+        unsigned int j = 0;
+#ifdef IMAGE_PROCESSING_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        for (; j + 8 <= width; j += 8)
+        {
+            __m128i accLo = _mm_set1_epi32(HALF);
+            __m128i accHi = accLo;
+            for (int k = 0; k < count; ++k)
+            {
+                __m128i pixels = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(rows[k] + j)), zero);
+                __m128i weight = _mm_set1_epi16(weights[k]);
+                __m128i lo = _mm_mullo_epi16(pixels, weight);
+                __m128i hi = _mm_mulhi_epi16(pixels, weight);
+                accLo = _mm_add_epi32(accLo, _mm_unpacklo_epi16(lo, hi));
+                accHi = _mm_add_epi32(accHi, _mm_unpackhi_epi16(lo, hi));
+            }
+            accLo = _mm_srai_epi32(accLo, PRECISION_BITS);
+            accHi = _mm_srai_epi32(accHi, PRECISION_BITS);
+            __m128i packed = _mm_packs_epi32(accLo, accHi);
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + j), _mm_packus_epi16(packed, packed));
+        }
+#endif
+        for (; j < width; ++j)
+        {
+            int accumulator = HALF;
+            for (int k = 0; k < count; ++k)
+                accumulator += rows[k][j] * weights[k];
+            out[j] = toPixel(accumulator);
+        }
+    }
+}
+
+/**
+ * Runs the body over the rows [first, last), in parallel row bands or on the calling thread.
+ */
+static void runRows(bool parallel, unsigned int first, unsigned int last,
+                    FunctionRef<void(unsigned int first, unsigned int last)> body)
+{
+    if (parallel)
+        Parallel::forRows(first, last, body);
+    else
+        body(first, last);
+}
+
+/**
+ * Downscales by integer factors: every output pixel is the rounded mean of a factorX x factorY block.
+ */
+static void areaDownscale(const Image &src, Image &dst, unsigned int factorX, unsigned int factorY, bool parallel)
+{
+    unsigned int outWidth = dst.getWidth();
+    unsigned int area = factorX * factorY;
+    unsigned char **srcRows = src.getData();
+    runRows(parallel, 0, dst.getHeight(), [&](unsigned int first, unsigned int last)
+            {
+                std::vector<unsigned int> columns(src.getWidth());
+                for (unsigned int o = first; o < last; ++o)
+                {
+                    std::fill(columns.begin(), columns.end(), 0);
+                    for (unsigned int k = 0; k < factorY; ++k)
+                    {
+                        const unsigned char *in = srcRows[o * factorY + k];
+                        for (unsigned int j = 0; j < columns.size(); ++j)
+                            columns[j] += in[j];
+                    }
+                    unsigned char *out = dst.row(o);
+                    for (unsigned int j = 0; j < outWidth; ++j)
+                    {
+                        unsigned int sum = area / 2;
+                        for (unsigned int k = 0; k < factorX; ++k)
+                            sum += columns[j * factorX + k];
+                        out[j] = static_cast<unsigned char>(sum / area);
+                    }
+                }
+            });
+}
+
+/**
+ * Resizes the source image to the given size into an output image that already has that size.
+ *
+ * @param src The source image.
+ * @param output The resized image, which must not be the source.
+ * @param interpolation The interpolation method.
+ * @param horizontal The weights of the horizontal pass, or nullptr to compute them.
+ * @param vertical The weights of the vertical pass, or nullptr to compute them.
+ * @param buffer The storage of the horizontally resampled rows, grown as needed.
+ * @param bufferRows The horizontally resampled rows, grown as needed.
+ * @param parallel True to run both passes in parallel row bands.
+ */
+static void resample(const Image &src, Image &output, Resize::Interpolation interpolation,
+                     const ResampleCoefficients *horizontal, const ResampleCoefficients *vertical,
+                     std::vector<unsigned char> &buffer, std::vector<unsigned char *> &bufferRows, bool parallel)
+{
+    unsigned int inWidth = src.getWidth();
+    unsigned int inHeight = src.getHeight();
+    unsigned int outWidth = output.getWidth();
+    unsigned int outHeight = output.getHeight();
+
+    if (interpolation == Resize::AREA && inWidth % outWidth == 0 && inHeight % outHeight == 0)
+    {
+        areaDownscale(src, output, inWidth / outWidth, inHeight / outHeight, parallel);
+        return;
+    }
+
+    // Horizontal pass (skipped when the width does not change).
+    unsigned char *const *rows = src.getData();
+    if (outWidth != inWidth)
+    {
+        ResampleCoefficients computed;
+        if (horizontal == nullptr)
+        {
+            computeCoefficients(inWidth, outWidth, interpolation, computed);
+            horizontal = &computed;
+        }
+        buffer.resize(static_cast<size_t>(inHeight) * outWidth);
+        bufferRows.resize(inHeight);
+        for (unsigned int i = 0; i < inHeight; ++i)
+            bufferRows[i] = &buffer[static_cast<size_t>(i) * outWidth];
+        runRows(parallel, 0, inHeight, [&](unsigned int first, unsigned int last)
+                { horizontalPass(rows, bufferRows.data(), first, last, inWidth, outWidth, *horizontal); });
+        rows = bufferRows.data();
+    }
+
+    // Vertical pass (a plain copy when the height does not change).
+    if (outHeight != inHeight)
+    {
+        ResampleCoefficients computed;
+        if (vertical == nullptr)
+        {
+            computeCoefficients(inHeight, outHeight, interpolation, computed);
+            vertical = &computed;
+        }
+        runRows(parallel, 0, outHeight, [&](unsigned int first, unsigned int last)
+                { verticalPass(rows, output, first, last, *vertical); });
+    }
+    else
+    {
+        for (unsigned int i = 0; i < outHeight; ++i)
+            std::copy(rows[i], rows[i] + outWidth, output.row(i));
+    }
+}
+
+/**
+ * @brief Default constructor for the Resize class.
+ * Initializes the output size to 0x0 and the interpolation to BILINEAR.
+ */
+Resize::Resize() : size{}, interpolation{BILINEAR} {}
+
+/**
+ * @brief Constructs a Resize object with the specified output size and interpolation method.
+ *
+ * @param size The size of the output image.
+ * @param interpolation The interpolation method.
+ */
+Resize::Resize(Size size, Interpolation interpolation)
+{
+    this->size = size;
+    this->interpolation = interpolation;
+}
+
+/**
+ * @brief Get the size of the output image.
+ *
+ * @return The output size.
+ */
+Size Resize::getSize() const
+{
+    return this->size;
+}
+
+/**
+ * @brief Sets the size of the output image.
+ *
+ * @param newSize The new output size.
+ */
+void Resize::setSize(Size newSize)
+{
+    this->size = newSize;
+}
+
+/**
+ * @brief Get the interpolation method.
+ *
+ * @return The interpolation method.
+ */
+Resize::Interpolation Resize::getInterpolation() const
+{
+    return this->interpolation;
+}
+
+/**
+ * @brief Sets the interpolation method.
+ *
+ * @param newInterpolation The new interpolation method.
+ */
+void Resize::setInterpolation(Interpolation newInterpolation)
+{
+    this->interpolation = newInterpolation;
+}
+
+/**
+ * Resizes the source image to the configured size and interpolation method.
+ *
+ * @param src The source image.
+ * @param dst The resized image.
+ */
+void Resize::process(const Image &src, Image &dst)
+{
+    TRACE_SCOPE("Resize::process", "process");
+    ImageMetrics::Site site("Resize::process");
+    resize(src, dst, this->size, this->interpolation);
+}
+
+/**
+ * Resizes a batch of images, spread across the threads of the pool.
+ *
+ * The filter weights only depend on the source size, so they are computed once for every width
+ * and every height in the batch, before any image is resampled. Every thread then resizes its run
+ * of images one after another, both passes on the same thread, reusing its intermediate buffer
+ * and writing straight into the output images.
+ *
+ * @param src The source images.
+ * @param dst The resized images.
+ * @throws std::invalid_argument if a source image or the configured size is empty.
+ */
+void Resize::processBatch(const std::vector<Image> &src, std::vector<Image> &dst)
+{
+    TRACE_SCOPE("Resize::processBatch", "process");
+    ImageMetrics::Site site("Resize::processBatch");
+    unsigned int outWidth = this->size.getWidth();
+    unsigned int outHeight = this->size.getHeight();
+    std::map<unsigned int, ResampleCoefficients> horizontal;
+    std::map<unsigned int, ResampleCoefficients> vertical;
+    for (const Image &image : src)
+    {
+        unsigned int inWidth = image.getWidth();
+        unsigned int inHeight = image.getHeight();
+        if (inWidth == 0 || inHeight == 0 || outWidth == 0 || outHeight == 0)
+            throw std::invalid_argument("Cannot resize an empty image!");
+        if (inWidth != outWidth && horizontal.find(inWidth) == horizontal.end())
+            computeCoefficients(inWidth, outWidth, this->interpolation, horizontal[inWidth]);
+        if (inHeight != outHeight && vertical.find(inHeight) == vertical.end())
+            computeCoefficients(inHeight, outHeight, this->interpolation, vertical[inHeight]);
+    }
+
+    dst.resize(src.size());
+    Parallel::forRows(0, static_cast<unsigned int>(src.size()), [&](unsigned int first, unsigned int last)
+                      {
+                          std::vector<unsigned char> buffer;
+                          std::vector<unsigned char *> bufferRows;
+                          Image copy;
+                          for (unsigned int i = first; i < last; ++i)
+                          {
+                              unsigned int inWidth = src[i].getWidth();
+                              unsigned int inHeight = src[i].getHeight();
+                              Image &output = &src[i] == &dst[i] ? copy : dst[i];
+                              output.create(outWidth, outHeight);
+                              resample(src[i], output, this->interpolation,
+                                       inWidth != outWidth ? &horizontal.at(inWidth) : nullptr,
+                                       inHeight != outHeight ? &vertical.at(inHeight) : nullptr,
+                                       buffer, bufferRows, false);
+                              if (&output == &copy)
+                                  dst[i] = copy;
+                          }
+                      },
+                      1);
+}
+
+/**
+ * Resizes the source image to the given size.
+ *
+ * A dimension that keeps its size skips its pass entirely. The horizontal pass writes into an
+ * intermediate buffer of srcHeight x dstWidth pixels, which the vertical pass then reads row by row.
+ *
+ * @param src The source image.
+ * @param dst The resized image.
+ * @param size The size of the resized image.
+ * @param interpolation The interpolation method.
+ * @throws std::invalid_argument if the source image or the requested size is empty.
+ */
+void Resize::resize(const Image &src, Image &dst, Size size, Interpolation interpolation)
+{
+    unsigned int outWidth = size.getWidth();
+    unsigned int outHeight = size.getHeight();
+    if (src.getWidth() == 0 || src.getHeight() == 0 || outWidth == 0 || outHeight == 0)
+        throw std::invalid_argument("Cannot resize an empty image!");
+
+    Image output(outWidth, outHeight);
+    std::vector<unsigned char> buffer;
+    std::vector<unsigned char *> bufferRows;
+    resample(src, output, interpolation, nullptr, nullptr, buffer, bufferRows, true);
+    dst = output;
+}
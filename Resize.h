@@ -0,0 +1,105 @@
+#pragma once
+#include "ImageProcessing.h"
+
+/**
+ * @class Resize
+ * @brief A class that represents an image resampling operation.
+ *
+ * The Resize class scales an image to an arbitrary output size. The filter coefficients are
+ * precomputed once per output column and per output row in fixed point, and the image is
+ * resampled with a horizontal pass followed by a vertical pass. When downscaling, the filters
+ * are widened by the scale factor so the result is properly antialiased.
+ *
+ * Downscaling with the AREA method by integer factors (such as 2, 4 or 8) takes a fast path
+ * that averages each block of source pixels directly.
+ */
+class Resize : public ImageProcessing
+{
+public:
+    /**
+     * @brief The interpolation methods supported by Resize.
+     */
+    enum Interpolation
+    {
+        BILINEAR, /**< Triangle filter with a support of 1 pixel. */
+        BICUBIC,  /**< Cubic convolution (a = -0.5) with a support of 2 pixels. */
+        LANCZOS,  /**< Lanczos filter with a support of 3 pixels. */
+        AREA      /**< Box filter: every output pixel is the average of the source area it covers. */
+    };
+
+private:
+    Size size;                   /**< The size of the output image. */
+    Interpolation interpolation; /**< The interpolation method. */
+
+public:
+    /**
+     * @brief Default constructor.
+     *
+     * Initializes the output size to 0x0 and the interpolation to BILINEAR.
+     */
+    Resize();
+
+    /**
+     * @brief Constructs a Resize object with the specified output size and interpolation method.
+     *
+     * @param size The size of the output image.
+     * @param interpolation The interpolation method.
+     */
+    Resize(Size size, Interpolation interpolation = BILINEAR);
+
+    /**
+     * @brief Get the size of the output image.
+     *
+     * @return The output size.
+     */
+    Size getSize() const;
+
+    /**
+     * @brief Set the size of the output image.
+     *
+     * @param newSize The new output size.
+     */
+    void setSize(Size newSize);
+
+    /**
+     * @brief Get the interpolation method.
+     *
+     * @return The interpolation method.
+     */
+    Interpolation getInterpolation() const;
+
+    /**
+     * @brief Set the interpolation method.
+     *
+     * @param newInterpolation The new interpolation method.
+     */
+    void setInterpolation(Interpolation newInterpolation);
+
+    /**
+     * @brief Resizes the source image and stores the result in the destination image.
+     *
+     * @param src The source image.
+     * @param dst The resized image.
+     */
+    void process(const Image &src, Image &dst) override;
+
+    /**
+     * @brief Resizes a batch of images to the configured size.
+     *
+     * @param src The source images.
+     * @param dst The resized images.
+     * @throws std::invalid_argument if a source image or the configured size is empty.
+     */
+    void processBatch(const std::vector<Image> &src, std::vector<Image> &dst) override;
+
+    /**
+     * @brief Resizes the source image to the given size.
+     *
+     * @param src The source image.
+     * @param dst The resized image.
+     * @param size The size of the resized image.
+     * @param interpolation The interpolation method.
+     * @throws std::invalid_argument if the source image or the requested size is empty.
+     */
+    static void resize(const Image &src, Image &dst, Size size, Interpolation interpolation = BILINEAR);
+};
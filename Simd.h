@@ -0,0 +1,8 @@
+#pragma once
+
+// SSE2 is part of the x86-64 baseline, so it is enabled for every 64-bit x86 build.
+// Operators provide a scalar fallback for the other targets.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMAGE_PROCESSING_SSE2 1
+#include <emmintrin.h>
+#endif
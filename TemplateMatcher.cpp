@@ -0,0 +1,579 @@
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <stdexcept>
+#include "TemplateMatcher.h"
+#include "Parallel.h"
+#include "Simd.h"
+
+/**
+ * The mean of the template pixels and the norm of the template once its mean is removed.
+ */
+struct TemplateMoments
+{
+    double mean;
+    double norm;
+};
+
+/**
+ * A score map with its size.
+ */
+struct ScoreMap
+{
+    float *scores;
+    unsigned int width;
+    unsigned int height;
+};
+
+/**
+ * Computes the mean and the zero-mean norm of a template.
+ */
+static TemplateMoments templateMoments(const Image &templ)
+{
+    unsigned long long sum = 0, squares = 0;
+    for (unsigned int i = 0; i < templ.getHeight(); ++i)
+    {
+        const unsigned char *in = templ.getData()[i];
+        for (unsigned int j = 0; j < templ.getWidth(); ++j)
+        {
+            sum += in[j];
+            squares += in[j] * in[j];
+        }
+    }
+    double area = static_cast<double>(templ.getWidth()) * templ.getHeight();
+    TemplateMoments moments;
+    moments.mean = sum / area;
+    moments.norm = std::sqrt(std::max(squares - static_cast<double>(sum) * sum / area, 0.0));
+    return moments;
+}
+
+/**
+ * Turns the correlation of a window with the zero-mean template into a score.
+ *
+ * Windows or templates with (almost) no variance have no defined correlation and score 0.
+ *
+ * @param correlation The sum of the window pixels times the zero-mean template pixels.
+ * @param sum The sum of the window pixels.
+ * @param squaredSum The sum of the squared window pixels.
+ * @param area The number of pixels of the template.
+ * @param templateNorm The zero-mean norm of the template.
+ * @return The score, from -1 to 1.
+ */
+static inline float normalize(double correlation, double sum, double squaredSum, double area, double templateNorm)
+{
+    // The smallest non-zero variance sum of integer pixels is (area - 1) / area.
+    double variance = squaredSum - sum * sum / area;
+    if (variance < 0.5 || templateNorm < 0.5)
+        return 0.0f;
+    double score = correlation / (std::sqrt(variance) * templateNorm);
+    return static_cast<float>(std::max(-1.0, std::min(1.0, score)));
+}
+
+/**
+ * Adds the correlation of one template row with the frame row below it, for the positions [x0, x1).
+ *
+ * With SSE2, 8 positions are computed at a time: two neighbouring frame pixels are interleaved
+ * with the two matching template pixels so that one 16-bit multiply-add handles both.
+ */
+static void correlateRow(const unsigned char *in, const unsigned char *t, unsigned int templateWidth,
+                         unsigned int x0, unsigned int x1, long long *acc)
+{
+    unsigned int x = x0;
+#ifdef IMAGE_PROCESSING_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 8 <= x1; x += 8)
+    {
+        __m128i lo = zero, hi = zero;
+        unsigned int c = 0;
+        for (; c + 1 < templateWidth; c += 2)
+        {
+            __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(in + x + c)), zero);
+            __m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(in + x + c + 1)), zero);
+            __m128i coefficients = _mm_set1_epi32(t[c] | (t[c + 1] << 16));
+            lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), coefficients));
+            hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), coefficients));
+        }
+        if (c < templateWidth)
+        {
+            __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(in + x + c)), zero);
+            __m128i coefficients = _mm_set1_epi32(t[c]);
+            lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, zero), coefficients));
+            hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, zero), coefficients));
+        }
+        int sums[8];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(sums), lo);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(sums + 4), hi);
+        for (int k = 0; k < 8; ++k)
+            acc[x - x0 + k] += sums[k];
+    }
+#endif
+    for (; x < x1; ++x)
+    {
+        long long sum = 0;
+        for (unsigned int c = 0; c < templateWidth; ++c)
+            sum += in[x + c] * t[c];
+        acc[x - x0] += sum;
+    }
+}
+
+/**
+ * Computes the scores of the positions [x0, x1) x [y0, y1) by direct correlation, in parallel rows.
+ *
+ * The raw correlation with the template is exact in integers; the mean of the template is
+ * removed afterwards through the window sum.
+ */
+static void directScores(const Image &frame, const Image &templ, const TemplateMoments &moments, const IntegralImage &integral,
+                         ScoreMap map, unsigned int x0, unsigned int x1, unsigned int y0, unsigned int y1)
+{
+    unsigned int templateWidth = templ.getWidth();
+    unsigned int templateHeight = templ.getHeight();
+    double area = static_cast<double>(templateWidth) * templateHeight;
+    Parallel::forRows(y0, y1, [&](unsigned int first, unsigned int last)
+                      {
+                          std::vector<long long> acc(x1 - x0);
+                          for (unsigned int y = first; y < last; ++y)
+                          {
+                              std::fill(acc.begin(), acc.end(), 0);
+                              for (unsigned int r = 0; r < templateHeight; ++r)
+                                  correlateRow(frame.getData()[y + r], templ.getData()[r], templateWidth, x0, x1, acc.data());
+                              float *out = map.scores + static_cast<size_t>(y) * map.width;
+                              for (unsigned int x = x0; x < x1; ++x)
+                              {
+                                  Rectangle window(x, y, templateWidth, templateHeight);
+                                  double sum = static_cast<double>(integral.sum(window));
+                                  out[x] = normalize(acc[x - x0] - sum * moments.mean, sum,
+                                                     static_cast<double>(integral.squaredSum(window)), area, moments.norm);
+                              }
+                          }
+                      },
+                      4);
+}
+
+/**
+ * Computes an in-place radix-2 FFT of n values, n being a power of two.
+ *
+ * @param data The values.
+ * @param n The number of values.
+ * @param twiddles The n / 2 roots exp(-2 pi i k / n).
+ * @param inverse True for the inverse transform, without the 1 / n scaling.
+ */
+static void fft(std::complex<double> *data, unsigned int n, const std::vector<std::complex<double>> &twiddles, bool inverse)
+{
+    for (unsigned int i = 1, j = 0; i < n; ++i)
+    {
+        unsigned int bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j)
+            std::swap(data[i], data[j]);
+    }
+    for (unsigned int length = 2; length <= n; length <<= 1)
+    {
+        unsigned int half = length / 2;
+        unsigned int step = n / length;
+        for (unsigned int start = 0; start < n; start += length)
+            for (unsigned int k = 0; k < half; ++k)
+            {
+                std::complex<double> w = inverse ? std::conj(twiddles[k * step]) : twiddles[k * step];
+                std::complex<double> odd = data[start + k + half] * w;
+                data[start + k + half] = data[start + k] - odd;
+                data[start + k] += odd;
+            }
+    }
+}
+
+/**
+ * Returns the n / 2 roots of unity used by fft().
+ */
+static std::vector<std::complex<double>> twiddleFactors(unsigned int n)
+{
+    const double pi = std::acos(-1.0);
+    std::vector<std::complex<double>> twiddles(std::max(n / 2, 1u));
+    for (unsigned int k = 0; k < n / 2; ++k)
+        twiddles[k] = std::polar(1.0, -2.0 * pi * k / n);
+    return twiddles;
+}
+
+/**
+ * Computes the FFT of every column [first, last) of a width x height array, with a column buffer.
+ */
+static void fftColumns(std::complex<double> *data, unsigned int width, unsigned int height, unsigned int first, unsigned int last,
+                       const std::vector<std::complex<double>> &twiddles, bool inverse)
+{
+    std::vector<std::complex<double>> column(height);
+    for (unsigned int x = first; x < last; ++x)
+    {
+        for (unsigned int y = 0; y < height; ++y)
+            column[y] = data[static_cast<size_t>(y) * width + x];
+        fft(column.data(), height, twiddles, inverse);
+        for (unsigned int y = 0; y < height; ++y)
+            data[static_cast<size_t>(y) * width + x] = column[y];
+    }
+}
+
+/**
+ * Computes the scores of every position through the FFT.
+ *
+ * The frame, minus its mean, goes into the real part and the zero-mean template into the
+ * imaginary part of one complex array, so a single forward transform yields both spectra: they
+ * are separated using the symmetry of the transform of real data. The inverse transform of the
+ * frame spectrum times the conjugated template spectrum is the correlation at every position.
+ * The array is padded to powers of two at least as large as the frame, which is enough for the
+ * valid positions never to wrap around.
+ */
+static void fftScores(const Image &frame, const Image &templ, const TemplateMoments &moments, const IntegralImage &integral,
+                      ScoreMap map)
+{
+    unsigned int width = frame.getWidth();
+    unsigned int height = frame.getHeight();
+    unsigned int templateWidth = templ.getWidth();
+    unsigned int templateHeight = templ.getHeight();
+    unsigned int paddedWidth = 1, paddedHeight = 1;
+    while (paddedWidth < width)
+        paddedWidth <<= 1;
+    while (paddedHeight < height)
+        paddedHeight <<= 1;
+    std::vector<std::complex<double>> rowTwiddles = twiddleFactors(paddedWidth);
+    std::vector<std::complex<double>> columnTwiddles = twiddleFactors(paddedHeight);
+
+    double frameMean = static_cast<double>(integral.sum(Rectangle(0, 0, width, height))) / (static_cast<double>(width) * height);
+    std::vector<std::complex<double>> data(static_cast<size_t>(paddedWidth) * paddedHeight);
+    Parallel::forRows(0, height, [&](unsigned int first, unsigned int last)
+                      {
+                          for (unsigned int y = first; y < last; ++y)
+                          {
+                              std::complex<double> *row = &data[static_cast<size_t>(y) * paddedWidth];
+                              const unsigned char *in = frame.getData()[y];
+                              const unsigned char *t = y < templateHeight ? templ.getData()[y] : nullptr;
+                              for (unsigned int x = 0; x < width; ++x)
+                                  row[x] = std::complex<double>(in[x] - frameMean, t && x < templateWidth ? t[x] - moments.mean : 0.0);
+                              fft(row, paddedWidth, rowTwiddles, false);
+                          }
+                      });
+    Parallel::forRows(0, paddedWidth, [&](unsigned int first, unsigned int last)
+                      { fftColumns(data.data(), paddedWidth, paddedHeight, first, last, columnTwiddles, false); });
+
+    // Separate the two spectra and multiply them; the product is Hermitian, so every pair of
+    // symmetric entries is handled once, by the row holding the first of the two.
+    Parallel::forRows(0, paddedHeight, [&](unsigned int first, unsigned int last)
+                      {
+                          for (unsigned int v = first; v < last; ++v)
+                              for (unsigned int u = 0; u < paddedWidth; ++u)
+                              {
+                                  size_t a = static_cast<size_t>(v) * paddedWidth + u;
+                                  size_t b = static_cast<size_t>((paddedHeight - v) % paddedHeight) * paddedWidth + (paddedWidth - u) % paddedWidth;
+                                  if (a > b)
+                                      continue;
+                                  std::complex<double> f = data[a];
+                                  std::complex<double> g = std::conj(data[b]);
+                                  std::complex<double> frameSpectrum = (f + g) * 0.5;
+                                  std::complex<double> templateSpectrum = (f - g) * std::complex<double>(0.0, -0.5);
+                                  std::complex<double> product = frameSpectrum * std::conj(templateSpectrum);
+                                  data[a] = product;
+                                  data[b] = std::conj(product);
+                              }
+                      });
+
+    Parallel::forRows(0, paddedWidth, [&](unsigned int first, unsigned int last)
+                      { fftColumns(data.data(), paddedWidth, paddedHeight, first, last, columnTwiddles, true); });
+
+    double scale = 1.0 / (static_cast<double>(paddedWidth) * paddedHeight);
+    double area = static_cast<double>(templateWidth) * templateHeight;
+    Parallel::forRows(0, map.height, [&](unsigned int first, unsigned int last)
+                      {
+                          for (unsigned int y = first; y < last; ++y)
+                          {
+                              std::complex<double> *row = &data[static_cast<size_t>(y) * paddedWidth];
+                              fft(row, paddedWidth, rowTwiddles, true);
+                              float *out = map.scores + static_cast<size_t>(y) * map.width;
+                              for (unsigned int x = 0; x < map.width; ++x)
+                              {
+                                  Rectangle window(x, y, templateWidth, templateHeight);
+                                  out[x] = normalize(row[x].real() * scale, static_cast<double>(integral.sum(window)),
+                                                     static_cast<double>(integral.squaredSum(window)), area, moments.norm);
+                              }
+                          }
+                      });
+}
+
+/**
+ * Returns the best local maxima of a score map, the best first.
+ *
+ * A position is a local maximum when no neighbour scores higher (ties go to the first one in
+ * raster order). The maxima are then accepted from the best down, skipping those closer than
+ * minDistance, in both directions, to an accepted one.
+ */
+static std::vector<Point> findPeaks(const float *scores, unsigned int width, unsigned int height,
+                                    unsigned int count, float minScore, unsigned int minDistance)
+{
+    std::vector<std::pair<float, Point>> maxima;
+    for (unsigned int y = 0; y < height; ++y)
+    {
+        const float *row = scores + static_cast<size_t>(y) * width;
+        for (unsigned int x = 0; x < width; ++x)
+        {
+            float s = row[x];
+            if (s < minScore)
+                continue;
+            bool maximum = true;
+            for (int dy = -1; dy <= 1 && maximum; ++dy)
+                for (int dx = -1; dx <= 1 && maximum; ++dx)
+                {
+                    long long ny = static_cast<long long>(y) + dy, nx = static_cast<long long>(x) + dx;
+                    if ((dy == 0 && dx == 0) || ny < 0 || nx < 0 || ny >= height || nx >= width)
+                        continue;
+                    float n = scores[ny * width + nx];
+                    bool before = dy < 0 || (dy == 0 && dx < 0);
+                    maximum = before ? n < s : n <= s;
+                }
+            if (maximum)
+                maxima.push_back(std::make_pair(s, Point(x, y)));
+        }
+    }
+    std::stable_sort(maxima.begin(), maxima.end(), [](const std::pair<float, Point> &a, const std::pair<float, Point> &b)
+                     { return a.first > b.first; });
+
+    std::vector<Point> peaks;
+    for (const std::pair<float, Point> &maximum : maxima)
+    {
+        if (peaks.size() >= count)
+            break;
+        bool isolated = true;
+        for (const Point &peak : peaks)
+            if (std::abs(peak.getX() - maximum.second.getX()) <= static_cast<int>(minDistance) &&
+                std::abs(peak.getY() - maximum.second.getY()) <= static_cast<int>(minDistance))
+            {
+                isolated = false;
+                break;
+            }
+        if (isolated)
+            peaks.push_back(maximum.second);
+    }
+    return peaks;
+}
+
+/**
+ * @brief Default constructor for the TemplateMatcher class.
+ * Initializes an exhaustive matcher that switches to the FFT for templates of 2048 pixels or more.
+ */
+TemplateMatcher::TemplateMatcher() : levels{1}, candidates{8}, fftArea{2048}, scoreWidth{0}, scoreHeight{0}, framePyramid(1), templatePyramid(1) {}
+
+/**
+ * @brief Constructs a coarse-to-fine matcher.
+ *
+ * @param levels The number of pyramid levels, 1 for an exhaustive search.
+ * @param candidates The number of candidates refined at every finer level.
+ */
+TemplateMatcher::TemplateMatcher(unsigned int levels, unsigned int candidates)
+    : levels{levels > 0 ? levels : 1}, candidates{candidates > 0 ? candidates : 1}, fftArea{2048}, scoreWidth{0}, scoreHeight{0},
+      framePyramid(levels), templatePyramid(levels) {}
+
+/**
+ * @brief Get the number of pyramid levels.
+ *
+ * @return The number of levels.
+ */
+unsigned int TemplateMatcher::getLevels() const
+{
+    return this->levels;
+}
+
+/**
+ * @brief Sets the number of pyramid levels.
+ *
+ * @param newLevels The new number of levels, 1 for an exhaustive search.
+ */
+void TemplateMatcher::setLevels(unsigned int newLevels)
+{
+    this->levels = newLevels > 0 ? newLevels : 1;
+    this->framePyramid = Pyramid(this->levels);
+    this->templatePyramid = Pyramid(this->levels);
+}
+
+/**
+ * @brief Get the number of candidates refined at every finer level.
+ *
+ * @return The number of candidates.
+ */
+unsigned int TemplateMatcher::getCandidates() const
+{
+    return this->candidates;
+}
+
+/**
+ * @brief Sets the number of candidates refined at every finer level.
+ *
+ * @param newCandidates The new number of candidates.
+ */
+void TemplateMatcher::setCandidates(unsigned int newCandidates)
+{
+    this->candidates = newCandidates > 0 ? newCandidates : 1;
+}
+
+/**
+ * @brief Get the template area from which the FFT is used.
+ *
+ * @return The area, in pixels.
+ */
+unsigned int TemplateMatcher::getFftArea() const
+{
+    return this->fftArea;
+}
+
+/**
+ * @brief Sets the template area from which the FFT is used.
+ *
+ * @param newArea The new area, in pixels.
+ */
+void TemplateMatcher::setFftArea(unsigned int newArea)
+{
+    this->fftArea = newArea;
+}
+
+/**
+ * Computes the score map of a template over a frame.
+ *
+ * For a coarse-to-fine search, the coarsest level used is the last one where the template is
+ * still at least 8 pixels wide and high. Its full score map gives the first candidates; at every
+ * finer level, only the 5x5 positions around each doubled candidate are scored, and the best
+ * of them become the candidates of the next level.
+ *
+ * @param frame The frame to search.
+ * @param templ The template, not larger than the frame.
+ */
+void TemplateMatcher::matchTemplate(const Image &frame, const Image &templ)
+{
+    if (templ.getWidth() == 0 || templ.getHeight() == 0)
+        throw std::invalid_argument("The template is empty!");
+    if (templ.getWidth() > frame.getWidth() || templ.getHeight() > frame.getHeight())
+        throw std::invalid_argument("The template is larger than the frame!");
+
+    this->scoreWidth = frame.getWidth() - templ.getWidth() + 1;
+    this->scoreHeight = frame.getHeight() - templ.getHeight() + 1;
+    this->scores.assign(static_cast<size_t>(this->scoreWidth) * this->scoreHeight, -1.0f);
+
+    unsigned int top = 0;
+    if (this->levels > 1)
+    {
+        this->templatePyramid.build(templ);
+        while (top + 1 < this->templatePyramid.getLevels() && this->templatePyramid.getLevelSize(top + 1).getWidth() >= 8 &&
+               this->templatePyramid.getLevelSize(top + 1).getHeight() >= 8)
+            ++top;
+        if (top > 0)
+            this->framePyramid.build(frame);
+    }
+
+    Image levelFrame, levelTemplate;
+    std::vector<float> levelScores;
+    std::vector<Point> found;
+    for (unsigned int level = top + 1; level-- > 0;)
+    {
+        if (level > 0)
+        {
+            this->framePyramid.getLevel(level, levelFrame);
+            this->templatePyramid.getLevel(level, levelTemplate);
+        }
+        const Image &f = level > 0 ? levelFrame : frame;
+        const Image &t = level > 0 ? levelTemplate : templ;
+        ScoreMap map;
+        map.width = f.getWidth() - t.getWidth() + 1;
+        map.height = f.getHeight() - t.getHeight() + 1;
+        if (level > 0)
+        {
+            levelScores.assign(static_cast<size_t>(map.width) * map.height, -1.0f);
+            map.scores = levelScores.data();
+        }
+        else
+            map.scores = this->scores.data();
+
+        this->integral.compute(f);
+        TemplateMoments moments = templateMoments(t);
+        if (level == top)
+        {
+            if (static_cast<unsigned long long>(t.getWidth()) * t.getHeight() >= this->fftArea)
+                fftScores(f, t, moments, this->integral, map);
+            else
+                directScores(f, t, moments, this->integral, map, 0, map.width, 0, map.height);
+        }
+        else
+        {
+            for (const Point &candidate : found)
+            {
+                unsigned int x0 = static_cast<unsigned int>(std::max(2 * candidate.getX() - 2, 0));
+                unsigned int y0 = static_cast<unsigned int>(std::max(2 * candidate.getY() - 2, 0));
+                unsigned int x1 = std::min(static_cast<unsigned int>(2 * candidate.getX() + 3), map.width);
+                unsigned int y1 = std::min(static_cast<unsigned int>(2 * candidate.getY() + 3), map.height);
+                if (x0 < x1 && y0 < y1)
+                    directScores(f, t, moments, this->integral, map, x0, x1, y0, y1);
+            }
+        }
+        if (level > 0)
+            found = findPeaks(map.scores, map.width, map.height, this->candidates, -1.0f, 2);
+    }
+}
+
+/**
+ * @brief Returns the size of the score map.
+ *
+ * @return The size, (frame width - template width + 1) x (frame height - template height + 1).
+ */
+Size TemplateMatcher::scoreSize() const
+{
+    return Size(this->scoreWidth, this->scoreHeight);
+}
+
+/**
+ * @brief Returns the score of a position.
+ *
+ * @param row The row of the top-left pixel of the template.
+ * @param column The column of the top-left pixel of the template.
+ * @return The score, from -1 to 1.
+ */
+float TemplateMatcher::score(unsigned int row, unsigned int column) const
+{
+    return this->scores[static_cast<size_t>(row) * this->scoreWidth + column];
+}
+
+/**
+ * @brief Returns the scores of one row.
+ *
+ * @param row The row.
+ * @return A pointer to the scores of the row.
+ */
+const float *TemplateMatcher::scoreRow(unsigned int row) const
+{
+    return &this->scores[static_cast<size_t>(row) * this->scoreWidth];
+}
+
+/**
+ * @brief Converts the score map to an image, mapping -1 to 0 and 1 to 255.
+ *
+ * @param dst The score image.
+ */
+void TemplateMatcher::getScores(Image &dst) const
+{
+    Image output(this->scoreWidth, this->scoreHeight);
+    for (unsigned int i = 0; i < this->scoreHeight; ++i)
+    {
+        const float *in = scoreRow(i);
+        unsigned char *out = output.row(i);
+        for (unsigned int j = 0; j < this->scoreWidth; ++j)
+            out[j] = static_cast<unsigned char>((in[j] + 1.0f) * 127.5f + 0.5f);
+    }
+    dst = output;
+}
+
+/**
+ * @brief Returns the best local maxima of the score map.
+ *
+ * @param count The maximum number of peaks.
+ * @param minScore The lowest accepted score.
+ * @param minDistance The distance a peak must keep from every better peak, in both directions.
+ * @return The top-left positions of the matches, the best first, with x the column and y the
+ * row: the score of a peak p is score(p.getY(), p.getX()).
+ */
+std::vector<Point> TemplateMatcher::peaks(unsigned int count, float minScore, unsigned int minDistance) const
+{
+    return findPeaks(this->scores.data(), this->scoreWidth, this->scoreHeight, count, minScore, minDistance);
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include <vector>
+#include "Image.h"
+#include "IntegralImage.h"
+#include "Pyramid.h"
+
+/**
+ * @class TemplateMatcher
+ * @brief Locates a template in a frame with the normalized cross-correlation.
+ *
+ * The score of every position is the correlation coefficient between the template and the
+ * frame window at that position, from -1 to 1. The numerator is computed either directly, with
+ * SIMD multiply-adds, for small templates, or through a single complex FFT of the frame and the
+ * template packed together for large ones. The window sums needed by the normalization are read
+ * from the integral images of the frame, so they cost a constant time per position.
+ *
+ * With more than one level, the search is coarse-to-fine: the full score map is only computed at
+ * the coarsest level of a Gaussian pyramid, and the best candidates are then refined in small
+ * windows at every finer level. Positions that were never evaluated keep a score of -1.
+ */
+class TemplateMatcher
+{
+private:
+    unsigned int levels;       ///< The number of pyramid levels, 1 for an exhaustive search.
+    unsigned int candidates;   ///< The number of candidates refined at every finer level.
+    unsigned int fftArea;      ///< The template area from which the FFT is used.
+    unsigned int scoreWidth;   ///< The width of the score map.
+    unsigned int scoreHeight;  ///< The height of the score map.
+    std::vector<float> scores; ///< The score of every position, row after row.
+    IntegralImage integral;    ///< The integral images of the frame being searched.
+    Pyramid framePyramid;      ///< The pyramid of the frame for coarse-to-fine searches.
+    Pyramid templatePyramid;   ///< The pyramid of the template for coarse-to-fine searches.
+
+public:
+    /**
+     * @brief Default constructor.
+     *
+     * Initializes an exhaustive matcher that switches to the FFT for templates of 2048 pixels or more.
+     */
+    TemplateMatcher();
+
+    /**
+     * @brief Constructs a coarse-to-fine matcher.
+     *
+     * @param levels The number of pyramid levels, 1 for an exhaustive search.
+     * @param candidates The number of candidates refined at every finer level.
+     */
+    TemplateMatcher(unsigned int levels, unsigned int candidates = 8);
+
+    /**
+     * @brief Get the number of pyramid levels.
+     *
+     * @return The number of levels.
+     */
+    unsigned int getLevels() const;
+
+    /**
+     * @brief Sets the number of pyramid levels.
+     *
+     * @param newLevels The new number of levels, 1 for an exhaustive search.
+     */
+    void setLevels(unsigned int newLevels);
+
+    /**
+     * @brief Get the number of candidates refined at every finer level.
+     *
+     * @return The number of candidates.
+     */
+    unsigned int getCandidates() const;
+
+    /**
+     * @brief Sets the number of candidates refined at every finer level.
+     *
+     * @param newCandidates The new number of candidates.
+     */
+    void setCandidates(unsigned int newCandidates);
+
+    /**
+     * @brief Get the template area from which the FFT is used.
+     *
+     * @return The area, in pixels.
+     */
+    unsigned int getFftArea() const;
+
+    /**
+     * @brief Sets the template area from which the FFT is used.
+     *
+     * @param newArea The new area, in pixels.
+     */
+    void setFftArea(unsigned int newArea);
+
+    /**
+     * @brief Computes the score map of a template over a frame, replacing the current one.
+     *
+     * @param frame The frame to search.
+     * @param templ The template, not larger than the frame.
+     */
+    void matchTemplate(const Image &frame, const Image &templ);
+
+    /**
+     * @brief Returns the size of the score map.
+     *
+     * @return The size, (frame width - template width + 1) x (frame height - template height + 1).
+     */
+    Size scoreSize() const;
+
+    /**
+     * @brief Returns the score of a position.
+     *
+     * @param row The row of the top-left pixel of the template.
+     * @param column The column of the top-left pixel of the template.
+     * @return The score, from -1 to 1.
+     */
+    float score(unsigned int row, unsigned int column) const;
+
+    /**
+     * @brief Returns the scores of one row.
+     *
+     * @param row The row.
+     * @return A pointer to the scores of the row.
+     */
+    const float *scoreRow(unsigned int row) const;
+
+    /**
+     * @brief Converts the score map to an image, mapping -1 to 0 and 1 to 255.
+     *
+     * @param dst The score image.
+     */
+    void getScores(Image &dst) const;
+
+    /**
+     * @brief Returns the best local maxima of the score map.
+     *
+     * @param count The maximum number of peaks.
+     * @param minScore The lowest accepted score.
+     * @param minDistance The distance a peak must keep from every better peak, in both directions.
+     * @return The top-left positions of the matches, the best first, with x the column and y the
+     * row: the score of a peak p is score(p.getY(), p.getX()).
+     */
+    std::vector<Point> peaks(unsigned int count, float minScore = 0.0f, unsigned int minDistance = 0) const;
+};
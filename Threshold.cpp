@@ -0,0 +1,413 @@
+#include <algorithm>
+#include <cmath>
+#include "Threshold.h"
+#include "Parallel.h"
+#include "Simd.h"
+#include "ImageMetrics.h"
+#include "Trace.h"
+
+/**
+ * Writes 255 for every pixel of a row above the matching threshold and 0 for the others.
+ *
+ * @param in The width pixels of the row.
+ * @param thresholds The width thresholds, which may lie outside of 0-255.
+ * @param width The width of the row.
+ * @param out The width output bytes.
+ */
+static void compareRow(const unsigned char *in, const int *thresholds, unsigned int width, unsigned char *out)
+{
+    unsigned int j = 0;
+#ifdef IMAGE_PROCESSING_SSE2
+    const __m128i zero = _mm_setzero_si128();
+    for (; j + 16 <= width; j += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + j));
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+        const __m128i *t = reinterpret_cast<const __m128i *>(thresholds + j);
+        __m128i c0 = _mm_cmpgt_epi32(_mm_unpacklo_epi16(lo, zero), _mm_loadu_si128(t));
+        __m128i c1 = _mm_cmpgt_epi32(_mm_unpackhi_epi16(lo, zero), _mm_loadu_si128(t + 1));
+        __m128i c2 = _mm_cmpgt_epi32(_mm_unpacklo_epi16(hi, zero), _mm_loadu_si128(t + 2));
+        __m128i c3 = _mm_cmpgt_epi32(_mm_unpackhi_epi16(hi, zero), _mm_loadu_si128(t + 3));
+        __m128i packed = _mm_packs_epi16(_mm_packs_epi32(c0, c1), _mm_packs_epi32(c2, c3));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + j), packed);
+    }
+#endif
+    for (; j < width; ++j)
+        out[j] = in[j] > thresholds[j] ? 255 : 0;
+}
+
+/**
+ * Returns the largest integer not greater than a / b, for b > 0.
+ */
+static inline long long floorDivide(long long a, long long b)
+{
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+/**
+ * @brief Default constructor for the Threshold class.
+ * Initializes a fixed threshold of 127.
+ */
+Threshold::Threshold() : method{BINARY}, threshold{127}, blockSize{15}, offset{5} {}
+
+/**
+ * @brief Constructs a fixed threshold.
+ *
+ * @param threshold The threshold.
+ */
+Threshold::Threshold(unsigned char threshold) : method{BINARY}, threshold{threshold}, blockSize{15}, offset{5} {}
+
+/**
+ * @brief Constructs a threshold with the specified method.
+ *
+ * @param method The way to choose the threshold of a pixel.
+ * @param blockSize The side of the blocks of the adaptive methods, rounded up to an odd value.
+ * @param offset The value subtracted from the local means of the adaptive methods.
+ */
+Threshold::Threshold(Method method, unsigned int blockSize, int offset) : method{method}, threshold{127}, offset{offset}
+{
+    setBlockSize(blockSize);
+}
+
+/**
+ * @brief Get the method.
+ *
+ * @return The method.
+ */
+Threshold::Method Threshold::getMethod() const
+{
+    return this->method;
+}
+
+/**
+ * @brief Sets the method.
+ *
+ * @param newMethod The new method.
+ */
+void Threshold::setMethod(Method newMethod)
+{
+    this->method = newMethod;
+}
+
+/**
+ * @brief Get the global threshold.
+ *
+ * @return The threshold, the one found for the last processed image with OTSU.
+ */
+unsigned char Threshold::getThreshold() const
+{
+    return this->threshold;
+}
+
+/**
+ * @brief Sets the global threshold used by BINARY.
+ *
+ * @param newThreshold The new threshold.
+ */
+void Threshold::setThreshold(unsigned char newThreshold)
+{
+    this->threshold = newThreshold;
+}
+
+/**
+ * @brief Get the side of the blocks of the adaptive methods.
+ *
+ * @return The block size.
+ */
+unsigned int Threshold::getBlockSize() const
+{
+    return this->blockSize;
+}
+
+/**
+ * @brief Sets the side of the blocks of the adaptive methods.
+ *
+ * @param newBlockSize The new block size, rounded up to an odd value.
+ */
+void Threshold::setBlockSize(unsigned int newBlockSize)
+{
+    this->blockSize = newBlockSize | 1;
+    this->gaussian.clear();
+}
+
+/**
+ * @brief Get the value subtracted from the local means of the adaptive methods.
+ *
+ * @return The offset.
+ */
+int Threshold::getOffset() const
+{
+    return this->offset;
+}
+
+/**
+ * @brief Sets the value subtracted from the local means of the adaptive methods.
+ *
+ * @param newOffset The new offset.
+ */
+void Threshold::setOffset(int newOffset)
+{
+    this->offset = newOffset;
+}
+
+/**
+ * Finds the threshold that best separates a histogram in two classes (Otsu's method).
+ *
+ * Every split is scored by its between-class variance, up to a constant factor, from running
+ * sums of the counts and of the intensities, so a single sweep over the bins is enough.
+ *
+ * @param histogram The histogram.
+ * @return The largest value of the lower class.
+ */
+unsigned char Threshold::otsu(const Histogram &histogram)
+{
+    double total = static_cast<double>(histogram.total());
+    double sumAll = 0;
+    for (unsigned int v = 0; v < 256; ++v)
+        sumAll += static_cast<double>(v) * histogram[v];
+
+    double lowerCount = 0, lowerSum = 0, best = -1;
+    unsigned char threshold = 0;
+    for (unsigned int t = 0; t < 256; ++t)
+    {
+        lowerCount += histogram[t];
+        lowerSum += static_cast<double>(t) * histogram[t];
+        double upperCount = total - lowerCount;
+        if (lowerCount == 0)
+            continue;
+        if (upperCount == 0)
+            break;
+        double difference = lowerSum * total - sumAll * lowerCount;
+        double score = difference * difference / (lowerCount * upperCount);
+        if (score > best)
+        {
+            best = score;
+            threshold = static_cast<unsigned char>(t);
+        }
+    }
+    return threshold;
+}
+
+/**
+ * Computes what the thresholds of the next image depend on: the threshold of Otsu's method, the
+ * integral images for the adaptive mean or the Gaussian weights.
+ *
+ * The Gaussian weights use the standard deviation 0.3 * ((blockSize - 1) / 2 - 1) + 0.8 and are
+ * rounded to 1/256 units, the center weight absorbing the rounding error so they sum to 256.
+ *
+ * @param src The next image.
+ */
+void Threshold::prepare(const Image &src)
+{
+    switch (this->method)
+    {
+    case OTSU:
+        this->threshold = otsu(Histogram(src));
+        break;
+    case ADAPTIVE_MEAN:
+        this->integral.compute(src);
+        break;
+    case ADAPTIVE_GAUSSIAN:
+        if (this->gaussian.size() != this->blockSize)
+        {
+            int radius = static_cast<int>(this->blockSize / 2);
+            double sigma = 0.3 * (radius - 1) + 0.8;
+            std::vector<double> weights(this->blockSize);
+            double total = 0;
+            for (int k = -radius; k <= radius; ++k)
+                total += weights[k + radius] = std::exp(-k * k / (2 * sigma * sigma));
+            this->gaussian.resize(this->blockSize);
+            int sum = 0;
+            for (unsigned int k = 0; k < this->blockSize; ++k)
+                sum += this->gaussian[k] = static_cast<int>(weights[k] / total * 256 + 0.5);
+            this->gaussian[radius] += 256 - sum;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Binarizes one row.
+ *
+ * The global methods compare the pixels to one threshold directly, 16 at a time. The adaptive
+ * methods first compute the threshold of every pixel of the row, then compare the pixels with
+ * their own thresholds. The blocks of the adaptive mean are clipped to the image, while the
+ * Gaussian replicates the border pixels; its vertical pass runs over whole rows, so it is
+ * vectorized by the compiler.
+ *
+ * @param src The source image.
+ * @param i The row.
+ * @param out The width output bytes, 255 or 0.
+ * @param scratch Scratch space for the adaptive methods, grown as needed.
+ */
+void Threshold::binarizeRow(const Image &src, unsigned int i, unsigned char *out, std::vector<int> &scratch) const
+{
+    unsigned int width = src.getWidth();
+    unsigned int height = src.getHeight();
+    const unsigned char *in = src.getData()[i];
+    if (width == 0)
+        return;
+
+    if (this->method == BINARY || this->method == OTSU)
+    {
+        unsigned int j = 0;
+#ifdef IMAGE_PROCESSING_SSE2
+        // Flipping the top bit turns the unsigned comparison into a signed one.
+        const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+        const __m128i threshold = _mm_set1_epi8(static_cast<char>(this->threshold ^ 0x80));
+        for (; j + 16 <= width; j += 16)
+        {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(in + j)), bias);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + j), _mm_cmpgt_epi8(v, threshold));
+        }
+#endif
+        for (; j < width; ++j)
+            out[j] = in[j] > this->threshold ? 255 : 0;
+        return;
+    }
+
+    int radius = static_cast<int>(this->blockSize / 2);
+    scratch.resize(2 * static_cast<size_t>(width) + 2 * radius);
+    int *thresholds = scratch.data();
+    if (this->method == ADAPTIVE_MEAN)
+    {
+        // A pixel above the mean minus the offset is above the floor of it, as pixels are integers.
+        unsigned int top = i > static_cast<unsigned int>(radius) ? i - radius : 0;
+        unsigned int bottom = std::min(i + radius + 1, height);
+        for (unsigned int j = 0; j < width; ++j)
+        {
+            unsigned int left = j > static_cast<unsigned int>(radius) ? j - radius : 0;
+            unsigned int right = std::min(j + radius + 1, width);
+            long long area = static_cast<long long>(right - left) * (bottom - top);
+            long long sum = static_cast<long long>(this->integral.sum(Rectangle(left, top, right - left, bottom - top)));
+            thresholds[j] = static_cast<int>(std::max(std::min(floorDivide(sum - this->offset * area, area), 255LL), -1LL));
+        }
+    }
+    else
+    {
+        int *columns = thresholds + width;
+        std::fill(columns + radius, columns + radius + width, 0);
+        for (int k = -radius; k <= radius; ++k)
+        {
+            int y = std::min(std::max(static_cast<int>(i) + k, 0), static_cast<int>(height) - 1);
+            const unsigned char *row = src.getData()[y];
+            int weight = this->gaussian[k + radius];
+            for (unsigned int j = 0; j < width; ++j)
+                columns[radius + j] += weight * row[j];
+        }
+        for (int k = 0; k < radius; ++k)
+        {
+            columns[k] = columns[radius];
+            columns[radius + width + k] = columns[radius + width - 1];
+        }
+        for (unsigned int j = 0; j < width; ++j)
+        {
+            int sum = 0;
+            for (int k = 0; k <= 2 * radius; ++k)
+                sum += this->gaussian[k] * columns[j + k];
+            thresholds[j] = ((sum + (1 << 15)) >> 16) - this->offset;
+        }
+    }
+    compareRow(in, thresholds, width, out);
+}
+
+/**
+ * Binarizes the source image, in parallel row bands.
+ *
+ * @param src The source image.
+ * @param dst The binary image, with 255 for the pixels above their threshold and 0 for the others.
+ */
+void Threshold::process(const Image &src, Image &dst)
+{
+    TRACE_SCOPE("Threshold::process", "process");
+    ImageMetrics::Site site("Threshold::process");
+    if (&src == &dst)
+    {
+        Image copy(src);
+        process(copy, dst);
+        return;
+    }
+    prepare(src);
+    dst.create(src.getWidth(), src.getHeight());
+    unsigned char **out = dst.getData();
+    Parallel::forRows(0, src.getHeight(), [&](unsigned int first, unsigned int last)
+                      {
+                          std::vector<int> scratch;
+                          for (unsigned int i = first; i < last; ++i)
+                              binarizeRow(src, i, out[i], scratch);
+                      });
+}
+
+/**
+ * Binarizes a batch of images, spread across the threads of the pool.
+ *
+ * The fixed threshold and the Gaussian weights are the same for every image, so they are prepared
+ * once, and every thread binarizes its run of images straight into dst with its own scratch
+ * buffer; an image binarized into itself is first copied to a source image kept by the thread.
+ * Otsu's method and the adaptive mean prepare state from each image, so with them the images are
+ * binarized one after another, each in parallel row bands.
+ *
+ * @param src The source images.
+ * @param dst The binary images.
+ */
+void Threshold::processBatch(const std::vector<Image> &src, std::vector<Image> &dst)
+{
+    TRACE_SCOPE("Threshold::processBatch", "process");
+    ImageMetrics::Site site("Threshold::processBatch");
+    dst.resize(src.size());
+    if (this->method == OTSU || this->method == ADAPTIVE_MEAN)
+    {
+        for (size_t i = 0; i < src.size(); ++i)
+            process(src[i], dst[i]);
+        return;
+    }
+    if (!src.empty())
+        prepare(src[0]);
+    Parallel::forRows(0, static_cast<unsigned int>(src.size()), [&](unsigned int first, unsigned int last)
+                      {
+                          std::vector<int> scratch;
+                          Image copy;
+                          for (unsigned int i = first; i < last; ++i)
+                          {
+                              const Image *in = &src[i];
+                              if (in == &dst[i])
+                              {
+                                  copy = src[i];
+                                  in = &copy;
+                              }
+                              dst[i].create(in->getWidth(), in->getHeight());
+                              unsigned char **out = dst[i].getData();
+                              for (unsigned int y = 0; y < in->getHeight(); ++y)
+                                  binarizeRow(*in, y, out[y], scratch);
+                          }
+                      },
+                      1);
+}
+
+/**
+ * Binarizes the source image into a bit-packed mask, in parallel row bands. Every row is
+ * binarized into a small buffer and packed right away, so no full-size byte image is needed.
+ *
+ * @param src The source image.
+ * @param dst The mask, with the pixels above their threshold set.
+ */
+void Threshold::process(const Image &src, BitMask &dst)
+{
+    TRACE_SCOPE("Threshold::process", "process");
+    ImageMetrics::Site site("Threshold::process");
+    prepare(src);
+    dst.resize(src.getWidth(), src.getHeight());
+    Parallel::forRows(0, src.getHeight(), [&](unsigned int first, unsigned int last)
+                      {
+                          std::vector<int> scratch;
+                          std::vector<unsigned char> row(src.getWidth());
+                          for (unsigned int i = first; i < last; ++i)
+                          {
+                              binarizeRow(src, i, row.data(), scratch);
+                              BitMask::packRow(row.data(), src.getWidth(), dst.row(i));
+                          }
+                      });
+}
@@ -0,0 +1,171 @@
+#pragma once
+#include <vector>
+#include "BitMask.h"
+#include "Histogram.h"
+#include "ImageProcessing.h"
+#include "IntegralImage.h"
+
+/**
+ * @class Threshold
+ * @brief A class that represents the binarization of an image.
+ *
+ * A pixel is set (255) when it is strictly greater than its threshold and cleared (0) otherwise.
+ * The threshold is either global, fixed or chosen with Otsu's method from the histogram of the
+ * image, or local: the mean of the block around the pixel, read from the integral image, or its
+ * Gaussian-weighted mean, minus an offset.
+ *
+ * The comparison is done 16 pixels at a time with SIMD instructions. The result can also be
+ * written to a BitMask, which takes one bit per pixel instead of one byte.
+ */
+class Threshold : public ImageProcessing
+{
+public:
+    /**
+     * @brief The ways to choose the threshold of a pixel.
+     */
+    enum Method
+    {
+        BINARY,           ///< One fixed threshold for the whole image.
+        OTSU,             ///< One threshold for the whole image, chosen with Otsu's method.
+        ADAPTIVE_MEAN,    ///< The mean of the block around the pixel, minus the offset.
+        ADAPTIVE_GAUSSIAN ///< The Gaussian-weighted mean of the block around the pixel, minus the offset.
+    };
+
+private:
+    Method method;             ///< The way to choose the threshold of a pixel.
+    unsigned char threshold;   ///< The global threshold, set by Otsu's method for OTSU.
+    unsigned int blockSize;    ///< The odd side of the blocks of the adaptive methods.
+    int offset;                ///< The value subtracted from the local means of the adaptive methods.
+    IntegralImage integral;    ///< The integral images used by ADAPTIVE_MEAN.
+    std::vector<int> gaussian; ///< The Q8 Gaussian weights used by ADAPTIVE_GAUSSIAN.
+
+public:
+    /**
+     * @brief Default constructor.
+     *
+     * Initializes a fixed threshold of 127.
+     */
+    Threshold();
+
+    /**
+     * @brief Constructs a fixed threshold.
+     *
+     * @param threshold The threshold.
+     */
+    Threshold(unsigned char threshold);
+
+    /**
+     * @brief Constructs a threshold with the specified method.
+     *
+     * @param method The way to choose the threshold of a pixel.
+     * @param blockSize The side of the blocks of the adaptive methods, rounded up to an odd value.
+     * @param offset The value subtracted from the local means of the adaptive methods.
+     */
+    Threshold(Method method, unsigned int blockSize = 15, int offset = 5);
+
+    /**
+     * @brief Get the method.
+     *
+     * @return The method.
+     */
+    Method getMethod() const;
+
+    /**
+     * @brief Sets the method.
+     *
+     * @param newMethod The new method.
+     */
+    void setMethod(Method newMethod);
+
+    /**
+     * @brief Get the global threshold.
+     *
+     * @return The threshold, the one found for the last processed image with OTSU.
+     */
+    unsigned char getThreshold() const;
+
+    /**
+     * @brief Sets the global threshold used by BINARY.
+     *
+     * @param newThreshold The new threshold.
+     */
+    void setThreshold(unsigned char newThreshold);
+
+    /**
+     * @brief Get the side of the blocks of the adaptive methods.
+     *
+     * @return The block size.
+     */
+    unsigned int getBlockSize() const;
+
+    /**
+     * @brief Sets the side of the blocks of the adaptive methods.
+     *
+     * @param newBlockSize The new block size, rounded up to an odd value.
+     */
+    void setBlockSize(unsigned int newBlockSize);
+
+    /**
+     * @brief Get the value subtracted from the local means of the adaptive methods.
+     *
+     * @return The offset.
+     */
+    int getOffset() const;
+
+    /**
+     * @brief Sets the value subtracted from the local means of the adaptive methods.
+     *
+     * @param newOffset The new offset.
+     */
+    void setOffset(int newOffset);
+
+    /**
+     * @brief Binarizes the source image.
+     *
+     * @param src The source image.
+     * @param dst The binary image, with 255 for the pixels above their threshold and 0 for the others.
+     */
+    void process(const Image &src, Image &dst) override;
+
+    /**
+     * @brief Binarizes a batch of images.
+     *
+     * @param src The source images.
+     * @param dst The binary images.
+     */
+    void processBatch(const std::vector<Image> &src, std::vector<Image> &dst) override;
+
+    /**
+     * @brief Binarizes the source image into a bit-packed mask.
+     *
+     * @param src The source image.
+     * @param dst The mask, with the pixels above their threshold set.
+     */
+    void process(const Image &src, BitMask &dst);
+
+    /**
+     * @brief Finds the threshold that best separates a histogram in two classes (Otsu's method).
+     *
+     * @param histogram The histogram.
+     * @return The largest value of the lower class.
+     */
+    static unsigned char otsu(const Histogram &histogram);
+
+private:
+    /**
+     * @brief Computes what the thresholds of the next image depend on.
+     *
+     * @param src The next image.
+     */
+    void prepare(const Image &src);
+
+    /**
+     * @brief Binarizes one row.
+     *
+     * @param src The source image.
+     * @param i The row.
+     * @param out The width output bytes, 255 or 0.
+     * @param scratch Scratch space for the adaptive methods, grown as needed.
+     */
+    void binarizeRow(const Image &src, unsigned int i, unsigned char *out, std::vector<int> &scratch) const;
+};
@@ -0,0 +1,249 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <vector>
+#include "Trace.h"
+
+std::atomic<bool> Trace::enabled{false};
+
+namespace
+{
+const std::uint64_t CAPACITY = 1 << 16; ///< The number of events kept per thread.
+
+/**
+ * A recorded scope. The fields are atomic so that a dump may read a slot the thread is
+ * overwriting; such slots are detected and dropped.
+ */
+struct Event
+{
+    std::atomic<const char *> name;     ///< The name of the scope.
+    std::atomic<const char *> category; ///< The category of the scope.
+    std::atomic<std::uint64_t> start;   ///< The start of the scope in nanoseconds.
+    std::atomic<std::uint64_t> end;     ///< The end of the scope in nanoseconds.
+};
+
+/**
+ * The ring buffer of one thread. Only the thread writes events. Before it stores the fields of
+ * event i it publishes i + 1 in writing, behind a release fence, and after them i + 1 in head, so
+ * a dump reads the latest CAPACITY events below head and, from writing, learns which of the
+ * slots it copied may have been overwritten meanwhile.
+ */
+struct Buffer
+{
+    std::atomic<std::uint64_t> head{0};    ///< The number of events ever recorded.
+    std::atomic<std::uint64_t> writing{0}; ///< One past the event being written, or the last one written.
+    std::atomic<std::uint64_t> cleared{0}; ///< The number of events recorded before the last clear().
+    unsigned int thread = 0;               ///< The id of the thread in the trace.
+    std::string name;                      ///< The name of the thread, guarded by the registry mutex.
+    Event events[CAPACITY];                ///< The events, event i in slot i % CAPACITY.
+};
+
+/**
+ * The buffers of every thread that recorded an event. They are never freed, so that the events
+ * of threads that exited can still be written.
+ */
+struct Registry
+{
+    std::mutex mutex;
+    std::vector<Buffer *> buffers;
+};
+
+Registry &registry()
+{
+    static Registry *instance = new Registry();
+    return *instance;
+}
+
+/**
+ * Returns the buffer of the calling thread, registering it on first use.
+ */
+Buffer &localBuffer()
+{
+    thread_local Buffer *buffer = nullptr;
+    if (buffer == nullptr)
+    {
+        buffer = new Buffer();
+        Registry &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        buffer->thread = static_cast<unsigned int>(r.buffers.size()) + 1;
+        r.buffers.push_back(buffer);
+    }
+    return *buffer;
+}
+
+/**
+ * Appends a string to JSON, escaping it.
+ */
+void appendString(std::string &json, const char *text)
+{
+    json += '"';
+    for (; *text != '\0'; ++text)
+    {
+        if (*text == '"' || *text == '\\')
+            json += '\\';
+        if (static_cast<unsigned char>(*text) >= 0x20)
+            json += *text;
+    }
+    json += '"';
+}
+
+/**
+ * Appends a time in nanoseconds to JSON in microseconds, the unit of the trace-event format.
+ */
+void appendMicroseconds(std::string &json, std::uint64_t nanoseconds)
+{
+    char text[32];
+    std::snprintf(text, sizeof(text), "%llu.%03u", static_cast<unsigned long long>(nanoseconds / 1000),
+                  static_cast<unsigned int>(nanoseconds % 1000));
+    json += text;
+}
+} // namespace
+
+/**
+ * @brief Turns the recording of scopes on or off.
+ *
+ * @param newEnabled True to record scopes.
+ */
+void Trace::setEnabled(bool newEnabled)
+{
+    enabled.store(newEnabled, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Names the calling thread in the trace.
+ *
+ * @param name The name of the thread.
+ */
+void Trace::setThreadName(const std::string &name)
+{
+    Buffer &buffer = localBuffer();
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    buffer.name = name;
+}
+
+/**
+ * @brief Returns the time elapsed since the first call, on the steady clock.
+ *
+ * @return The time in nanoseconds.
+ */
+std::uint64_t Trace::now()
+{
+    static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+/**
+ * @brief Records a scope in the ring buffer of the calling thread, overwriting its oldest event when full.
+ *
+ * @param name The name of the scope.
+ * @param category The category of the scope.
+ * @param start The start of the scope.
+ * @param end The end of the scope.
+ */
+void Trace::record(const char *name, const char *category, std::uint64_t start, std::uint64_t end)
+{
+    Buffer &buffer = localBuffer();
+    std::uint64_t index = buffer.head.load(std::memory_order_relaxed);
+    Event &event = buffer.events[index % CAPACITY];
+    // A dump that reads any of the fields below then also sees writing, and drops the slot.
+    buffer.writing.store(index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.name.store(name, std::memory_order_relaxed);
+    event.category.store(category, std::memory_order_relaxed);
+    event.start.store(start, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+    buffer.head.store(index + 1, std::memory_order_release);
+}
+
+/**
+ * @brief Drops the events recorded so far by every thread.
+ */
+void Trace::clear()
+{
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (Buffer *buffer : r.buffers)
+        buffer->cleared.store(buffer->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
+
+/**
+ * Returns the events of every thread as Chrome trace-event JSON: a complete ("X") event per
+ * scope and a metadata event naming every thread.
+ *
+ * Threads keep recording while their buffer is read. The events are copied first, and the ones
+ * the thread may have started to overwrite meanwhile, according to the event it was writing
+ * once the copy is done, are dropped. The thread publishes that event before it stores to the
+ * slot, so a copied field of a newer event always comes with a writing value that covers it.
+ *
+ * @return The JSON document.
+ */
+std::string Trace::toJson()
+{
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    Registry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::vector<std::uint64_t> times;
+    std::vector<const char *> names;
+    for (Buffer *buffer : r.buffers)
+    {
+        json += first ? "\n" : ",\n";
+        first = false;
+        json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(buffer->thread) + ",\"args\":{\"name\":";
+        std::string threadName = buffer->name.empty() ? "thread " + std::to_string(buffer->thread) : buffer->name;
+        appendString(json, threadName.c_str());
+        json += "}}";
+
+        std::uint64_t head = buffer->head.load(std::memory_order_acquire);
+        std::uint64_t begin = head > CAPACITY ? head - CAPACITY : 0;
+        begin = std::max(begin, buffer->cleared.load(std::memory_order_relaxed));
+        times.clear();
+        names.clear();
+        for (std::uint64_t i = begin; i < head; ++i)
+        {
+            const Event &event = buffer->events[i % CAPACITY];
+            names.push_back(event.name.load(std::memory_order_relaxed));
+            names.push_back(event.category.load(std::memory_order_relaxed));
+            times.push_back(event.start.load(std::memory_order_relaxed));
+            times.push_back(event.end.load(std::memory_order_relaxed));
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        std::uint64_t writing = buffer->writing.load(std::memory_order_relaxed);
+        // Events up to writing - 1 may have been stored, over the slots of events up to writing - 1 - CAPACITY.
+        std::uint64_t valid = writing >= CAPACITY ? writing - CAPACITY : 0;
+        for (std::uint64_t i = std::max(begin, valid); i < head; ++i)
+        {
+            size_t k = static_cast<size_t>(i - begin) * 2;
+            json += ",\n{\"name\":";
+            appendString(json, names[k]);
+            json += ",\"cat\":";
+            appendString(json, names[k + 1]);
+            json += ",\"ph\":\"X\",\"pid\":1,\"tid\":" + std::to_string(buffer->thread) + ",\"ts\":";
+            appendMicroseconds(json, times[k]);
+            json += ",\"dur\":";
+            appendMicroseconds(json, times[k + 1] - times[k]);
+            json += "}";
+        }
+    }
+    json += "\n]}\n";
+    return json;
+}
+
+/**
+ * @brief Writes the events of every thread as Chrome trace-event JSON.
+ *
+ * @param path The path of the JSON file.
+ * @return True if the file was written.
+ */
+bool Trace::write(const std::string &path)
+{
+    std::ofstream file(path);
+    if (!file.is_open())
+        return false;
+    file << toJson();
+    file.close();
+    return static_cast<bool>(file);
+}
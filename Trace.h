@@ -0,0 +1,128 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/**
+ * @class Trace
+ * @brief Records timed scopes of the library and writes them as Chrome trace-event JSON.
+ *
+ * Operators, image loading, saving and allocation, and the tasks of the thread pool are
+ * instrumented with TRACE_SCOPE. Every thread records into a ring buffer of its own, without
+ * locking, keeping its latest events; write() dumps the events of every thread at any time, in
+ * the trace-event format read by chrome://tracing and Perfetto.
+ *
+ * Tracing is compiled in only when IMAGE_PROCESSING_TRACE is defined, and then still has to be
+ * turned on with setEnabled(). Without the define TRACE_SCOPE expands to nothing; with it, a
+ * disabled scope costs one relaxed atomic load.
+ */
+class Trace
+{
+public:
+    /**
+     * @brief Returns whether scopes are recorded.
+     *
+     * @return True if tracing is on.
+     */
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Turns the recording of scopes on or off.
+     *
+     * @param newEnabled True to record scopes.
+     */
+    static void setEnabled(bool newEnabled);
+
+    /**
+     * @brief Names the calling thread in the trace.
+     *
+     * @param name The name of the thread.
+     */
+    static void setThreadName(const std::string &name);
+
+    /**
+     * @brief Returns the time elapsed since the start of the trace clock.
+     *
+     * @return The time in nanoseconds.
+     */
+    static std::uint64_t now();
+
+    /**
+     * @brief Records a scope of the calling thread.
+     *
+     * @param name The name of the scope, a string that outlives the trace.
+     * @param category The category of the scope, a string that outlives the trace.
+     * @param start The start of the scope, as returned by now().
+     * @param end The end of the scope, as returned by now().
+     */
+    static void record(const char *name, const char *category, std::uint64_t start, std::uint64_t end);
+
+    /**
+     * @brief Drops the events recorded so far.
+     */
+    static void clear();
+
+    /**
+     * @brief Returns the events of every thread as Chrome trace-event JSON.
+     *
+     * @return The JSON document.
+     */
+    static std::string toJson();
+
+    /**
+     * @brief Writes the events of every thread as Chrome trace-event JSON.
+     *
+     * @param path The path of the JSON file.
+     * @return True if the file was written.
+     */
+    static bool write(const std::string &path);
+
+private:
+    static std::atomic<bool> enabled; ///< True while scopes are recorded.
+};
+
+/**
+ * @class TraceScope
+ * @brief Records the lifetime of a scope when tracing is on; used through TRACE_SCOPE.
+ */
+class TraceScope
+{
+private:
+    const char *name;     ///< The name of the scope.
+    const char *category; ///< The category of the scope.
+    std::uint64_t start;  ///< The start of the scope, 0 when tracing was off.
+
+public:
+    /**
+     * @brief Starts the scope.
+     *
+     * @param name The name of the scope, a string that outlives the trace.
+     * @param category The category of the scope, a string that outlives the trace.
+     */
+    TraceScope(const char *name, const char *category)
+        : name{name}, category{category}, start{Trace::isEnabled() ? Trace::now() + 1 : 0} {}
+
+    /**
+     * @brief Ends the scope and records it.
+     */
+    ~TraceScope()
+    {
+        if (this->start != 0)
+            Trace::record(this->name, this->category, this->start - 1, Trace::now());
+    }
+
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+};
+
+#define IMAGE_PROCESSING_TRACE_JOIN(a, b) a##b
+#define IMAGE_PROCESSING_TRACE_NAME(line) IMAGE_PROCESSING_TRACE_JOIN(traceScope, line)
+
+#ifdef IMAGE_PROCESSING_TRACE
+/**
+ * Records the rest of the enclosing block as a scope with the given name and category.
+ */
+#define TRACE_SCOPE(name, category) TraceScope IMAGE_PROCESSING_TRACE_NAME(__LINE__)(name, category)
+#else
+#define TRACE_SCOPE(name, category)
+#endif
@@ -0,0 +1,314 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include "Warp.h"
+#include "Parallel.h"
+#include "ImageMetrics.h"
+#include "Trace.h"
+
+static const unsigned int TILE = 64;               ///< The side of the output tiles, in pixels.
+static const double FIXED_ONE = 65536.0;           ///< 1.0 in 16.16 fixed point.
+static const double COORDINATE_LIMIT = 1 << 28;    ///< Source coordinates beyond this are treated as outside.
+
+/**
+ * Inverts a 3x3 matrix.
+ *
+ * @param m The matrix, row-major.
+ * @param inverse The inverse matrix, row-major, normalized so that its last element is 1 when possible.
+ * @throws std::invalid_argument if the matrix is not invertible.
+ */
+static void invert(const double m[9], double inverse[9])
+{
+    double c0 = m[4] * m[8] - m[5] * m[7];
+    double c1 = m[5] * m[6] - m[3] * m[8];
+    double c2 = m[3] * m[7] - m[4] * m[6];
+    double det = m[0] * c0 + m[1] * c1 + m[2] * c2;
+    if (std::fabs(det) < 1e-12)
+        throw std::invalid_argument("The warp matrix is not invertible!");
+
+    double r[9] = {c0, m[2] * m[7] - m[1] * m[8], m[1] * m[5] - m[2] * m[4],
+                   c1, m[0] * m[8] - m[2] * m[6], m[2] * m[3] - m[0] * m[5],
+                   c2, m[1] * m[6] - m[0] * m[7], m[0] * m[4] - m[1] * m[3]};
+    double scale = std::fabs(r[8]) > 1e-12 ? r[8] : det;
+    for (int k = 0; k < 9; ++k)
+        inverse[k] = r[k] / scale;
+}
+
+/**
+ * @brief Default constructor for the Warp class.
+ * Initializes an identity warp with a 0x0 output size (the size of the source is used).
+ */
+Warp::Warp() : inverse{1, 0, 0, 0, 1, 0, 0, 0, 1}, size{}, interpolation{BILINEAR}, borderValue{0} {}
+
+/**
+ * @brief Constructs a Warp object from a homography.
+ *
+ * @param matrix The 3x3 source-to-destination transform, row-major.
+ * @param size The size of the output image (0x0 keeps the size of the source).
+ * @param interpolation The interpolation method.
+ * @param borderValue The value of output pixels that map outside of the source.
+ * @throws std::invalid_argument if the matrix is not invertible.
+ */
+Warp::Warp(const double matrix[9], Size size, Interpolation interpolation, unsigned char borderValue)
+{
+    setMatrix(matrix);
+    this->size = size;
+    this->interpolation = interpolation;
+    this->borderValue = borderValue;
+}
+
+/**
+ * @brief Creates an affine warp.
+ *
+ * @param matrix The 2x3 source-to-destination transform, row-major.
+ * @param size The size of the output image (0x0 keeps the size of the source).
+ * @param interpolation The interpolation method.
+ * @param borderValue The value of output pixels that map outside of the source.
+ * @return The Warp object.
+ */
+Warp Warp::affine(const double matrix[6], Size size, Interpolation interpolation, unsigned char borderValue)
+{
+    double homography[9] = {matrix[0], matrix[1], matrix[2], matrix[3], matrix[4], matrix[5], 0, 0, 1};
+    return Warp(homography, size, interpolation, borderValue);
+}
+
+/**
+ * @brief Sets the source-to-destination transform.
+ *
+ * @param matrix The 3x3 transform, row-major.
+ * @throws std::invalid_argument if the matrix is not invertible.
+ */
+void Warp::setMatrix(const double matrix[9])
+{
+    invert(matrix, this->inverse);
+}
+
+/**
+ * @brief Get the size of the output image.
+ *
+ * @return The output size.
+ */
+Size Warp::getSize() const
+{
+    return this->size;
+}
+
+/**
+ * @brief Sets the size of the output image.
+ *
+ * @param newSize The new output size.
+ */
+void Warp::setSize(Size newSize)
+{
+    this->size = newSize;
+}
+
+/**
+ * @brief Get the interpolation method.
+ *
+ * @return The interpolation method.
+ */
+Warp::Interpolation Warp::getInterpolation() const
+{
+    return this->interpolation;
+}
+
+/**
+ * @brief Sets the interpolation method.
+ *
+ * @param newInterpolation The new interpolation method.
+ */
+void Warp::setInterpolation(Interpolation newInterpolation)
+{
+    this->interpolation = newInterpolation;
+}
+
+/**
+ * @brief Get the border value.
+ *
+ * @return The value of output pixels that map outside of the source.
+ */
+unsigned char Warp::getBorderValue() const
+{
+    return this->borderValue;
+}
+
+/**
+ * @brief Sets the border value.
+ *
+ * @param newBorderValue The new border value.
+ */
+void Warp::setBorderValue(unsigned char newBorderValue)
+{
+    this->borderValue = newBorderValue;
+}
+
+/**
+ * Computes the source pixels read by the destination tile [x0, x1] x [y0, y1].
+ *
+ * The bounds are returned as a Rectangle in its y-up convention (the top row r maps to y = -r),
+ * so they can be intersected with the source image rectangle. A one pixel margin covers the
+ * second bilinear tap and the rounding of the fixed-point coordinates.
+ *
+ * @return False if the bounds are unknown (a corner maps behind the camera or too far away).
+ */
+static bool sourceBounds(const double m[9], int x0, int y0, int x1, int y1, Rectangle &bounds)
+{
+    double minX = COORDINATE_LIMIT, minY = COORDINATE_LIMIT, maxX = -COORDINATE_LIMIT, maxY = -COORDINATE_LIMIT;
+    const int xs[4] = {x0, x1, x0, x1};
+    const int ys[4] = {y0, y0, y1, y1};
+    for (int k = 0; k < 4; ++k)
+    {
+        double w = m[6] * xs[k] + m[7] * ys[k] + m[8];
+        if (w <= 0)
+            return false;
+        double sx = (m[0] * xs[k] + m[1] * ys[k] + m[2]) / w;
+        double sy = (m[3] * xs[k] + m[4] * ys[k] + m[5]) / w;
+        if (std::fabs(sx) >= COORDINATE_LIMIT || std::fabs(sy) >= COORDINATE_LIMIT)
+            return false;
+        minX = std::min(minX, sx);
+        maxX = std::max(maxX, sx);
+        minY = std::min(minY, sy);
+        maxY = std::max(maxY, sy);
+    }
+    int left = static_cast<int>(std::floor(minX)) - 1;
+    int right = static_cast<int>(std::floor(maxX)) + 2;
+    int top = static_cast<int>(std::floor(minY)) - 1;
+    int bottom = static_cast<int>(std::floor(maxY)) + 2;
+    bounds = Rectangle(left, -top, right - left + 1, bottom - top + 1);
+    return true;
+}
+
+/**
+ * Samples the source at a 16.16 fixed-point position.
+ *
+ * @param checked True if the taps may fall outside of the source.
+ */
+static inline unsigned char sample(unsigned char *const *rows, int width, int height, long long fx, long long fy,
+                                   bool bilinear, bool checked, unsigned char border)
+{
+    if (!bilinear)
+    {
+        int ix = static_cast<int>((fx + 0x8000) >> 16);
+        int iy = static_cast<int>((fy + 0x8000) >> 16);
+        if (checked && (ix < 0 || iy < 0 || ix >= width || iy >= height))
+            return border;
+        return rows[iy][ix];
+    }
+
+    int ix = static_cast<int>(fx >> 16);
+    int iy = static_cast<int>(fy >> 16);
+    int ax = static_cast<int>((fx >> 8) & 0xFF);
+    int ay = static_cast<int>((fy >> 8) & 0xFF);
+    int p00, p01, p10, p11;
+    if (!checked)
+    {
+        p00 = rows[iy][ix];
+        p01 = rows[iy][ix + 1];
+        p10 = rows[iy + 1][ix];
+        p11 = rows[iy + 1][ix + 1];
+    }
+    else
+    {
+        if (ix < -1 || iy < -1 || ix >= width || iy >= height)
+            return border;
+        bool left = ix >= 0, right = ix + 1 < width, up = iy >= 0, down = iy + 1 < height;
+        p00 = (up && left) ? rows[iy][ix] : border;
+        p01 = (up && right) ? rows[iy][ix + 1] : border;
+        p10 = (down && left) ? rows[iy + 1][ix] : border;
+        p11 = (down && right) ? rows[iy + 1][ix + 1] : border;
+    }
+    int top = p00 * (256 - ax) + p01 * ax;
+    int bottom = p10 * (256 - ax) + p11 * ax;
+    return static_cast<unsigned char>((top * (256 - ay) + bottom * ay + (1 << 15)) >> 16);
+}
+
+/**
+ * Warps the source image into the destination image, one 64x64 output tile at a time.
+ *
+ * For every tile the source area it reads is intersected with the source rectangle: a tile
+ * with an empty intersection is filled with the border value, and a tile whose area lies
+ * completely inside the source is sampled without per-pixel bounds checks.
+ *
+ * @param src The source image.
+ * @param dst The warped image.
+ */
+void Warp::process(const Image &src, Image &dst)
+{
+    TRACE_SCOPE("Warp::process", "process");
+    ImageMetrics::Site site("Warp::process");
+    int width = src.getWidth();
+    int height = src.getHeight();
+    unsigned int outWidth = this->size.getWidth() > 0 ? this->size.getWidth() : width;
+    unsigned int outHeight = this->size.getHeight() > 0 ? this->size.getHeight() : height;
+    Image output(outWidth, outHeight);
+
+    const double *m = this->inverse;
+    bool affine = m[6] == 0 && m[7] == 0 && m[8] == 1;
+    bool bilinear = this->interpolation == BILINEAR;
+    unsigned char border = this->borderValue;
+    unsigned char *const *rows = src.getData();
+    unsigned int tilesY = (outHeight + TILE - 1) / TILE;
+
+    Parallel::forRows(0, tilesY, [&](unsigned int first, unsigned int last)
+                      {
+                          Rectangle source(0, 0, width, height);
+                          for (unsigned int ty = first; ty < last; ++ty)
+                          {
+                              unsigned int y0 = ty * TILE;
+                              unsigned int y1 = std::min(y0 + TILE, outHeight);
+                              for (unsigned int x0 = 0; x0 < outWidth; x0 += TILE)
+                              {
+                                  unsigned int x1 = std::min(x0 + TILE, outWidth);
+                                  bool checked = true;
+                                  Rectangle bounds;
+                                  if (sourceBounds(m, x0, y0, x1 - 1, y1 - 1, bounds))
+                                  {
+                                      Rectangle hit = bounds & source;
+                                      if (hit.getWidth() == 0 || hit.getHeight() == 0)
+                                      {
+                                          for (unsigned int y = y0; y < y1; ++y)
+                                              std::memset(output.row(y) + x0, border, x1 - x0);
+                                          continue;
+                                      }
+                                      checked = hit.getWidth() != bounds.getWidth() || hit.getHeight() != bounds.getHeight();
+                                  }
+
+                                  for (unsigned int y = y0; y < y1; ++y)
+                                  {
+                                      unsigned char *out = output.row(y);
+                                      if (affine)
+                                      {
+                                          long long fx = std::llround((m[0] * x0 + m[1] * y + m[2]) * FIXED_ONE);
+                                          long long fy = std::llround((m[3] * x0 + m[4] * y + m[5]) * FIXED_ONE);
+                                          long long dx = std::llround(m[0] * FIXED_ONE);
+                                          long long dy = std::llround(m[3] * FIXED_ONE);
+                                          for (unsigned int x = x0; x < x1; ++x, fx += dx, fy += dy)
+                                              out[x] = sample(rows, width, height, fx, fy, bilinear, checked, border);
+                                      }
+                                      else
+                                      {
+                                          double sxw = m[0] * x0 + m[1] * y + m[2];
+                                          double syw = m[3] * x0 + m[4] * y + m[5];
+                                          double w = m[6] * x0 + m[7] * y + m[8];
+                                          for (unsigned int x = x0; x < x1; ++x, sxw += m[0], syw += m[3], w += m[6])
+                                          {
+                                              double sx = sxw / w;
+                                              double sy = syw / w;
+                                              if (w <= 0 || std::fabs(sx) >= COORDINATE_LIMIT || std::fabs(sy) >= COORDINATE_LIMIT)
+                                              {
+                                                  out[x] = border;
+                                                  continue;
+                                              }
+                                              out[x] = sample(rows, width, height, std::llround(sx * FIXED_ONE),
+                                                              std::llround(sy * FIXED_ONE), bilinear, checked, border);
+                                          }
+                                      }
+                                  }
+                              }
+                          }
+                      },
+                      1);
+    dst = output;
+}
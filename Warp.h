@@ -0,0 +1,119 @@
+#pragma once
+#include "ImageProcessing.h"
+
+/**
+ * @class Warp
+ * @brief A class that represents an affine or perspective warp of an image.
+ *
+ * The transform maps source pixel coordinates (x, y) to destination coordinates with a 3x3
+ * homography; affine transforms use (0, 0, 1) as the last row. The warp iterates over the
+ * destination in 64x64 tiles and maps each pixel back through the inverse transform. Along a
+ * row the source coordinates are advanced incrementally in 16.16 fixed point, and tiles that map
+ * completely outside of the source are filled with the border value without being sampled.
+ */
+class Warp : public ImageProcessing
+{
+public:
+    /**
+     * @brief The interpolation methods supported by Warp.
+     */
+    enum Interpolation
+    {
+        NEAREST, /**< Takes the nearest source pixel. */
+        BILINEAR /**< Blends the four surrounding source pixels. */
+    };
+
+private:
+    double inverse[9];           /**< The destination-to-source transform, row-major. */
+    Size size;                   /**< The size of the output image. */
+    Interpolation interpolation; /**< The interpolation method. */
+    unsigned char borderValue;   /**< The value of output pixels that map outside of the source. */
+
+public:
+    /**
+     * @brief Default constructor.
+     *
+     * Initializes an identity warp with a 0x0 output size.
+     */
+    Warp();
+
+    /**
+     * @brief Constructs a Warp object from a homography.
+     *
+     * @param matrix The 3x3 source-to-destination transform, row-major.
+     * @param size The size of the output image.
+     * @param interpolation The interpolation method.
+     * @param borderValue The value of output pixels that map outside of the source.
+     * @throws std::invalid_argument if the matrix is not invertible.
+     */
+    Warp(const double matrix[9], Size size, Interpolation interpolation = BILINEAR, unsigned char borderValue = 0);
+
+    /**
+     * @brief Creates an affine warp.
+     *
+     * @param matrix The 2x3 source-to-destination transform, row-major.
+     * @param size The size of the output image.
+     * @param interpolation The interpolation method.
+     * @param borderValue The value of output pixels that map outside of the source.
+     * @return The Warp object.
+     */
+    static Warp affine(const double matrix[6], Size size, Interpolation interpolation = BILINEAR, unsigned char borderValue = 0);
+
+    /**
+     * @brief Set the source-to-destination transform.
+     *
+     * @param matrix The 3x3 transform, row-major.
+     * @throws std::invalid_argument if the matrix is not invertible.
+     */
+    void setMatrix(const double matrix[9]);
+
+    /**
+     * @brief Get the size of the output image.
+     *
+     * @return The output size.
+     */
+    Size getSize() const;
+
+    /**
+     * @brief Set the size of the output image.
+     *
+     * @param newSize The new output size.
+     */
+    void setSize(Size newSize);
+
+    /**
+     * @brief Get the interpolation method.
+     *
+     * @return The interpolation method.
+     */
+    Interpolation getInterpolation() const;
+
+    /**
+     * @brief Set the interpolation method.
+     *
+     * @param newInterpolation The new interpolation method.
+     */
+    void setInterpolation(Interpolation newInterpolation);
+
+    /**
+     * @brief Get the border value.
+     *
+     * @return The value of output pixels that map outside of the source.
+     */
+    unsigned char getBorderValue() const;
+
+    /**
+     * @brief Set the border value.
+     *
+     * @param newBorderValue The new border value.
+     */
+    void setBorderValue(unsigned char newBorderValue);
+
+    /**
+     * @brief Warps the source image and stores the result in the destination image.
+     *
+     * @param src The source image.
+     * @param dst The warped image.
+     */
+    void process(const Image &src, Image &dst) override;
+};
@@ -0,0 +1,365 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BrightnessContrast.h"
+#include "Draw.h"
+#include "Gamma.h"
+#include "Image.h"
+#include "ImageConvolution.h"
+#include "Parallel.h"
+#include "Simd.h"
+
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+/**
+ * The timings of one operator on one image size with one thread count.
+ */
+struct Result
+{
+    std::string name;     ///< The operator.
+    unsigned int width;   ///< The width of the image.
+    unsigned int height;  ///< The height of the image.
+    unsigned int threads; ///< The thread count.
+    size_t samples;       ///< The number of timed runs.
+    double median;        ///< The median time of a run, in seconds.
+    double p99;           ///< The 99th percentile of the time of a run, in seconds.
+    double megapixels;    ///< The image megapixels processed per second, at the median time.
+};
+
+/**
+ * A benchmarked operation: its name and a function running it once on an image of the current size.
+ */
+struct Benchmark
+{
+    std::string name;          ///< The operator.
+    std::function<void()> run; ///< Runs the operator once.
+};
+
+/**
+ * The settings given on the command line.
+ */
+struct Settings
+{
+    std::vector<Size> sizes;            ///< The image sizes of the sweep.
+    std::vector<unsigned int> threads;  ///< The thread counts of the sweep.
+    std::vector<std::string> filters;   ///< The substrings selecting the operators, empty for all.
+    double minTime = 0.2;               ///< The minimum time spent timing every combination, in seconds.
+    size_t minSamples = 3;              ///< The minimum number of timed runs.
+    size_t maxSamples = 1000;           ///< The maximum number of timed runs.
+    std::string json = "benchmark.json"; ///< The file the results are written to.
+    std::string label;                  ///< A name for this run, such as a version, copied to the results.
+};
+
+/**
+ * Prints the command line syntax.
+ */
+static void printUsage(const char *program)
+{
+    std::cout << "Usage: " << program << " [options]\n"
+              << "\n"
+              << "Times every operator over a sweep of image sizes and thread counts and reports the median and\n"
+              << "99th percentile time of a run and the image megapixels processed per second.\n"
+              << "\n"
+              << "Options:\n"
+              << "  -s SIZES    The image sizes, e.g. 64x64,1920x1080 (defaults to 64x64 up to 7680x4320).\n"
+              << "  -j THREADS  The thread counts, e.g. 1,2,4 (defaults to 1 and the hardware threads).\n"
+              << "  -f NAMES    Only the operators whose name contains one of NAMES, e.g. conv,load.\n"
+              << "  -t SECONDS  The minimum time spent timing every combination (defaults to 0.2).\n"
+              << "  -n COUNT    The minimum number of timed runs (defaults to 3).\n"
+              << "  -o FILE     The JSON file the results are written to (defaults to benchmark.json).\n"
+              << "  -l LABEL    A name for this run, such as a version, written to the JSON file.\n"
+              << "  -h          Prints this help.\n";
+}
+
+/**
+ * Splits a comma-separated list.
+ */
+static std::vector<std::string> splitList(const std::string &text)
+{
+    std::vector<std::string> parts;
+    std::stringstream stream(text);
+    std::string part;
+    while (std::getline(stream, part, ','))
+        if (!part.empty())
+            parts.push_back(part);
+    return parts;
+}
+
+/**
+ * Parses the command line.
+ *
+ * @return False if it is invalid.
+ */
+static bool parseSettings(int argc, char **argv, Settings &settings)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "-h" || i + 1 >= argc)
+            return false;
+        std::string value = argv[++i];
+        if (arg == "-s")
+        {
+            settings.sizes.clear();
+            for (const std::string &size : splitList(value))
+            {
+                unsigned int width = 0, height = 0;
+                if (std::sscanf(size.c_str(), "%ux%u", &width, &height) != 2 || width == 0 || height == 0)
+                    return false;
+                settings.sizes.push_back(Size(width, height));
+            }
+        }
+        else if (arg == "-j")
+        {
+            settings.threads.clear();
+            for (const std::string &count : splitList(value))
+                settings.threads.push_back(static_cast<unsigned int>(std::max(1, std::atoi(count.c_str()))));
+        }
+        else if (arg == "-f")
+            settings.filters = splitList(value);
+        else if (arg == "-t")
+            settings.minTime = std::atof(value.c_str());
+        else if (arg == "-n")
+            settings.minSamples = static_cast<size_t>(std::max(1, std::atoi(value.c_str())));
+        else if (arg == "-o")
+            settings.json = value;
+        else if (arg == "-l")
+            settings.label = value;
+        else
+            return false;
+    }
+    return !settings.sizes.empty() && !settings.threads.empty();
+}
+
+/**
+ * Fills an image with a gradient and deterministic noise, so no operator sees a flat image.
+ */
+static Image makeImage(unsigned int width, unsigned int height)
+{
+    Image img(width, height);
+    unsigned int state = 12345;
+    for (unsigned int i = 0; i < height; ++i)
+    {
+        unsigned char *row = img.row(i);
+        for (unsigned int j = 0; j < width; ++j)
+        {
+            state = state * 1103515245 + 12345;
+            row[j] = static_cast<unsigned char>((i + j) / 8 + (state >> 27));
+        }
+    }
+    return img;
+}
+
+/**
+ * Times a benchmark: one untimed run, then timed runs until both the minimum time and the
+ * minimum number of runs are reached.
+ *
+ * @return The time of every timed run, sorted, in seconds.
+ */
+static std::vector<double> timeRuns(const Benchmark &benchmark, const Settings &settings)
+{
+    benchmark.run();
+    std::vector<double> samples;
+    Clock::time_point start = Clock::now();
+    while (samples.size() < settings.maxSamples &&
+           (samples.size() < settings.minSamples ||
+            std::chrono::duration<double>(Clock::now() - start).count() < settings.minTime))
+    {
+        Clock::time_point begin = Clock::now();
+        benchmark.run();
+        samples.push_back(std::chrono::duration<double>(Clock::now() - begin).count());
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples;
+}
+
+/**
+ * Returns a percentile of sorted samples, interpolating between the two nearest ones.
+ */
+static double percentile(const std::vector<double> &sorted, double fraction)
+{
+    double position = fraction * (sorted.size() - 1);
+    size_t below = static_cast<size_t>(position);
+    size_t above = std::min(below + 1, sorted.size() - 1);
+    return sorted[below] + (sorted[above] - sorted[below]) * (position - below);
+}
+
+/**
+ * Escapes a string for JSON.
+ */
+static std::string quote(const std::string &text)
+{
+    std::string quoted = "\"";
+    for (char c : text)
+    {
+        if (c == '"' || c == '\\')
+            quoted += '\\';
+        if (static_cast<unsigned char>(c) >= 0x20)
+            quoted += c;
+    }
+    return quoted + "\"";
+}
+
+/**
+ * Writes the results and what they were measured on as JSON.
+ *
+ * @return False if the file cannot be written.
+ */
+static bool writeJson(const std::string &path, const Settings &settings, const std::vector<Result> &results)
+{
+    std::ofstream file(path);
+    if (!file.is_open())
+        return false;
+    file << "{\n";
+    file << "  \"label\": " << quote(settings.label) << ",\n";
+    file << "  \"compiler\": " << quote(__VERSION__) << ",\n";
+#ifdef IMAGE_PROCESSING_SSE2
+    file << "  \"sse2\": true,\n";
+#else
+    file << "  \"sse2\": false,\n";
+#endif
+    file << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+    file << "  \"min_time\": " << settings.minTime << ",\n";
+    file << "  \"results\": [\n";
+    for (size_t k = 0; k < results.size(); ++k)
+    {
+        const Result &r = results[k];
+        file << "    {\"operator\": " << quote(r.name) << ", \"width\": " << r.width << ", \"height\": " << r.height
+             << ", \"threads\": " << r.threads << ", \"samples\": " << r.samples << ", \"median_ms\": " << r.median * 1e3
+             << ", \"p99_ms\": " << r.p99 * 1e3 << ", \"mp_per_s\": " << r.megapixels << "}"
+             << (k + 1 < results.size() ? ",\n" : "\n");
+    }
+    file << "  ]\n}\n";
+    return static_cast<bool>(file);
+}
+
+int main(int argc, char **argv)
+{
+    Settings settings;
+    settings.sizes = {Size(64, 64), Size(256, 256), Size(512, 512), Size(1024, 1024),
+                      Size(1920, 1080), Size(3840, 2160), Size(7680, 4320)};
+    unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+    settings.threads = {1};
+    if (hardware > 1)
+        settings.threads.push_back(hardware);
+    if (!parseSettings(argc, argv, settings))
+    {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    int mean[3][3] = {{1, 1, 1}, {1, 1, 1}, {1, 1, 1}};
+    int gaussian[3][3] = {{1, 2, 1}, {2, 4, 2}, {1, 2, 1}};
+    int sobelH[3][3] = {{1, 2, 1}, {0, 0, 0}, {-1, -2, -1}};
+    int sobelV[3][3] = {{-1, 0, 1}, {-2, 0, 2}, {-1, 0, 1}};
+    int *meanRows[3] = {mean[0], mean[1], mean[2]};
+    int *gaussianRows[3] = {gaussian[0], gaussian[1], gaussian[2]};
+    int *sobelHRows[3] = {sobelH[0], sobelH[1], sobelH[2]};
+    int *sobelVRows[3] = {sobelV[0], sobelV[1], sobelV[2]};
+    ImageConvolution meanBlur(meanRows, 3, 3, ImageConvolution::meanBlurScaling);
+    ImageConvolution gaussianBlur(gaussianRows, 3, 3, ImageConvolution::gaussianBlurScaling);
+    ImageConvolution horizontalSobel(sobelHRows, 3, 3, ImageConvolution::horizontalSobelScaling);
+    ImageConvolution verticalSobel(sobelVRows, 3, 3, ImageConvolution::verticalSobelScaling);
+    BrightnessContrast brightnessContrast(1.5, -20);
+    Gamma gamma(1.2);
+
+    fs::path directory = fs::temp_directory_path() / "image-processing-benchmark";
+    fs::create_directories(directory);
+    std::string asciiPath = (directory / "image.ascii.pgm").string();
+    std::string binaryPath = (directory / "image.pgm").string();
+
+    std::vector<Result> results;
+    std::printf("%-24s %11s %7s %7s %11s %11s %10s\n", "operator", "size", "threads", "samples", "median ms", "p99 ms",
+                "MP/s");
+    for (const Size &size : settings.sizes)
+    {
+        unsigned int width = size.getWidth();
+        unsigned int height = size.getHeight();
+        Image src = makeImage(width, height);
+        Image other = makeImage(width, height);
+        Image dst, canvas(width, height);
+        int w = static_cast<int>(width), h = static_cast<int>(height);
+        int radius = std::min(w, h) / 3;
+        Point center(w / 2, h / 2);
+
+        std::vector<Benchmark> benchmarks = {
+            {"image_add", [&] { dst = src + other; }},
+            {"image_subtract", [&] { dst = src - other; }},
+            {"image_multiply", [&] { dst = src * 1.5; }},
+            {"brightness_contrast", [&] { brightnessContrast.process(src, dst); }},
+            {"gamma", [&] { gamma.process(src, dst); }},
+            {"conv_mean3", [&] { meanBlur.process(src, dst); }},
+            {"conv_gaussian3", [&] { gaussianBlur.process(src, dst); }},
+            {"conv_sobel_horizontal", [&] { horizontalSobel.process(src, dst); }},
+            {"conv_sobel_vertical", [&] { verticalSobel.process(src, dst); }},
+            {"draw_line", [&] { Draw::drawLine(canvas, Point(0, 0), Point(w - 1, h - 1), 255); }},
+            {"draw_line_thick", [&] { Draw::drawLine(canvas, Point(0, 0), Point(w - 1, h - 1), 255, 9); }},
+            {"draw_line_antialiased", [&] { Draw::drawAntialiasedLine(canvas, Point(0, 0), Point(w - 1, h - 1), 255); }},
+            {"draw_rectangle", [&] { Draw::drawRectangle(canvas, Rectangle(w / 8, h / 8, w * 3 / 4, h * 3 / 4), 255); }},
+            {"fill_rectangle", [&] { Draw::fillRectangle(canvas, Rectangle(w / 8, h / 8, w * 3 / 4, h * 3 / 4), 255); }},
+            {"draw_circle", [&] { Draw::drawCircle(canvas, center, radius, 255); }},
+            {"draw_circle_antialiased", [&] { Draw::drawAntialiasedCircle(canvas, center, radius, 255); }},
+            {"fill_circle", [&] { Draw::fillCircle(canvas, center, radius, 255); }},
+            {"save_p2", [&] { src.save(asciiPath); }},
+            {"load_p2", [&] { dst.load(asciiPath); }},
+            {"save_p5", [&] { src.save(binaryPath, true); }},
+            {"load_p5", [&] { dst.load(binaryPath); }},
+        };
+
+        auto selected = [&](const std::string &name)
+        {
+            return settings.filters.empty() ||
+                   std::any_of(settings.filters.begin(), settings.filters.end(), [&](const std::string &filter)
+                               { return name.find(filter) != std::string::npos; });
+        };
+        // The load benchmarks read the files written here, whether or not the save ones run.
+        if (selected("load_p2"))
+            src.save(asciiPath);
+        if (selected("load_p5"))
+            src.save(binaryPath, true);
+
+        for (unsigned int threads : settings.threads)
+        {
+            Parallel::setThreadCount(threads);
+            for (const Benchmark &benchmark : benchmarks)
+            {
+                if (!selected(benchmark.name))
+                    continue;
+                std::vector<double> samples = timeRuns(benchmark, settings);
+                Result result;
+                result.name = benchmark.name;
+                result.width = width;
+                result.height = height;
+                result.threads = threads;
+                result.samples = samples.size();
+                result.median = percentile(samples, 0.5);
+                result.p99 = percentile(samples, 0.99);
+                result.megapixels = static_cast<double>(width) * height / 1e6 / result.median;
+                results.push_back(result);
+                std::printf("%-24s %5ux%-5u %7u %7zu %11.3f %11.3f %10.1f\n", result.name.c_str(), width, height, threads,
+                            result.samples, result.median * 1e3, result.p99 * 1e3, result.megapixels);
+                std::fflush(stdout);
+            }
+        }
+    }
+
+    std::error_code error;
+    fs::remove_all(directory, error);
+    if (!writeJson(settings.json, settings, results))
+    {
+        std::cerr << "Cannot write '" << settings.json << "'\n";
+        return 1;
+    }
+    std::cout << "Results written to " << settings.json << '\n';
+    return 0;
+}
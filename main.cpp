@@ -0,0 +1,714 @@
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Image.h"
+#include "BrightnessContrast.h"
+#include "Canny.h"
+#include "Clahe.h"
+#include "DistanceTransform.h"
+#include "Gamma.h"
+#include "HistogramEqualization.h"
+#include "ImageConvolution.h"
+#include "ImageMetrics.h"
+#include "Parallel.h"
+#include "Pipeline.h"
+#include "Resize.h"
+#include "Threshold.h"
+#include "Trace.h"
+
+namespace fs = std::filesystem;
+
+static const unsigned int MAX_THREADS = 1024;       ///< The most threads -j accepts.
+static const unsigned int MAX_BATCH_SIZE = 1 << 20; ///< The most images -b accepts.
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Prints the command line syntax and the operators of a chain.
+ */
+static void printUsage(const char *program)
+{
+    std::cout << "Usage: " << program << " (-p CHAIN | -c FILE) -o DIR [options] INPUT...\n"
+              << "\n"
+              << "Runs every INPUT through a chain of operators and writes the results under DIR. An INPUT is a\n"
+              << "PGM file, a directory (searched recursively for .pgm files, its tree mirrored under DIR) or a\n"
+              << "pattern with * and ? in its file name.\n"
+              << "\n"
+              << "Options:\n"
+              << "  -p CHAIN   The operators, separated by '|', e.g. \"bc:1.5,0 | gamma:1.2 | conv:gaussian3\".\n"
+              << "  -c FILE    Reads the chain from a file: one or more operators per line, '#' starts a comment.\n"
+              << "  -o DIR     The output directory.\n"
+              << "  -j N       The number of threads, 1 to 1024 (defaults to the hardware threads).\n"
+              << "  -b N       The number of images processed together (defaults to 4 per thread).\n"
+              << "  -q         Only prints the totals, not a line per file.\n"
+              << "  -t FILE    Writes a Chrome trace of the run (needs a build with -DIMAGE_PROCESSING_TRACE).\n"
+              << "  -m FILE    Writes the image allocations and copies of the run, per operator, as Prometheus text.\n"
+              << "  -h         Prints this help.\n"
+              << "\n"
+              << "Operators:\n"
+              << "  bc:GAIN,BIAS                       Brightness and contrast.\n"
+              << "  gamma:GAMMA                        Gamma correction.\n"
+              << "  conv:mean3|gaussian3|sobelh|sobelv 3x3 convolution.\n"
+              << "  resize:WxH[,bilinear|bicubic|lanczos|area]\n"
+              << "  threshold:T|otsu                   Global threshold.\n"
+              << "  threshold:mean|gaussian[,BLOCK,OFFSET]\n"
+              << "  canny:LOW,HIGH                     Canny edges.\n"
+              << "  clahe:CLIP[,TILESX,TILESY]         Contrast limited adaptive histogram equalization.\n"
+              << "  equalize                           Histogram equalization.\n"
+              << "  distance                           Euclidean distance transform.\n";
+}
+
+/**
+ * Removes the white space around a string.
+ */
+static std::string trim(const std::string &text)
+{
+    size_t first = text.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos)
+        return "";
+    size_t last = text.find_last_not_of(" \t\r\n");
+    return text.substr(first, last - first + 1);
+}
+
+/**
+ * Splits a string at every separator, trimming the parts.
+ */
+static std::vector<std::string> split(const std::string &text, char separator)
+{
+    std::vector<std::string> parts;
+    size_t start = 0;
+    while (true)
+    {
+        size_t end = text.find(separator, start);
+        parts.push_back(trim(text.substr(start, end == std::string::npos ? std::string::npos : end - start)));
+        if (end == std::string::npos)
+            return parts;
+        start = end + 1;
+    }
+}
+
+/**
+ * Parses a positive integer that has to make up the whole argument, made of digits only.
+ *
+ * @throws std::invalid_argument if the argument is not an integer between 1 and maximum.
+ */
+static unsigned int parseCount(const std::string &text, const std::string &option, unsigned int maximum)
+{
+    unsigned long long value = 0;
+    for (char c : text)
+    {
+        if (c < '0' || c > '9')
+        {
+            value = 0;
+            break;
+        }
+        value = value * 10 + static_cast<unsigned int>(c - '0');
+        if (value > maximum)
+            break;
+    }
+    if (value == 0 || value > maximum)
+        throw std::invalid_argument("Invalid value '" + text + "' for " + option + ", expected an integer from 1 to " +
+                                    std::to_string(maximum));
+    return static_cast<unsigned int>(value);
+}
+
+/**
+ * Parses a number that has to make up the whole argument.
+ *
+ * @throws std::invalid_argument if the argument is not a number.
+ */
+static double parseNumber(const std::string &text, const std::string &spec)
+{
+    size_t used = 0;
+    double value = 0;
+    try
+    {
+        value = std::stod(text, &used);
+    }
+    catch (const std::exception &)
+    {
+        used = 0;
+    }
+    if (used == 0 || used != text.size())
+        throw std::invalid_argument("Invalid number '" + text + "' in '" + spec + "'");
+    return value;
+}
+
+/**
+ * Creates one of the 3x3 convolutions of the library by name.
+ *
+ * @throws std::invalid_argument if the kernel is unknown.
+ */
+static std::unique_ptr<ImageProcessing> createConvolution(const std::string &name, const std::string &spec)
+{
+    static int mean[3][3] = {{1, 1, 1}, {1, 1, 1}, {1, 1, 1}};
+    static int gaussian[3][3] = {{1, 2, 1}, {2, 4, 2}, {1, 2, 1}};
+    static int sobelH[3][3] = {{1, 2, 1}, {0, 0, 0}, {-1, -2, -1}};
+    static int sobelV[3][3] = {{-1, 0, 1}, {-2, 0, 2}, {-1, 0, 1}};
+    int (*kernel)[3];
+    int (*scaling)(int);
+    if (name == "mean3")
+    {
+        kernel = mean;
+        scaling = ImageConvolution::meanBlurScaling;
+    }
+    else if (name == "gaussian3")
+    {
+        kernel = gaussian;
+        scaling = ImageConvolution::gaussianBlurScaling;
+    }
+    else if (name == "sobelh")
+    {
+        kernel = sobelH;
+        scaling = ImageConvolution::horizontalSobelScaling;
+    }
+    else if (name == "sobelv")
+    {
+        kernel = sobelV;
+        scaling = ImageConvolution::verticalSobelScaling;
+    }
+    else
+        throw std::invalid_argument("Unknown kernel in '" + spec + "'");
+    int *rows[3] = {kernel[0], kernel[1], kernel[2]};
+    return std::unique_ptr<ImageProcessing>(new ImageConvolution(rows, 3, 3, *scaling));
+}
+
+/**
+ * Creates the operator described by NAME[:ARG,ARG...].
+ *
+ * @throws std::invalid_argument if the operator or its arguments are invalid.
+ */
+static std::unique_ptr<ImageProcessing> createOperator(const std::string &spec)
+{
+    size_t colon = spec.find(':');
+    std::string name = trim(spec.substr(0, colon));
+    std::vector<std::string> args;
+    if (colon != std::string::npos)
+        args = split(spec.substr(colon + 1), ',');
+    auto expect = [&](size_t least, size_t most)
+    {
+        if (args.size() < least || args.size() > most)
+            throw std::invalid_argument("Wrong number of arguments in '" + spec + "'");
+    };
+
+    if (name == "bc")
+    {
+        expect(2, 2);
+        return std::unique_ptr<ImageProcessing>(new BrightnessContrast(parseNumber(args[0], spec), parseNumber(args[1], spec)));
+    }
+    if (name == "gamma")
+    {
+        expect(1, 1);
+        return std::unique_ptr<ImageProcessing>(new Gamma(parseNumber(args[0], spec)));
+    }
+    if (name == "conv")
+    {
+        expect(1, 1);
+        return createConvolution(args[0], spec);
+    }
+    if (name == "resize")
+    {
+        expect(1, 2);
+        size_t x = args[0].find('x');
+        if (x == std::string::npos)
+            throw std::invalid_argument("Expected WIDTHxHEIGHT in '" + spec + "'");
+        double width = parseNumber(args[0].substr(0, x), spec);
+        double height = parseNumber(args[0].substr(x + 1), spec);
+        if (width < 1 || height < 1)
+            throw std::invalid_argument("Empty size in '" + spec + "'");
+        Resize::Interpolation interpolation = Resize::BILINEAR;
+        if (args.size() == 2)
+        {
+            if (args[1] == "bicubic")
+                interpolation = Resize::BICUBIC;
+            else if (args[1] == "lanczos")
+                interpolation = Resize::LANCZOS;
+            else if (args[1] == "area")
+                interpolation = Resize::AREA;
+            else if (args[1] != "bilinear")
+                throw std::invalid_argument("Unknown interpolation in '" + spec + "'");
+        }
+        return std::unique_ptr<ImageProcessing>(
+            new Resize(Size(static_cast<unsigned int>(width), static_cast<unsigned int>(height)), interpolation));
+    }
+    if (name == "threshold")
+    {
+        expect(1, 3);
+        if (args[0] == "otsu")
+        {
+            expect(1, 1);
+            return std::unique_ptr<ImageProcessing>(new Threshold(Threshold::OTSU));
+        }
+        if (args[0] == "mean" || args[0] == "gaussian")
+        {
+            Threshold::Method method = args[0] == "mean" ? Threshold::ADAPTIVE_MEAN : Threshold::ADAPTIVE_GAUSSIAN;
+            unsigned int blockSize = args.size() > 1 ? static_cast<unsigned int>(parseNumber(args[1], spec)) : 15;
+            int offset = args.size() > 2 ? static_cast<int>(parseNumber(args[2], spec)) : 5;
+            return std::unique_ptr<ImageProcessing>(new Threshold(method, blockSize, offset));
+        }
+        expect(1, 1);
+        double threshold = parseNumber(args[0], spec);
+        if (threshold < 0 || threshold > 255)
+            throw std::invalid_argument("Threshold out of range in '" + spec + "'");
+        return std::unique_ptr<ImageProcessing>(new Threshold(static_cast<unsigned char>(threshold)));
+    }
+    if (name == "canny")
+    {
+        expect(2, 2);
+        return std::unique_ptr<ImageProcessing>(new Canny(parseNumber(args[0], spec), parseNumber(args[1], spec)));
+    }
+    if (name == "clahe")
+    {
+        expect(1, 3);
+        unsigned int tilesX = args.size() > 1 ? static_cast<unsigned int>(parseNumber(args[1], spec)) : 8;
+        unsigned int tilesY = args.size() > 2 ? static_cast<unsigned int>(parseNumber(args[2], spec)) : tilesX;
+        return std::unique_ptr<ImageProcessing>(new Clahe(parseNumber(args[0], spec), tilesX, tilesY));
+    }
+    if (name == "equalize")
+    {
+        expect(0, 0);
+        return std::unique_ptr<ImageProcessing>(new HistogramEqualization());
+    }
+    if (name == "distance")
+    {
+        expect(0, 0);
+        return std::unique_ptr<ImageProcessing>(new DistanceTransform());
+    }
+    throw std::invalid_argument("Unknown operator '" + spec + "'");
+}
+
+/**
+ * Reads a chain from a file, joining its lines with '|' and dropping the comments.
+ *
+ * @throws std::invalid_argument if the file cannot be read.
+ */
+static std::string readChain(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+        throw std::invalid_argument("Cannot read the chain file '" + path + "'");
+    std::string chain, line;
+    while (std::getline(file, line))
+    {
+        line = trim(line.substr(0, line.find('#')));
+        if (!line.empty())
+            chain += (chain.empty() ? "" : " | ") + line;
+    }
+    return chain;
+}
+
+/**
+ * Returns whether a file name matches a pattern of * (any run of characters) and ? (any character).
+ */
+static bool matches(const std::string &name, const std::string &pattern)
+{
+    size_t n = 0, p = 0, starName = std::string::npos, starPattern = std::string::npos;
+    while (n < name.size())
+    {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n]))
+        {
+            ++n;
+            ++p;
+        }
+        else if (p < pattern.size() && pattern[p] == '*')
+        {
+            starPattern = p++;
+            starName = n;
+        }
+        else if (starPattern != std::string::npos)
+        {
+            p = starPattern + 1;
+            n = ++starName;
+        }
+        else
+            return false;
+    }
+    while (p < pattern.size() && pattern[p] == '*')
+        ++p;
+    return p == pattern.size();
+}
+
+/**
+ * A file to process and where its result goes.
+ */
+struct Job
+{
+    fs::path input;  ///< The source file.
+    fs::path output; ///< The result file.
+};
+
+/**
+ * Expands the inputs into files: directories are searched recursively for .pgm files and keep
+ * their tree below the output directory, patterns are matched in their directory.
+ *
+ * @return False if an input does not exist.
+ */
+static bool collectJobs(const std::vector<std::string> &inputs, const fs::path &outputDir, std::vector<Job> &jobs)
+{
+    bool ok = true;
+    for (const std::string &input : inputs)
+    {
+        fs::path path(input);
+        std::error_code error;
+        if (fs::is_directory(path, error))
+        {
+            std::vector<fs::path> files;
+            for (fs::recursive_directory_iterator it(path, error), end; !error && it != end; it.increment(error))
+                if (it->is_regular_file(error) && it->path().extension() == ".pgm")
+                    files.push_back(it->path());
+            std::sort(files.begin(), files.end());
+            for (const fs::path &file : files)
+                jobs.push_back({file, outputDir / file.lexically_relative(path)});
+        }
+        else if (input.find_first_of("*?") != std::string::npos)
+        {
+            fs::path directory = path.has_parent_path() ? path.parent_path() : fs::path(".");
+            std::string pattern = path.filename().string();
+            std::vector<fs::path> files;
+            for (fs::directory_iterator it(directory, error), end; !error && it != end; it.increment(error))
+                if (it->is_regular_file(error) && matches(it->path().filename().string(), pattern))
+                    files.push_back(it->path());
+            std::sort(files.begin(), files.end());
+            if (files.empty())
+                std::cerr << "No file matches '" << input << "'\n";
+            for (const fs::path &file : files)
+                jobs.push_back({file, outputDir / file.filename()});
+        }
+        else if (fs::is_regular_file(path, error))
+            jobs.push_back({path, outputDir / path.filename()});
+        else
+        {
+            std::cerr << "Cannot find '" << input << "'\n";
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+/**
+ * A group of images going through reading, processing and writing together.
+ */
+struct Batch
+{
+    std::vector<Job> jobs;          ///< The files of the images.
+    std::vector<Image> images;      ///< The source images.
+    std::vector<Image> results;     ///< The processed images.
+    std::vector<double> readTimes;  ///< The time spent reading every image, in seconds.
+    std::vector<bool> failed;       ///< True for the images that could not be processed.
+    double processTime = 0;         ///< The time spent processing the whole batch, in seconds.
+};
+
+/**
+ * A queue of batches between two stages, which blocks the producer when it is full so that
+ * reading cannot run arbitrarily far ahead of processing.
+ */
+class BatchQueue
+{
+private:
+    std::deque<std::unique_ptr<Batch>> batches; ///< The batches waiting for the next stage.
+    size_t capacity;                            ///< The maximum number of waiting batches.
+    bool closed;                                ///< True once the producer is done.
+    std::mutex mutex;                           ///< Guards the queue.
+    std::condition_variable changed;            ///< Signaled on every push, pop and close.
+
+public:
+    explicit BatchQueue(size_t capacity) : capacity{capacity}, closed{false} {}
+
+    /**
+     * Adds a batch, waiting while the queue is full.
+     */
+    void push(std::unique_ptr<Batch> batch)
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->changed.wait(lock, [this]
+                           { return this->batches.size() < this->capacity; });
+        this->batches.push_back(std::move(batch));
+        this->changed.notify_all();
+    }
+
+    /**
+     * Takes the oldest batch, waiting while the queue is empty.
+     *
+     * @return The batch, or nullptr once the queue is empty and closed.
+     */
+    std::unique_ptr<Batch> pop()
+    {
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->changed.wait(lock, [this]
+                           { return !this->batches.empty() || this->closed; });
+        if (this->batches.empty())
+            return nullptr;
+        std::unique_ptr<Batch> batch = std::move(this->batches.front());
+        this->batches.pop_front();
+        this->changed.notify_all();
+        return batch;
+    }
+
+    /**
+     * Tells the consumer that no more batches will come.
+     */
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->closed = true;
+        this->changed.notify_all();
+    }
+};
+
+/**
+ * Returns the seconds elapsed since a point in time.
+ */
+static double secondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+    std::string chain, outputDir, tracePath, metricsPath;
+    std::vector<std::string> inputs;
+    unsigned int threads = 0, batchSize = 0;
+    bool quiet = false;
+    try
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            auto value = [&]() -> std::string
+            {
+                if (i + 1 >= argc)
+                    throw std::invalid_argument("Missing value after " + arg);
+                return argv[++i];
+            };
+            if (arg == "-h" || arg == "--help")
+            {
+                printUsage(argv[0]);
+                return 0;
+            }
+            else if (arg == "-p")
+                chain = value();
+            else if (arg == "-c")
+                chain = readChain(value());
+            else if (arg == "-o")
+                outputDir = value();
+            else if (arg == "-j")
+                threads = parseCount(value(), arg, MAX_THREADS);
+            else if (arg == "-b")
+                batchSize = parseCount(value(), arg, MAX_BATCH_SIZE);
+            else if (arg == "-q")
+                quiet = true;
+            else if (arg == "-t")
+                tracePath = value();
+            else if (arg == "-m")
+                metricsPath = value();
+            else if (arg.size() > 1 && arg[0] == '-')
+                throw std::invalid_argument("Unknown option " + arg);
+            else
+                inputs.push_back(arg);
+        }
+        if (chain.empty() || outputDir.empty() || inputs.empty())
+        {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << '\n';
+        return 2;
+    }
+
+    // The pipeline does not own its stages, so they live here.
+    std::vector<std::unique_ptr<ImageProcessing>> operators;
+    Pipeline pipeline;
+    try
+    {
+        for (const std::string &spec : split(chain, '|'))
+        {
+            if (spec.empty())
+                throw std::invalid_argument("Empty operator in '" + chain + "'");
+            operators.push_back(createOperator(spec));
+            pipeline.add(*operators.back());
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << '\n';
+        return 2;
+    }
+
+    if (!metricsPath.empty())
+        ImageMetrics::setEnabled(true);
+    // Frames are copied into the batches and only read from there, so the copies can share pixels.
+    Image::setCopyOnWrite(true);
+    if (!tracePath.empty())
+    {
+#ifndef IMAGE_PROCESSING_TRACE
+        std::cerr << "Tracing is not compiled in: build with -DIMAGE_PROCESSING_TRACE to record a trace\n";
+#endif
+        Trace::setEnabled(true);
+        Trace::setThreadName("main");
+    }
+    if (threads > 0)
+        Parallel::setThreadCount(threads);
+    if (batchSize == 0)
+        batchSize = 4 * Parallel::getThreadCount();
+
+    std::vector<Job> jobs;
+    bool ok = collectJobs(inputs, outputDir, jobs);
+
+    // Reading, processing and writing run on their own threads, connected by short queues, so
+    // the next batch is read and the previous one written while the pool processes this one.
+    BatchQueue loaded(2), processed(2);
+    std::mutex printMutex;
+    size_t failures = 0;
+    double readTime = 0, processTime = 0, writeTime = 0, megapixels = 0;
+    Clock::time_point start = Clock::now();
+
+    std::thread reader([&]
+                       {
+                           if (!tracePath.empty())
+                               Trace::setThreadName("reader");
+                           for (size_t first = 0; first < jobs.size(); first += batchSize)
+                           {
+                               TRACE_SCOPE("read batch", "cli");
+                               ImageMetrics::Site site("read batch");
+                               std::unique_ptr<Batch> batch(new Batch());
+                               for (size_t k = first; k < std::min(first + batchSize, jobs.size()); ++k)
+                               {
+                                   Clock::time_point begin = Clock::now();
+                                   Image image;
+                                   bool read = false;
+                                   std::string reason;
+                                   try
+                                   {
+                                       read = image.load(jobs[k].input.string()) && image.getWidth() > 0 && image.getHeight() > 0;
+                                   }
+                                   catch (const std::exception &e)
+                                   {
+                                       // One bad file, e.g. a header too large to allocate, must not end the run.
+                                       reason = std::string(": ") + e.what();
+                                   }
+                                   double seconds = secondsSince(begin);
+                                   std::lock_guard<std::mutex> lock(printMutex);
+                                   readTime += seconds;
+                                   if (!read)
+                                   {
+                                       std::cerr << "Cannot read '" << jobs[k].input.string() << "'" << reason << "\n";
+                                       ++failures;
+                                       continue;
+                                   }
+                                   batch->jobs.push_back(jobs[k]);
+                                   batch->images.push_back(image);
+                                   batch->readTimes.push_back(seconds);
+                               }
+                               loaded.push(std::move(batch));
+                           }
+                           loaded.close(); });
+
+    std::thread writer([&]
+                       {
+                           if (!tracePath.empty())
+                               Trace::setThreadName("writer");
+                           while (std::unique_ptr<Batch> batch = processed.pop())
+                           {
+                               TRACE_SCOPE("write batch", "cli");
+                               ImageMetrics::Site site("write batch");
+                               for (size_t k = 0; k < batch->jobs.size(); ++k)
+                               {
+                                   if (batch->failed[k])
+                                       continue;
+                                   const Job &job = batch->jobs[k];
+                                   Clock::time_point begin = Clock::now();
+                                   std::error_code error;
+                                   fs::create_directories(job.output.parent_path(), error);
+                                   bool written = batch->results[k].save(job.output.string());
+                                   double seconds = secondsSince(begin);
+                                   const Image &image = batch->images[k];
+                                   double share = batch->processTime / batch->jobs.size();
+                                   std::lock_guard<std::mutex> lock(printMutex);
+                                   writeTime += seconds;
+                                   if (!written)
+                                   {
+                                       std::cerr << "Cannot write '" << job.output.string() << "'\n";
+                                       ++failures;
+                                       continue;
+                                   }
+                                   megapixels += static_cast<double>(image.getWidth()) * image.getHeight() / 1e6;
+                                   if (!quiet)
+                                       std::cout << job.input.string() << " -> " << job.output.string() << "  "
+                                                 << image.getWidth() << "x" << image.getHeight() << std::fixed
+                                                 << std::setprecision(2) << "  read " << batch->readTimes[k] * 1e3
+                                                 << " ms  process " << share * 1e3 << " ms  write " << seconds * 1e3
+                                                 << " ms\n";
+                               }
+                           } });
+
+    while (std::unique_ptr<Batch> batch = loaded.pop())
+    {
+        TRACE_SCOPE("process batch", "cli");
+        ImageMetrics::Site site("process batch");
+        Clock::time_point begin = Clock::now();
+        batch->failed.assign(batch->jobs.size(), false);
+        try
+        {
+            pipeline.processBatch(batch->images, batch->results);
+        }
+        catch (const std::exception &)
+        {
+            // Find the images the chain fails on by running them one at a time.
+            batch->results.resize(batch->images.size());
+            for (size_t k = 0; k < batch->images.size(); ++k)
+            {
+                try
+                {
+                    pipeline.process(batch->images[k], batch->results[k]);
+                }
+                catch (const std::exception &e)
+                {
+                    batch->failed[k] = true;
+                    std::lock_guard<std::mutex> lock(printMutex);
+                    std::cerr << "Cannot process '" << batch->jobs[k].input.string() << "': " << e.what() << '\n';
+                    ++failures;
+                }
+            }
+        }
+        batch->processTime = secondsSince(begin);
+        processTime += batch->processTime;
+        processed.push(std::move(batch));
+    }
+    processed.close();
+    reader.join();
+    writer.join();
+
+    if (!tracePath.empty() && !Trace::write(tracePath))
+    {
+        std::cerr << "Cannot write '" << tracePath << "'\n";
+        ok = false;
+    }
+    if (!metricsPath.empty() && !ImageMetrics::write(metricsPath))
+    {
+        std::cerr << "Cannot write '" << metricsPath << "'\n";
+        ok = false;
+    }
+
+    double elapsed = secondsSince(start);
+    size_t done = jobs.size() - failures;
+    std::cout << std::fixed << std::setprecision(2) << done << " files, " << failures << " failed, " << megapixels
+              << " MP in " << elapsed << " s: " << done / elapsed << " files/s, " << megapixels / elapsed << " MP/s"
+              << " (read " << readTime << " s, process " << processTime << " s, write " << writeTime << " s, "
+              << Parallel::getThreadCount() << " threads)\n";
+    return ok && failures == 0 ? 0 : 1;
+}